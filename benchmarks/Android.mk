@@ -59,10 +59,33 @@ include $(BUILD_HOST_STATIC_LIBRARY)
 
 endif
 
+# -----------------------------------------------------------------------------
+# Library with 200k relocations, dlopen()ed by the linker benchmarks.
+# -----------------------------------------------------------------------------
+include $(CLEAR_VARS)
+LOCAL_MODULE := libbenchmark_linker_relocs
+LOCAL_MULTILIB := both
+LOCAL_CFLAGS := $(benchmark_cflags)
+LOCAL_SRC_FILES := linker_relocs_library.cpp
+include $(BUILD_SHARED_LIBRARY)
+
+# Only supported on linux systems.
+ifeq ($(HOST_OS),linux)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libbenchmark_linker_relocs
+LOCAL_MULTILIB := both
+LOCAL_CFLAGS := $(benchmark_cflags)
+LOCAL_SRC_FILES := linker_relocs_library.cpp
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+endif
+
 # -----------------------------------------------------------------------------
 # Benchmarks.
 # -----------------------------------------------------------------------------
 benchmark_src_files := \
+    linker_benchmark.cpp \
     math_benchmark.cpp \
     property_benchmark.cpp \
     pthread_benchmark.cpp \
@@ -71,6 +94,15 @@ benchmark_src_files := \
     string_benchmark.cpp \
     time_benchmark.cpp \
     unistd_benchmark.cpp \
+    unwind_benchmark.cpp \
+
+# unwind_benchmark.cpp walks frame pointers, and uses bionic's frame walker.
+benchmark_executable_cflags := \
+    $(benchmark_cflags) \
+    -fno-omit-frame-pointer \
+
+benchmark_executable_c_includes := \
+    bionic/libc \
 
 # Build benchmarks for the device (with bionic's .so). Run with:
 #   adb shell bionic-benchmarks32
@@ -80,10 +112,12 @@ LOCAL_MODULE := bionic-benchmarks
 LOCAL_MODULE_STEM_32 := bionic-benchmarks32
 LOCAL_MODULE_STEM_64 := bionic-benchmarks64
 LOCAL_MULTILIB := both
-LOCAL_CFLAGS := $(benchmark_cflags)
+LOCAL_CFLAGS := $(benchmark_executable_cflags)
 LOCAL_CPPFLAGS := $(benchmark_cppflags)
+LOCAL_C_INCLUDES := $(benchmark_executable_c_includes)
 LOCAL_SRC_FILES := $(benchmark_src_files)
 LOCAL_STATIC_LIBRARIES := libbenchmark libbase
+LOCAL_REQUIRED_MODULES := libbenchmark_linker_relocs
 include $(BUILD_EXECUTABLE)
 
 # We don't build a static benchmark executable because it's not usually
@@ -101,11 +135,13 @@ LOCAL_MODULE := bionic-benchmarks-glibc
 LOCAL_MODULE_STEM_32 := bionic-benchmarks-glibc32
 LOCAL_MODULE_STEM_64 := bionic-benchmarks-glibc64
 LOCAL_MULTILIB := both
-LOCAL_CFLAGS := $(benchmark_cflags)
+LOCAL_CFLAGS := $(benchmark_executable_cflags)
 LOCAL_CPPFLAGS := $(benchmark_cppflags)
-LOCAL_LDFLAGS := -lrt
+LOCAL_C_INCLUDES := $(benchmark_executable_c_includes)
+LOCAL_LDFLAGS := -lrt -ldl
 LOCAL_SRC_FILES := $(benchmark_src_files)
 LOCAL_STATIC_LIBRARIES := libbenchmark libbase
+LOCAL_REQUIRED_MODULES := libbenchmark_linker_relocs
 include $(BUILD_HOST_EXECUTABLE)
 
 endif
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dlfcn.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <benchmark/Benchmark.h>
+
+#include "../linker/linker_gnu_hash.h"
+
+// Returns the number of entries in the dynamic symbol table, which is
+// only recorded in the hash tables.
+static size_t dynsym_count(const uint32_t* hash, const uint32_t* gnu_hash) {
+  if (hash != nullptr) {
+    return hash[1]; // nchain
+  }
+
+  if (gnu_hash == nullptr) {
+    return 0;
+  }
+
+  uint32_t nbucket = gnu_hash[0];
+  uint32_t symndx = gnu_hash[1];
+  uint32_t maskwords = gnu_hash[2];
+  const uint32_t* bucket =
+      gnu_hash + 4 + maskwords * (sizeof(ElfW(Addr)) / sizeof(uint32_t));
+  // Laid out as soinfo::prelink_image() reads it.
+  const uint32_t* chain = bucket + nbucket - symndx;
+  return gnu_hash_symbol_count(bucket, nbucket, chain);
+}
+
+static int collect_symbol_names(struct dl_phdr_info* info, size_t, void* data) {
+  const char* basename = strrchr(info->dlpi_name, '/');
+  basename = (basename != nullptr) ? basename + 1 : info->dlpi_name;
+  if (strncmp(basename, "libc.so", 7) != 0 && strncmp(basename, "libm.so", 7) != 0) {
+    return 0;
+  }
+
+  const ElfW(Dyn)* dynamic = nullptr;
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+    if (info->dlpi_phdr[i].p_type == PT_DYNAMIC) {
+      dynamic = reinterpret_cast<const ElfW(Dyn)*>(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+    }
+  }
+
+  if (dynamic == nullptr) {
+    return 0;
+  }
+
+  const char* strtab = nullptr;
+  const ElfW(Sym)* symtab = nullptr;
+  const uint32_t* hash = nullptr;
+  const uint32_t* gnu_hash = nullptr;
+
+  for (const ElfW(Dyn)* d = dynamic; d->d_tag != DT_NULL; ++d) {
+    // glibc relocates these in place, bionic does not.
+    ElfW(Addr) addr = d->d_un.d_ptr;
+    if (addr < info->dlpi_addr) {
+      addr += info->dlpi_addr;
+    }
+
+    if (d->d_tag == DT_STRTAB) {
+      strtab = reinterpret_cast<const char*>(addr);
+    } else if (d->d_tag == DT_SYMTAB) {
+      symtab = reinterpret_cast<const ElfW(Sym)*>(addr);
+    } else if (d->d_tag == DT_HASH) {
+      hash = reinterpret_cast<const uint32_t*>(addr);
+    } else if (d->d_tag == DT_GNU_HASH) {
+      gnu_hash = reinterpret_cast<const uint32_t*>(addr);
+    }
+  }
+
+  if (strtab == nullptr || symtab == nullptr) {
+    return 0;
+  }
+
+  std::vector<const char*>* names = reinterpret_cast<std::vector<const char*>*>(data);
+  size_t count = dynsym_count(hash, gnu_hash);
+  for (size_t i = 1; i < count; ++i) {
+    if (symtab[i].st_shndx != SHN_UNDEF && symtab[i].st_name != 0) {
+      names->push_back(strtab + symtab[i].st_name);
+    }
+  }
+
+  return 0;
+}
+
+// The names of the symbols defined by libc.so and libm.so, so that the
+// benchmarks see the same name lengths and hash chains as the linker does.
+static const std::vector<const char*>& symbol_names() {
+  static std::vector<const char*> names;
+  if (names.empty()) {
+    dl_iterate_phdr(collect_symbol_names, &names);
+  }
+  return names;
+}
+
+static uint64_t symbol_names_size(const std::vector<const char*>& names) {
+  uint64_t size = 0;
+  for (const char* name : names) {
+    size += strlen(name);
+  }
+  return size;
+}
+
+// The byte-at-a-time loop the linker used to have.
+static uint32_t calculate_gnu_hash_bytewise(const char* name) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(name);
+  uint32_t h = 5381;
+  while (*p != 0) {
+    h += (h << 5) + *p++;
+  }
+  return h;
+}
+
+static uint32_t calculate_elf_hash(const char* name) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(name);
+  uint32_t h = 0, g;
+  while (*p != 0) {
+    h = (h << 4) + *p++;
+    g = h & 0xf0000000;
+    h ^= g;
+    h ^= g >> 24;
+  }
+  return h;
+}
+
+BENCHMARK_NO_ARG(BM_linker_gnu_hash_bytewise);
+void BM_linker_gnu_hash_bytewise::Run(int iters) {
+  StopBenchmarkTiming();
+  const std::vector<const char*>& names = symbol_names();
+  StartBenchmarkTiming();
+
+  volatile uint32_t h __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    for (const char* name : names) {
+      h += calculate_gnu_hash_bytewise(name);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(symbol_names_size(names) * iters);
+}
+
+BENCHMARK_NO_ARG(BM_linker_gnu_hash);
+void BM_linker_gnu_hash::Run(int iters) {
+  StopBenchmarkTiming();
+  const std::vector<const char*>& names = symbol_names();
+  StartBenchmarkTiming();
+
+  volatile uint32_t h __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    for (const char* name : names) {
+      h += calculate_gnu_hash(name);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(symbol_names_size(names) * iters);
+}
+
+BENCHMARK_NO_ARG(BM_linker_elf_hash);
+void BM_linker_elf_hash::Run(int iters) {
+  StopBenchmarkTiming();
+  const std::vector<const char*>& names = symbol_names();
+  StartBenchmarkTiming();
+
+  volatile uint32_t h __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    for (const char* name : names) {
+      h += calculate_elf_hash(name);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(symbol_names_size(names) * iters);
+}
+
+// Exercises the whole lookup path: hashing, the bloom filter and
+// the comparison of the candidates on the hash chains.
+BENCHMARK_NO_ARG(BM_linker_dlsym_libc_libm);
+void BM_linker_dlsym_libc_libm::Run(int iters) {
+  StopBenchmarkTiming();
+  const std::vector<const char*>& names = symbol_names();
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    for (const char* name : names) {
+      dlsym(RTLD_DEFAULT, name);
+    }
+  }
+
+  StopBenchmarkTiming();
+}
+
+// dlopen() and dlclose() of a library with 200k relative relocations: two
+// tables of 100k pointers each, so the time goes into applying them.
+BENCHMARK_NO_ARG(BM_linker_dlopen_200k_relative_relocs);
+void BM_linker_dlopen_200k_relative_relocs::Run(int iters) {
+  StopBenchmarkTiming();
+  void* handle = dlopen("libbenchmark_linker_relocs.so", RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    fprintf(stderr, "BM_linker_dlopen_200k_relative_relocs: %s\n", dlerror());
+    abort();
+  }
+  dlclose(handle);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    handle = dlopen("libbenchmark_linker_relocs.so", RTLD_NOW | RTLD_LOCAL);
+    dlclose(handle);
+  }
+
+  StopBenchmarkTiming();
+}
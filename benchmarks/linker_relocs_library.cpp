@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A library with 200k relative relocations in tables of pointers, for
+// BM_linker_dlopen_200k_relative_relocs. The tables are writable so that
+// they are relocated in place like vtables and other tables of pointers.
+
+#include <stddef.h>
+
+static int g_targets[10];
+
+#define P1(n) &g_targets[n]
+#define P10 P1(0), P1(1), P1(2), P1(3), P1(4), P1(5), P1(6), P1(7), P1(8), P1(9)
+#define P100 P10, P10, P10, P10, P10, P10, P10, P10, P10, P10
+#define P1K P100, P100, P100, P100, P100, P100, P100, P100, P100, P100
+#define P10K P1K, P1K, P1K, P1K, P1K, P1K, P1K, P1K, P1K, P1K
+#define P100K P10K, P10K, P10K, P10K, P10K, P10K, P10K, P10K, P10K, P10K
+
+int* linker_relocs_table_1[] = { P100K };
+int* linker_relocs_table_2[] = { P100K };
+
+extern "C" size_t linker_relocs_count() {
+  return sizeof(linker_relocs_table_1) / sizeof(linker_relocs_table_1[0]) +
+      sizeof(linker_relocs_table_2) / sizeof(linker_relocs_table_2[0]);
+}
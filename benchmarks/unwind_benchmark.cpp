@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unwind.h>
+
+#include <benchmark/Benchmark.h>
+
+#include "private/bionic_frame_walk.h"
+
+// The cost of capturing a backtrace the way libc.debug.malloc does, at the
+// depths it's likely to be asked for, from a stack deeper than that.
+#define AT_CAPTURE_DEPTHS \
+    Arg(8)->Arg(16)->Arg(32)
+
+static constexpr size_t kMaxCaptureDepth = 32;
+static constexpr int kStackDepth = 40;
+
+typedef size_t (*CaptureFunction)(uintptr_t* frames, size_t max_depth);
+
+// Captures iters backtraces from kStackDepth frames further down the stack.
+static void __attribute__((noinline)) CaptureBacktraces(::testing::Benchmark* benchmark,
+                                                        int frames_left, CaptureFunction capture,
+                                                        int iters, size_t max_depth) {
+  if (frames_left > 0) {
+    CaptureBacktraces(benchmark, frames_left - 1, capture, iters, max_depth);
+    // Keep this frame on the stack rather than turning the call into a jump.
+    __asm__ __volatile__("" ::: "memory");
+    return;
+  }
+
+  uintptr_t frames[kMaxCaptureDepth];
+  benchmark->StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    capture(frames, max_depth);
+  }
+  benchmark->StopBenchmarkTiming();
+}
+
+struct UnwindState {
+  uintptr_t* frames;
+  size_t frame_count;
+  size_t max_depth;
+};
+
+static _Unwind_Reason_Code UnwindCallback(_Unwind_Context* context, void* arg) {
+  UnwindState* state = static_cast<UnwindState*>(arg);
+  state->frames[state->frame_count++] = _Unwind_GetIP(context);
+  return (state->frame_count >= state->max_depth) ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+static size_t __attribute__((noinline)) CaptureWithUnwinder(uintptr_t* frames, size_t max_depth) {
+  UnwindState state = { frames, 0, max_depth };
+  _Unwind_Backtrace(UnwindCallback, &state);
+  return state.frame_count;
+}
+
+BENCHMARK_WITH_ARG(BM_unwind_unwinder, int)->AT_CAPTURE_DEPTHS;
+void BM_unwind_unwinder::Run(int iters, int depth) {
+  StopBenchmarkTiming();
+  CaptureBacktraces(this, kStackDepth, CaptureWithUnwinder, iters, depth);
+}
+
+#if defined(HAVE_BIONIC_FRAME_WALK)
+static uintptr_t g_stack_top;
+
+static size_t __attribute__((noinline)) CaptureWithFramePointers(uintptr_t* frames,
+                                                                 size_t max_depth) {
+  uintptr_t fp = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+  return walk_frame_records(fp, g_stack_top, frames, max_depth);
+}
+
+BENCHMARK_WITH_ARG(BM_unwind_frame_pointers, int)->AT_CAPTURE_DEPTHS;
+void BM_unwind_frame_pointers::Run(int iters, int depth) {
+  StopBenchmarkTiming();
+
+  pthread_attr_t attr;
+  void* stack_base;
+  size_t stack_size;
+  pthread_getattr_np(pthread_self(), &attr);
+  pthread_attr_getstack(&attr, &stack_base, &stack_size);
+  pthread_attr_destroy(&attr);
+  g_stack_top = reinterpret_cast<uintptr_t>(stack_base) + stack_size;
+
+  CaptureBacktraces(this, kStackDepth, CaptureWithFramePointers, iters, depth);
+}
+#endif
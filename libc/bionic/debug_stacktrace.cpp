@@ -31,12 +31,15 @@
 #include <dlfcn.h>
 #include <inttypes.h>
 #include <malloc.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <unwind.h>
 #include <sys/types.h>
 
 #include "debug_mapinfo.h"
 #include "malloc_debug_disable.h"
+#include "pthread_internal.h"
+#include "private/bionic_frame_walk.h"
 #include "private/libc_logging.h"
 
 #if defined(__LP64__)
@@ -51,10 +54,27 @@ extern "C" char* __cxa_demangle(const char*, char*, size_t*, int*);
 
 static mapinfo_t* g_map_info = NULL;
 
+static bool g_use_frame_pointers = false;
+
+// The main thread's stack isn't described by its pthread_internal_t, so it's
+// looked up once at startup.
+static uintptr_t g_main_thread_stack_base = 0;
+static uintptr_t g_main_thread_stack_top = 0;
+
 __LIBC_HIDDEN__ void backtrace_startup() {
   ScopedDisableDebugCalls disable;
 
   g_map_info = mapinfo_create(getpid());
+
+  pthread_attr_t attr;
+  if (gettid() == getpid() && pthread_getattr_np(pthread_self(), &attr) == 0) {
+    void* stack_base;
+    size_t stack_size;
+    pthread_attr_getstack(&attr, &stack_base, &stack_size);
+    g_main_thread_stack_base = reinterpret_cast<uintptr_t>(stack_base);
+    g_main_thread_stack_top = g_main_thread_stack_base + stack_size;
+    pthread_attr_destroy(&attr);
+  }
 }
 
 __LIBC_HIDDEN__ void backtrace_shutdown() {
@@ -107,7 +127,42 @@ static _Unwind_Reason_Code trace_function(__unwind_context* context, void* arg)
   return (state->frame_count >= state->max_depth) ? _URC_END_OF_STACK : _URC_NO_REASON;
 }
 
+__LIBC_HIDDEN__ bool backtrace_use_frame_pointers() {
+#if defined(HAVE_BIONIC_FRAME_WALK)
+  g_use_frame_pointers = true;
+#endif
+  return g_use_frame_pointers;
+}
+
+#if defined(HAVE_BIONIC_FRAME_WALK)
+// Returns the top of the calling thread's stack if fp is on it, 0 otherwise
+// (on an alternate signal stack, say).
+static uintptr_t get_stack_top(uintptr_t fp) {
+  uintptr_t base = g_main_thread_stack_base;
+  uintptr_t top = g_main_thread_stack_top;
+  pthread_internal_t* thread = __get_thread();
+  if (thread != NULL && thread->attr.stack_size != 0) {
+    base = reinterpret_cast<uintptr_t>(thread->attr.stack_base);
+    top = base + thread->attr.stack_size;
+  }
+  return (fp >= base && fp < top) ? top : 0;
+}
+#endif
+
 __LIBC_HIDDEN__ int get_backtrace(uintptr_t* frames, size_t max_depth) {
+#if defined(HAVE_BIONIC_FRAME_WALK)
+  // This function's own frame record holds the return address into its
+  // caller, which is where the unwinder's backtrace starts too. Walking the
+  // records doesn't allocate, so there's no need to disable the debug calls.
+  if (g_use_frame_pointers) {
+    uintptr_t fp = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    uintptr_t stack_top = get_stack_top(fp);
+    if (stack_top != 0) {
+      return walk_frame_records(fp, stack_top, frames, max_depth);
+    }
+  }
+#endif
+
   ScopedDisableDebugCalls disable;
 
   stack_crawl_state_t state(frames, max_depth);
@@ -35,6 +35,9 @@
 __LIBC_HIDDEN__ void backtrace_startup();
 __LIBC_HIDDEN__ void backtrace_shutdown();
 __LIBC_HIDDEN__ int get_backtrace(uintptr_t* stack_frames, size_t max_depth);
+// Makes get_backtrace walk frame pointers rather than use the unwind tables,
+// if the architecture allows it. Returns whether it does.
+__LIBC_HIDDEN__ bool backtrace_use_frame_pointers();
 __LIBC_HIDDEN__ void log_backtrace(uintptr_t* stack_frames, size_t frame_count);
 
 #endif /* DEBUG_STACKTRACE_H */
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dlmalloc_thread_cache.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dlmalloc.h"
+#include "malloc_info.h"
+#include "pthread_internal.h"
+
+// Size classes are the multiples of 16 bytes up to 256 bytes.
+static constexpr size_t kClassShift = 4;
+static constexpr size_t kClassCount = 16;
+
+// A thread holds on to at most this many blocks of each class, which bounds
+// a cache to about 68KiB. When a class is full, half of it goes back to
+// dlmalloc in a single dlbulk_free call.
+static constexpr size_t kMaxBlocksPerClass = 32;
+
+// Every kScavengeInterval operations on a cache, half of the blocks that
+// stayed unused since the previous scavenge go back to dlmalloc, so that a
+// thread that mostly stopped allocating doesn't keep its cache forever.
+//
+// Only the owner thread can scavenge its cache, so a thread that doesn't
+// call malloc or free at all keeps its blocks. dlmalloc_trim asks every
+// cache to drain, which the other threads do on their next operation.
+static constexpr uint32_t kScavengeInterval = 4096;
+
+// Stored in pthread_internal_t::malloc_thread_cache once the thread has
+// started exiting, so that the last allocations of the thread don't create
+// a new cache.
+static void* const kThreadCacheDisabled = reinterpret_cast<void*>(UINTPTR_MAX);
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct ThreadCacheBin {
+  FreeBlock* head;
+  // The lowest count since the last scavenge.
+  size_t low_water;
+  atomic_size_t count;
+};
+
+// Caches are never freed: the cache of an exited thread is handed to the
+// next thread that needs one. This keeps the list lock-free (and so safe
+// across fork), and keeps the counters of the exited threads.
+//
+// Only the owner thread modifies a cache; the counters are atomic so that
+// mallinfo and malloc_info can read them from any thread.
+struct ThreadCache {
+  ThreadCache* next;
+  atomic_bool in_use;
+  // Set by dlmalloc_tc_trim from any thread.
+  atomic_bool drain_requested;
+
+  uint32_t ops_until_scavenge;
+  ThreadCacheBin bins[kClassCount];
+
+  atomic_size_t hits;
+  atomic_size_t misses;
+  atomic_size_t released;
+};
+
+static _Atomic(ThreadCache*) g_thread_caches;
+
+static inline size_t class_size(size_t cls) {
+  return (cls + 1) << kClassShift;
+}
+
+// Only ever called by the owner of the counter, so there's no need for
+// an atomic read-modify-write.
+static inline void owner_add(atomic_size_t* counter, size_t n) {
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+static void release_blocks(ThreadCache* cache, size_t cls, size_t n) {
+  ThreadCacheBin* bin = &cache->bins[cls];
+  void* blocks[kMaxBlocksPerClass];
+  size_t count = atomic_load_explicit(&bin->count, memory_order_relaxed);
+  size_t i = 0;
+  while (i < n && bin->head != nullptr) {
+    blocks[i++] = bin->head;
+    bin->head = bin->head->next;
+  }
+  atomic_store_explicit(&bin->count, count - i, memory_order_relaxed);
+  if (bin->low_water > count - i) {
+    bin->low_water = count - i;
+  }
+  if (i != 0) {
+    dlbulk_free(blocks, i);
+    owner_add(&cache->released, i);
+  }
+}
+
+// Gives all the blocks of the cache back to dlmalloc.
+static void drain(ThreadCache* cache) {
+  for (size_t cls = 0; cls < kClassCount; ++cls) {
+    while (cache->bins[cls].head != nullptr) {
+      release_blocks(cache, cls, kMaxBlocksPerClass);
+    }
+    atomic_store_explicit(&cache->bins[cls].count, 0, memory_order_relaxed);
+    cache->bins[cls].low_water = 0;
+  }
+  cache->ops_until_scavenge = kScavengeInterval;
+}
+
+static void scavenge(ThreadCache* cache) {
+  if (atomic_exchange_explicit(&cache->drain_requested, false, memory_order_relaxed)) {
+    drain(cache);
+    return;
+  }
+
+  cache->ops_until_scavenge = kScavengeInterval;
+  for (size_t cls = 0; cls < kClassCount; ++cls) {
+    ThreadCacheBin* bin = &cache->bins[cls];
+    size_t unused = bin->low_water;
+    if (unused != 0) {
+      release_blocks(cache, cls, (unused + 1) / 2);
+    }
+    bin->low_water = atomic_load_explicit(&bin->count, memory_order_relaxed);
+  }
+}
+
+static ThreadCache* claim_thread_cache() {
+  ThreadCache* head = atomic_load_explicit(&g_thread_caches, memory_order_acquire);
+  for (ThreadCache* cache = head; cache != nullptr; cache = cache->next) {
+    bool expected = false;
+    if (!atomic_load_explicit(&cache->in_use, memory_order_relaxed) &&
+        atomic_compare_exchange_strong_explicit(&cache->in_use, &expected, true,
+                                                memory_order_acquire, memory_order_relaxed)) {
+      return cache;
+    }
+  }
+
+  ThreadCache* cache = reinterpret_cast<ThreadCache*>(dlmalloc(sizeof(ThreadCache)));
+  if (cache == nullptr) {
+    return nullptr;
+  }
+  memset(cache, 0, sizeof(ThreadCache));
+  atomic_init(&cache->in_use, true);
+  cache->ops_until_scavenge = kScavengeInterval;
+
+  cache->next = head;
+  while (!atomic_compare_exchange_weak_explicit(&g_thread_caches, &cache->next, cache,
+                                                memory_order_release, memory_order_relaxed)) {
+  }
+  return cache;
+}
+
+static inline ThreadCache* get_thread_cache() {
+  pthread_internal_t* thread = __get_thread();
+  if (__predict_false(thread == nullptr)) {
+    return nullptr;
+  }
+
+  void* cache = thread->malloc_thread_cache;
+  if (__predict_true(cache != nullptr)) {
+    return (cache == kThreadCacheDisabled) ? nullptr : reinterpret_cast<ThreadCache*>(cache);
+  }
+
+  ThreadCache* new_cache = claim_thread_cache();
+  thread->malloc_thread_cache = new_cache;
+  return new_cache;
+}
+
+static inline void tick(ThreadCache* cache) {
+  if (__predict_false(--cache->ops_until_scavenge == 0 ||
+                      atomic_load_explicit(&cache->drain_requested, memory_order_relaxed))) {
+    scavenge(cache);
+  }
+}
+
+// Returns a cached block of class cls, or nullptr.
+static inline void* pop_block(ThreadCache* cache, size_t cls) {
+  ThreadCacheBin* bin = &cache->bins[cls];
+  FreeBlock* block = bin->head;
+  if (block == nullptr) {
+    owner_add(&cache->misses, 1);
+    return nullptr;
+  }
+
+  bin->head = block->next;
+  size_t count = atomic_load_explicit(&bin->count, memory_order_relaxed) - 1;
+  atomic_store_explicit(&bin->count, count, memory_order_relaxed);
+  if (count < bin->low_water) {
+    bin->low_water = count;
+  }
+  owner_add(&cache->hits, 1);
+  return block;
+}
+
+void* dlmalloc_tc_malloc(size_t bytes) {
+  if (bytes > (kClassCount << kClassShift)) {
+    return dlmalloc(bytes);
+  }
+  ThreadCache* cache = get_thread_cache();
+  if (cache == nullptr) {
+    return dlmalloc(bytes);
+  }
+
+  tick(cache);
+  size_t cls = (bytes == 0) ? 0 : (bytes - 1) >> kClassShift;
+  void* mem = pop_block(cache, cls);
+  if (mem == nullptr) {
+    // Ask for the whole class, so that the block can be reused for any
+    // request of that class once it's freed.
+    mem = dlmalloc(class_size(cls));
+  }
+  return mem;
+}
+
+void* dlmalloc_tc_calloc(size_t n_elements, size_t elem_size) {
+  size_t bytes;
+  if (__builtin_mul_overflow(n_elements, elem_size, &bytes) ||
+      bytes > (kClassCount << kClassShift)) {
+    return dlcalloc(n_elements, elem_size);
+  }
+  ThreadCache* cache = get_thread_cache();
+  if (cache == nullptr) {
+    return dlcalloc(n_elements, elem_size);
+  }
+
+  tick(cache);
+  size_t cls = (bytes == 0) ? 0 : (bytes - 1) >> kClassShift;
+  void* mem = pop_block(cache, cls);
+  if (mem == nullptr) {
+    return dlcalloc(1, class_size(cls));
+  }
+  memset(mem, 0, class_size(cls));
+  return mem;
+}
+
+void dlmalloc_tc_free(void* mem) {
+  if (mem == nullptr) {
+    return;
+  }
+  ThreadCache* cache = get_thread_cache();
+  if (cache == nullptr) {
+    dlfree(mem);
+    return;
+  }
+
+  // The block can serve any request of the largest class it can hold, wherever
+  // it was allocated from.
+  size_t usable = dlmalloc_usable_size(mem) >> kClassShift;
+  if (usable == 0 || usable > kClassCount) {
+    dlfree(mem);
+    return;
+  }
+  size_t cls = usable - 1;
+
+  tick(cache);
+  ThreadCacheBin* bin = &cache->bins[cls];
+  if (atomic_load_explicit(&bin->count, memory_order_relaxed) == kMaxBlocksPerClass) {
+    release_blocks(cache, cls, kMaxBlocksPerClass / 2);
+  }
+  FreeBlock* block = reinterpret_cast<FreeBlock*>(mem);
+  block->next = bin->head;
+  bin->head = block;
+  owner_add(&bin->count, 1);
+}
+
+void dlmalloc_tc_thread_exit() {
+  pthread_internal_t* thread = __get_thread();
+  void* cache = thread->malloc_thread_cache;
+  thread->malloc_thread_cache = kThreadCacheDisabled;
+  if (cache == nullptr || cache == kThreadCacheDisabled) {
+    return;
+  }
+
+  ThreadCache* tc = reinterpret_cast<ThreadCache*>(cache);
+  drain(tc);
+  atomic_store_explicit(&tc->drain_requested, false, memory_order_relaxed);
+  atomic_store_explicit(&tc->in_use, false, memory_order_release);
+}
+
+void dlmalloc_tc_trim() {
+  pthread_internal_t* thread = __get_thread();
+  void* own_cache = (thread != nullptr) ? thread->malloc_thread_cache : nullptr;
+
+  ThreadCache* cache = atomic_load_explicit(&g_thread_caches, memory_order_acquire);
+  for (; cache != nullptr; cache = cache->next) {
+    if (cache == own_cache) {
+      drain(cache);
+    } else if (atomic_load_explicit(&cache->in_use, memory_order_relaxed)) {
+      atomic_store_explicit(&cache->drain_requested, true, memory_order_relaxed);
+    }
+  }
+}
+
+void dlmalloc_tc_fork_child() {
+  // The other threads are gone, along with any chance of them draining
+  // their caches, so drain them here and let new threads reuse them.
+  void* own_cache = __get_thread()->malloc_thread_cache;
+  ThreadCache* cache = atomic_load_explicit(&g_thread_caches, memory_order_acquire);
+  for (; cache != nullptr; cache = cache->next) {
+    if (cache != own_cache && atomic_load_explicit(&cache->in_use, memory_order_relaxed)) {
+      drain(cache);
+      atomic_store_explicit(&cache->drain_requested, false, memory_order_relaxed);
+      atomic_store_explicit(&cache->in_use, false, memory_order_relaxed);
+    }
+  }
+}
+
+struct mallinfo __mallinfo_thread_cache_info() {
+  struct mallinfo mi;
+  memset(&mi, 0, sizeof(mi));
+  ThreadCache* cache = atomic_load_explicit(&g_thread_caches, memory_order_acquire);
+  for (; cache != nullptr; cache = cache->next) {
+    if (atomic_load_explicit(&cache->in_use, memory_order_relaxed)) {
+      mi.ordblks++;
+    }
+    for (size_t cls = 0; cls < kClassCount; ++cls) {
+      size_t count = atomic_load_explicit(&cache->bins[cls].count, memory_order_relaxed);
+      mi.smblks += count;
+      mi.fsmblks += count * class_size(cls);
+    }
+    mi.uordblks += atomic_load_explicit(&cache->hits, memory_order_relaxed);
+    mi.fordblks += atomic_load_explicit(&cache->misses, memory_order_relaxed);
+    mi.keepcost += atomic_load_explicit(&cache->released, memory_order_relaxed);
+  }
+  return mi;
+}
+
+struct mallinfo dlmalloc_tc_mallinfo() {
+  struct mallinfo mi = dlmallinfo();
+  struct mallinfo tc = __mallinfo_thread_cache_info();
+
+  // dlmalloc counts the cached blocks as allocated.
+  size_t cached = (tc.fsmblks < mi.uordblks) ? tc.fsmblks : mi.uordblks;
+  mi.smblks = tc.smblks;
+  mi.fsmblks = cached;
+  mi.uordblks -= cached;
+  mi.fordblks += cached;
+  return mi;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBC_BIONIC_DLMALLOC_THREAD_CACHE_H_
+#define LIBC_BIONIC_DLMALLOC_THREAD_CACHE_H_
+
+#include <malloc.h>
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+// A per-thread cache of small blocks in front of dlmalloc, so that most small
+// allocations and frees don't take dlmalloc's global lock. The cached blocks
+// are ordinary dlmalloc chunks, so realloc, memalign, malloc_usable_size and
+// friends keep going straight to dlmalloc.
+__LIBC_HIDDEN__ void* dlmalloc_tc_calloc(size_t n_elements, size_t elem_size);
+__LIBC_HIDDEN__ void dlmalloc_tc_free(void* mem);
+__LIBC_HIDDEN__ struct mallinfo dlmalloc_tc_mallinfo(void);
+__LIBC_HIDDEN__ void* dlmalloc_tc_malloc(size_t bytes);
+
+// Gives the calling thread's cached blocks back to dlmalloc, and stops
+// caching for that thread. Called by pthread_exit.
+__LIBC_HIDDEN__ void dlmalloc_tc_thread_exit(void);
+
+// Gives the calling thread's cached blocks back to dlmalloc, and makes every
+// other thread do the same on its next malloc or free. Called by
+// dlmalloc_trim.
+__LIBC_HIDDEN__ void dlmalloc_tc_trim(void);
+
+// Gives the blocks cached by the threads that didn't survive fork back to
+// dlmalloc. Called in the child by fork.
+__LIBC_HIDDEN__ void dlmalloc_tc_fork_child(void);
+
+__END_DECLS
+
+#endif  // LIBC_BIONIC_DLMALLOC_THREAD_CACHE_H_
@@ -31,6 +31,9 @@
 
 #include "pthread_internal.h"
 
+// Only there when libc is built with dlmalloc (see dlmalloc_thread_cache.h).
+extern "C" void dlmalloc_tc_fork_child() __attribute__((weak));
+
 #define FORK_FLAGS (CLONE_CHILD_SETTID | CLONE_CHILD_CLEARTID | SIGCHLD)
 
 int fork() {
@@ -48,6 +51,9 @@ int fork() {
 #endif
   if (result == 0) {
     self->set_cached_pid(gettid());
+    if (dlmalloc_tc_fork_child) {
+      dlmalloc_tc_fork_child();
+    }
     __bionic_atfork_run_child();
   } else {
     self->set_cached_pid(parent_pid);
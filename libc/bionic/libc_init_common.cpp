@@ -251,10 +251,12 @@ static bool __is_unsafe_environment_variable(const char* name) {
       "LD_DEBUG_OUTPUT",
       "LD_DYNAMIC_WEAK",
       "LD_LIBRARY_PATH",
+      "LD_LOAD_PROFILE",
       "LD_ORIGIN_PATH",
       "LD_PRELOAD",
       "LD_PROFILE",
       "LD_SHOW_AUXV",
+      "LD_SYMBOL_CACHE_DIR",
       "LD_USE_LOAD_BIAS",
       "LOCALDOMAIN",
       "LOCPATH",
@@ -687,7 +687,11 @@ static void ReportMemoryLeaks() {
 
 pthread_key_t g_debug_calls_disabled;
 
-extern "C" bool malloc_debug_initialize(HashTable* hash_table, const MallocDebug* malloc_dispatch) {
+// Defined in malloc_debug_sample.cpp.
+extern void sample_initialize();
+
+extern "C" bool malloc_debug_initialize(HashTable* hash_table, const MallocDebug* malloc_dispatch,
+                                        int debug_level) {
   g_hash_table = hash_table;
   g_malloc_dispatch = malloc_dispatch;
 
@@ -706,10 +710,20 @@ extern "C" bool malloc_debug_initialize(HashTable* hash_table, const MallocDebug
     __libc_format_log(ANDROID_LOG_INFO, "libc", "not gathering backtrace information\n");
   }
 
-  if (__system_property_get("libc.debug.malloc", env)) {
-    if(atoi(env) == 40) malloc_sig_enabled = 1;
+  // Walking frame pointers is much cheaper than unwinding, but only sees
+  // code built with -fno-omit-frame-pointer.
+  if (__system_property_get("libc.debug.malloc.unwinder", env) && strcmp(env, "fp") == 0) {
+    if (backtrace_use_frame_pointers()) {
+      info_log("%s: using frame pointers for backtraces\n", getprogname());
+    } else {
+      error_log("%s: frame pointer backtraces aren't supported on this architecture\n",
+                getprogname());
+    }
   }
 
+  if (debug_level == 40) malloc_sig_enabled = 1;
+  if (debug_level == 50) sample_initialize();
+
   if (malloc_sig_enabled) {
     char debug_proc_size[PROP_VALUE_MAX];
     if (__system_property_get("libc.debug.malloc.maxprocsize", debug_proc_size))
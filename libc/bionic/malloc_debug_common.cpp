@@ -39,6 +39,9 @@
 
 #include "malloc_debug_common.h"
 
+#include <dlfcn.h>
+#include <errno.h>
+#include <link.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
@@ -46,11 +49,15 @@
 
 #include "private/ScopedPthreadMutexLocker.h"
 
-#if defined(USE_JEMALLOC)
+#include "dlmalloc.h"
+#include "dlmalloc_thread_cache.h"
 #include "jemalloc.h"
+#include "malloc_info.h"
+
+// The allocator used by default, and by libc for its own bookkeeping.
+#if defined(USE_JEMALLOC)
 #define Malloc(function)  je_ ## function
 #elif defined(USE_DLMALLOC)
-#include "dlmalloc.h"
 #define Malloc(function)  dl ## function
 #else
 #error "Either one of USE_DLMALLOC or USE_JEMALLOC must be defined."
@@ -62,26 +69,64 @@ int gMallocLeakZygoteChild = 0;
 static HashTable g_hash_table;
 
 // Support for malloc debugging.
-// Table for dispatching malloc calls, initialized with default dispatchers.
-static const MallocDebug __libc_malloc_default_dispatch __attribute__((aligned(32))) = {
-  Malloc(calloc),
-  Malloc(free),
-  Malloc(mallinfo),
-  Malloc(malloc),
-  Malloc(malloc_usable_size),
-  Malloc(memalign),
-  Malloc(posix_memalign),
+// Both allocators are linked in, so that the one in use can be chosen at
+// startup (see SelectMallocBackend). With dlmalloc, the small allocations go
+// through the per-thread cache first.
+static const MallocDebug __libc_dlmalloc_dispatch __attribute__((aligned(32))) = {
+  dlmalloc_tc_calloc,
+  dlmalloc_tc_free,
+  dlmalloc_tc_mallinfo,
+  dlmalloc_tc_malloc,
+  dlmalloc_usable_size,
+  dlmemalign,
+  dlposix_memalign,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  dlpvalloc,
+#endif
+  dlrealloc,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  dlvalloc,
+#endif
+};
+
+static const MallocDebug __libc_jemalloc_dispatch __attribute__((aligned(32))) = {
+  je_calloc,
+  je_free,
+  je_mallinfo,
+  je_malloc,
+  je_malloc_usable_size,
+  je_memalign,
+  je_posix_memalign,
 #if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
-  Malloc(pvalloc),
+  je_pvalloc,
 #endif
-  Malloc(realloc),
+  je_realloc,
 #if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
-  Malloc(valloc),
+  je_valloc,
 #endif
 };
 
+#if defined(USE_JEMALLOC)
+static constexpr const MallocDebug* __libc_malloc_default_dispatch = &__libc_jemalloc_dispatch;
+#else
+static constexpr const MallocDebug* __libc_malloc_default_dispatch = &__libc_dlmalloc_dispatch;
+#endif
+
+// The allocator backend in use, which the debug levels are layered on.
+static const MallocDebug* __libc_malloc_backend_dispatch = __libc_malloc_default_dispatch;
+
 // Selector of dispatch table to use for dispatching malloc calls.
-static const MallocDebug* __libc_malloc_dispatch = &__libc_malloc_default_dispatch;
+static const MallocDebug* __libc_malloc_dispatch = __libc_malloc_default_dispatch;
+
+extern "C" MallocInfoBackend __malloc_info_backend() {
+  if (__libc_malloc_backend_dispatch == &__libc_jemalloc_dispatch) {
+    return kMallocInfoJemalloc;
+  }
+  if (__libc_malloc_backend_dispatch == &__libc_dlmalloc_dispatch) {
+    return kMallocInfoDlmalloc;
+  }
+  return kMallocInfoOther;
+}
 
 // Handle to shared library where actual memory allocation is implemented.
 // This library is loaded and memory allocation calls are redirected there
@@ -92,13 +137,15 @@ static const MallocDebug* __libc_malloc_dispatch = &__libc_malloc_default_dispat
 //      CHK_SENTINEL_VALUE, and CHK_FILL_FREE macros.
 // 10 - For adding pre-, and post- allocation stubs in order to detect
 //      buffer overruns.
+// 50 - For sampling allocations with their backtraces, a heap profile of
+//      which can be written with write_malloc_sample_profile.
 // Note that emulator's memory allocation instrumentation is not controlled by
 // libc.debug.malloc value, but rather by emulator, started with -memcheck
 // option. Note also, that if emulator has started with -memcheck option,
 // emulator's instrumented memory allocation will take over value saved in
 // libc.debug.malloc. In other words, if emulator has started with -memcheck
 // option, libc.debug.malloc value is ignored.
-// Actual functionality for debug levels 1-10 is implemented in
+// Actual functionality for debug levels 1-10, 40 and 50 is implemented in
 // libc_malloc_debug_leak.so, while functionality for emulator's instrumented
 // allocations is implemented in libc_malloc_debug_qemu.so and can be run inside
 // the emulator only.
@@ -116,46 +163,69 @@ static int g_malloc_debug_level = 0;
 // output functions
 // =============================================================================
 
-static int hash_entry_compare(const void* arg1, const void* arg2) {
+// Compares two records of get_malloc_leak_info's output, which start with the
+// "size" and "allocations" fields of a HashEntry.
+static int leak_info_compare(const void* arg1, const void* arg2) {
   int result;
 
-  const HashEntry* e1 = *static_cast<HashEntry* const*>(arg1);
-  const HashEntry* e2 = *static_cast<HashEntry* const*>(arg2);
-
-  // if one or both arg pointers are null, deal gracefully
-  if (e1 == NULL) {
-    result = (e2 == NULL) ? 0 : 1;
-  } else if (e2 == NULL) {
+  const size_t* e1 = static_cast<const size_t*>(arg1);
+  const size_t* e2 = static_cast<const size_t*>(arg2);
+
+  size_t nbAlloc1 = e1[1];
+  size_t nbAlloc2 = e2[1];
+  size_t size1 = e1[0] & ~SIZE_FLAG_MASK;
+  size_t size2 = e2[0] & ~SIZE_FLAG_MASK;
+  size_t alloc1 = nbAlloc1 * size1;
+  size_t alloc2 = nbAlloc2 * size2;
+
+  // sort in descending order by:
+  // 1) total size
+  // 2) number of allocations
+  //
+  // This is used for sorting, not determination of equality, so we don't
+  // need to compare the bit flags.
+  if (alloc1 > alloc2) {
     result = -1;
+  } else if (alloc1 < alloc2) {
+    result = 1;
   } else {
-    size_t nbAlloc1 = e1->allocations;
-    size_t nbAlloc2 = e2->allocations;
-    size_t size1 = e1->size & ~SIZE_FLAG_MASK;
-    size_t size2 = e2->size & ~SIZE_FLAG_MASK;
-    size_t alloc1 = nbAlloc1 * size1;
-    size_t alloc2 = nbAlloc2 * size2;
-
-    // sort in descending order by:
-    // 1) total size
-    // 2) number of allocations
-    //
-    // This is used for sorting, not determination of equality, so we don't
-    // need to compare the bit flags.
-    if (alloc1 > alloc2) {
+    if (nbAlloc1 > nbAlloc2) {
       result = -1;
-    } else if (alloc1 < alloc2) {
+    } else if (nbAlloc1 < nbAlloc2) {
       result = 1;
     } else {
-      if (nbAlloc1 > nbAlloc2) {
-        result = -1;
-      } else if (nbAlloc1 < nbAlloc2) {
-        result = 1;
+      result = 0;
+    }
+  }
+  return result;
+}
+
+// Copies at most max_count entries of the stripe to head, as records of
+// info_size bytes. Returns the number of records written.
+static size_t copy_stripe(HashStripe* stripe, uint8_t* head, size_t max_count,
+                          size_t info_size, size_t* totalMemory) {
+  ScopedPthreadMutexLocker locker(&stripe->lock);
+  size_t copied = 0;
+  for (size_t i = 0; i < stripe->bucket_count; ++i) {
+    for (HashEntry* entry = stripe->buckets[i]; entry != NULL; entry = entry->next) {
+      if (copied == max_count) {
+        return copied;
+      }
+      size_t entrySize = (sizeof(size_t) * 2) + (sizeof(uintptr_t) * entry->numEntries);
+      if (entrySize < info_size) {
+        // We're writing less than a full entry, clear out the rest.
+        memset(head + entrySize, 0, info_size - entrySize);
       } else {
-        result = 0;
+        // Make sure the amount we're copying doesn't exceed the limit.
+        entrySize = info_size;
       }
+      memcpy(head, &(entry->size), entrySize);
+      *totalMemory += (entry->size & ~SIZE_FLAG_MASK) * entry->allocations;
+      head += info_size;
+      ++copied;
     }
   }
-  return result;
+  return copied;
 }
 
 // Retrieve native heap information.
@@ -179,8 +249,16 @@ extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overallSize,
   }
   *totalMemory = 0;
 
-  ScopedPthreadMutexLocker locker(&g_hash_table.lock);
-  if (g_hash_table.count == 0) {
+  // The snapshot is taken one stripe at a time, so that allocating threads
+  // only ever wait for the copy of a single stripe, and is sorted once no
+  // lock is held. Entries recorded after the count below are left out.
+  size_t count = 0;
+  for (size_t i = 0 ; i < HASHTABLE_STRIPES ; ++i) {
+    HashStripe* stripe = &g_hash_table.stripes[i];
+    ScopedPthreadMutexLocker locker(&stripe->lock);
+    count += stripe->count;
+  }
+  if (count == 0) {
     *info = NULL;
     *overallSize = 0;
     *infoSize = 0;
@@ -188,58 +266,51 @@ extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overallSize,
     return;
   }
 
-  HashEntry** list = static_cast<HashEntry**>(Malloc(malloc)(sizeof(void*) * g_hash_table.count));
-
-  // Get the entries into an array to be sorted.
-  size_t index = 0;
-  for (size_t i = 0 ; i < HASHTABLE_SIZE ; ++i) {
-    HashEntry* entry = g_hash_table.slots[i];
-    while (entry != NULL) {
-      list[index] = entry;
-      *totalMemory = *totalMemory + ((entry->size & ~SIZE_FLAG_MASK) * entry->allocations);
-      index++;
-      entry = entry->next;
-    }
-  }
-
   // XXX: the protocol doesn't allow variable size for the stack trace (yet)
   *infoSize = (sizeof(size_t) * 2) + (sizeof(uintptr_t) * BACKTRACE_SIZE);
-  *overallSize = *infoSize * g_hash_table.count;
   *backtraceSize = BACKTRACE_SIZE;
 
   // now get a byte array big enough for this
-  *info = static_cast<uint8_t*>(Malloc(malloc)(*overallSize));
+  *info = static_cast<uint8_t*>(Malloc(malloc)(*infoSize * count));
   if (*info == NULL) {
     *overallSize = 0;
-    Malloc(free)(list);
     return;
   }
 
-  qsort(list, g_hash_table.count, sizeof(void*), hash_entry_compare);
-
-  uint8_t* head = *info;
-  const size_t count = g_hash_table.count;
-  for (size_t i = 0 ; i < count ; ++i) {
-    HashEntry* entry = list[i];
-    size_t entrySize = (sizeof(size_t) * 2) + (sizeof(uintptr_t) * entry->numEntries);
-    if (entrySize < *infoSize) {
-      // We're writing less than a full entry, clear out the rest.
-      memset(head + entrySize, 0, *infoSize - entrySize);
-    } else {
-      // Make sure the amount we're copying doesn't exceed the limit.
-      entrySize = *infoSize;
-    }
-    memcpy(head, &(entry->size), entrySize);
-    head += *infoSize;
+  size_t copied = 0;
+  for (size_t i = 0 ; i < HASHTABLE_STRIPES && copied < count ; ++i) {
+    copied += copy_stripe(&g_hash_table.stripes[i], *info + *infoSize * copied,
+                          count - copied, *infoSize, totalMemory);
   }
+  *overallSize = *infoSize * copied;
 
-  Malloc(free)(list);
+  qsort(*info, copied, *infoSize, leak_info_compare);
 }
 
 extern "C" void free_malloc_leak_info(uint8_t* info) {
   Malloc(free)(info);
 }
 
+// Writes the heap profile gathered by libc.debug.malloc level 50 to fd, in the
+// text format of pprof's heap profiles. Returns 0 on success, or -1 with errno
+// set to ENOTSUP if the sampling profiler isn't running.
+extern "C" int write_malloc_sample_profile(int fd) {
+#if !defined(LIBC_STATIC)
+  if (libc_malloc_impl_handle != NULL && g_malloc_debug_level == 50) {
+    typedef int (*MallocSampleWriteProfile)(int);
+    MallocSampleWriteProfile write_profile = reinterpret_cast<MallocSampleWriteProfile>(
+        dlsym(libc_malloc_impl_handle, "sample_write_profile"));
+    if (write_profile != NULL) {
+      return write_profile(fd);
+    }
+  }
+#else
+  (void) fd;
+#endif
+  errno = ENOTSUP;
+  return -1;
+}
+
 // =============================================================================
 // Allocation functions
 // =============================================================================
@@ -290,6 +361,7 @@ extern "C" void* valloc(size_t bytes) {
 // We implement malloc debugging only in libc.so, so the code below
 // must be excluded if we compile this file for static libc.a
 #ifndef LIBC_STATIC
+#include <sys/auxv.h>
 #include <sys/system_properties.h>
 #include <dlfcn.h>
 #include <stdio.h>
@@ -325,6 +397,152 @@ static void InitMalloc(void* malloc_impl_handler, MallocDebug* table, const char
 #endif
 }
 
+static bool IsMallocTableComplete(const MallocDebug* table) {
+  return (table->calloc != NULL) &&
+      (table->free != NULL) &&
+      (table->mallinfo != NULL) &&
+      (table->malloc != NULL) &&
+      (table->malloc_usable_size != NULL) &&
+      (table->memalign != NULL) &&
+      (table->posix_memalign != NULL) &&
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+      (table->pvalloc != NULL) &&
+#endif
+      (table->realloc != NULL)
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+      && (table->valloc != NULL)
+#endif
+      ;
+}
+
+// The only libraries a backend library may depend on. None of them allocates
+// from its constructors.
+static const char* const kMallocBackendNeeded[] = { "libc.so", "libdl.so", "libm.so" };
+
+struct MallocBackendNeededCheck {
+  ElfW(Addr) table;
+  const char* name;
+  bool found;
+  bool ok;
+};
+
+static bool IsAllowedMallocBackendNeeded(const char* needed) {
+  const char* base_name = strrchr(needed, '/');
+  base_name = (base_name == NULL) ? needed : base_name + 1;
+  for (size_t i = 0; i < sizeof(kMallocBackendNeeded) / sizeof(kMallocBackendNeeded[0]); ++i) {
+    if (strcmp(base_name, kMallocBackendNeeded[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Checks the DT_NEEDED entries of the library that contains check->table.
+static int CheckMallocBackendNeeded(struct dl_phdr_info* info, size_t, void* data) {
+  MallocBackendNeededCheck* check = reinterpret_cast<MallocBackendNeededCheck*>(data);
+  const ElfW(Phdr)* dynamic_phdr = NULL;
+  bool contains_table = false;
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+    if (phdr->p_type == PT_LOAD) {
+      ElfW(Addr) start = info->dlpi_addr + phdr->p_vaddr;
+      if (check->table >= start && check->table < start + phdr->p_memsz) {
+        contains_table = true;
+      }
+    } else if (phdr->p_type == PT_DYNAMIC) {
+      dynamic_phdr = phdr;
+    }
+  }
+  if (!contains_table) {
+    return 0;
+  }
+
+  check->found = true;
+  check->ok = true;
+  if (dynamic_phdr == NULL) {
+    return 1;
+  }
+
+  // The linker doesn't relocate the dynamic section, so the addresses in it
+  // are still relative to the load bias.
+  const ElfW(Dyn)* dynamic =
+      reinterpret_cast<const ElfW(Dyn)*>(info->dlpi_addr + dynamic_phdr->p_vaddr);
+  const char* strtab = NULL;
+  for (const ElfW(Dyn)* d = dynamic; d->d_tag != DT_NULL; ++d) {
+    if (d->d_tag == DT_STRTAB) {
+      strtab = reinterpret_cast<const char*>(info->dlpi_addr + d->d_un.d_ptr);
+    }
+  }
+  for (const ElfW(Dyn)* d = dynamic; d->d_tag != DT_NULL; ++d) {
+    if (d->d_tag == DT_NEEDED &&
+        (strtab == NULL || !IsAllowedMallocBackendNeeded(strtab + d->d_un.d_val))) {
+      check->ok = false;
+      check->name = (strtab == NULL) ? "?" : strtab + d->d_un.d_val;
+      break;
+    }
+  }
+  return 1;
+}
+
+// Chooses the allocator: "dlmalloc", "jemalloc", or the name of a shared
+// library that exports a complete MallocDebug table as
+// "malloc_backend_dispatch". LIBC_MALLOC_BACKEND in the environment (ignored
+// for AT_SECURE processes) takes precedence over the libc.malloc.backend
+// system property, so that a single service can be switched from its .rc file.
+//
+// This runs from libc's constructor, before anything else could have
+// allocated. The backend library's constructors, and those of its
+// dependencies, still run on the default allocator, and anything they
+// allocate would later be freed into the backend. So a backend library must
+// not allocate from its own constructors, and it may only depend on the
+// libraries in kMallocBackendNeeded: one with any other dependency is
+// rejected, and the default allocator stays in use.
+static const MallocDebug* SelectMallocBackend() {
+  char property[PROP_VALUE_MAX];
+  const char* name = getauxval(AT_SECURE) ? NULL : getenv("LIBC_MALLOC_BACKEND");
+  if (name == NULL || *name == '\0') {
+    if (__system_property_get("libc.malloc.backend", property) == 0) {
+      return __libc_malloc_default_dispatch;
+    }
+    name = property;
+  }
+
+  if (strcmp(name, "dlmalloc") == 0) {
+    return &__libc_dlmalloc_dispatch;
+  }
+  if (strcmp(name, "jemalloc") == 0) {
+    return &__libc_jemalloc_dispatch;
+  }
+
+  void* backend_handle = dlopen(name, RTLD_NOW);
+  if (backend_handle == NULL) {
+    error_log("%s: Missing malloc backend %s: %s", getprogname(), name, dlerror());
+    return __libc_malloc_default_dispatch;
+  }
+  const MallocDebug* table =
+      reinterpret_cast<const MallocDebug*>(dlsym(backend_handle, "malloc_backend_dispatch"));
+  if (table == NULL || !IsMallocTableComplete(table)) {
+    error_log("%s: %s doesn't export a complete malloc_backend_dispatch table",
+              getprogname(), name);
+    dlclose(backend_handle);
+    return __libc_malloc_default_dispatch;
+  }
+
+  MallocBackendNeededCheck check = { reinterpret_cast<ElfW(Addr)>(table), NULL, false, false };
+  dl_iterate_phdr(CheckMallocBackendNeeded, &check);
+  if (!check.ok) {
+    error_log("%s: malloc backend %s depends on %s; it may only depend on libc, libdl and libm",
+              getprogname(), name, check.found ? check.name : "unknown libraries");
+    dlclose(backend_handle);
+    return __libc_malloc_default_dispatch;
+  }
+
+  __libc_format_log(ANDROID_LOG_INFO, "libc", "%s: using malloc backend %s\n",
+                    getprogname(), name);
+  // The library is never unloaded: it owns everything allocated from now on.
+  return table;
+}
+
 // Initializes memory allocation framework once per process.
 static void malloc_init_impl() {
   const char* so_name = NULL;
@@ -335,6 +553,10 @@ static void malloc_init_impl() {
   char memcheck_tracing[PROP_VALUE_MAX];
   char debug_program[PROP_VALUE_MAX];
 
+  // The debug levels below wrap whichever allocator is selected here.
+  __libc_malloc_backend_dispatch = SelectMallocBackend();
+  __libc_malloc_dispatch = __libc_malloc_backend_dispatch;
+
   // Get custom malloc debug level. Note that emulator started with
   // memory checking option will have priority over debug level set in
   // libc.debug.malloc system property.
@@ -350,7 +572,12 @@ static void malloc_init_impl() {
   }
 
   // If debug level has not been set by memcheck option in the emulator,
-  // lets grab it from libc.debug.malloc system property.
+  // lets grab it from the LIBC_DEBUG_MALLOC environment variable (which
+  // setuid/setgid programs ignore), or else libc.debug.malloc system property.
+  const char* debug_level_env = getauxval(AT_SECURE) ? NULL : getenv("LIBC_DEBUG_MALLOC");
+  if (g_malloc_debug_level == 0 && debug_level_env != NULL) {
+    g_malloc_debug_level = atoi(debug_level_env);
+  }
   if (g_malloc_debug_level == 0 && __system_property_get("libc.debug.malloc", env)) {
     g_malloc_debug_level = atoi(env);
   }
@@ -397,6 +624,7 @@ static void malloc_init_impl() {
       so_name = "libc_malloc_debug_qemu.so";
       break;
     case 40:
+    case 50:
       so_name = "libc_malloc_debug_leak.so";
       break;
     default:
@@ -420,7 +648,8 @@ static void malloc_init_impl() {
     dlclose(malloc_impl_handle);
     return;
   }
-  if (!malloc_debug_initialize(&g_hash_table, &__libc_malloc_default_dispatch)) {
+  if (!malloc_debug_initialize(&g_hash_table, __libc_malloc_backend_dispatch,
+                               g_malloc_debug_level)) {
     dlclose(malloc_impl_handle);
     return;
   }
@@ -462,26 +691,15 @@ static void malloc_init_impl() {
     case 40:
       InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "chk");
       break;
+    case 50:
+      InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "sample");
+      break;
     default:
       break;
   }
 
   // Make sure dispatch table is initialized
-  if ((malloc_dispatch_table.calloc == NULL) ||
-      (malloc_dispatch_table.free == NULL) ||
-      (malloc_dispatch_table.mallinfo == NULL) ||
-      (malloc_dispatch_table.malloc == NULL) ||
-      (malloc_dispatch_table.malloc_usable_size == NULL) ||
-      (malloc_dispatch_table.memalign == NULL) ||
-      (malloc_dispatch_table.posix_memalign == NULL) ||
-#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
-      (malloc_dispatch_table.pvalloc == NULL) ||
-#endif
-      (malloc_dispatch_table.realloc == NULL)
-#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
-      || (malloc_dispatch_table.valloc == NULL)
-#endif
-      ) {
+  if (!IsMallocTableComplete(&malloc_dispatch_table)) {
     error_log("%s: some symbols for libc.debug.malloc level %d were not found (see above)",
               getprogname(), g_malloc_debug_level);
     dlclose(malloc_impl_handle);
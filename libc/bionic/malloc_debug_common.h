@@ -40,7 +40,8 @@
 #include "private/bionic_config.h"
 #include "private/libc_logging.h"
 
-#define HASHTABLE_SIZE      1543
+#define HASHTABLE_STRIPES   64
+#define HASHTABLE_MIN_BUCKETS 64
 #define BACKTRACE_SIZE      32
 /* flag definitions, currently sharing storage with "size" */
 #define SIZE_FLAG_ZYGOTE_CHILD  (1<<31)
@@ -56,7 +57,7 @@
 // =============================================================================
 
 struct HashEntry {
-    size_t slot;
+    size_t hash;
     HashEntry* prev;
     HashEntry* next;
     size_t numEntries;
@@ -66,12 +67,32 @@ struct HashEntry {
     uintptr_t backtrace[0];
 };
 
-struct HashTable {
+// The table is split into stripes by hash, each with its own lock and its
+// own bucket array, so that threads recording different backtraces rarely
+// contend. A stripe's bucket array starts out with HASHTABLE_MIN_BUCKETS
+// buckets and doubles whenever the stripe holds more entries than buckets.
+struct HashStripe {
     pthread_mutex_t lock;
     size_t count;
-    HashEntry* slots[HASHTABLE_SIZE];
+    size_t bucket_count;
+    HashEntry** buckets;
+} __attribute__((aligned(64)));
+
+struct HashTable {
+    HashStripe stripes[HASHTABLE_STRIPES];
 };
 
+static inline HashStripe* hash_stripe(HashTable* table, size_t hash) {
+    // The top bits of a multiplicative hash, so that the stripe doesn't
+    // depend on the same bits as the bucket.
+    uint32_t mixed = static_cast<uint32_t>(hash) * 2654435769u;
+    return &table->stripes[mixed >> (32 - __builtin_ctz(HASHTABLE_STRIPES))];
+}
+
+static inline HashEntry** hash_bucket(HashStripe* stripe, size_t hash) {
+    return &stripe->buckets[hash & (stripe->bucket_count - 1)];
+}
+
 /* Entry in malloc dispatch table. */
 typedef void* (*MallocDebugCalloc)(size_t, size_t);
 typedef void (*MallocDebugFree)(void*);
@@ -105,7 +126,9 @@ struct MallocDebug {
 #endif
 };
 
-typedef bool (*MallocDebugInit)(HashTable*, const MallocDebug*);
+// Called with the libc.debug.malloc level in effect, which may have come from
+// LIBC_DEBUG_MALLOC rather than the property.
+typedef bool (*MallocDebugInit)(HashTable*, const MallocDebug*, int);
 typedef void (*MallocDebugFini)(int);
 
 // =============================================================================
@@ -99,9 +99,12 @@ static uint32_t get_hash(uintptr_t* backtrace, size_t numEntries) {
     return hash;
 }
 
-static HashEntry* find_entry(HashTable* table, int slot,
+static HashEntry* find_entry(HashStripe* stripe, size_t hash,
                              uintptr_t* backtrace, size_t numEntries, size_t size) {
-    HashEntry* entry = table->slots[slot];
+    if (stripe->buckets == NULL) {
+        return NULL;
+    }
+    HashEntry* entry = *hash_bucket(stripe, hash);
     while (entry != NULL) {
         //debug_log("backtrace: %p, entry: %p entry->backtrace: %p\n",
         //        backtrace, entry, (entry != NULL) ? entry->backtrace : NULL);
@@ -120,9 +123,44 @@ static HashEntry* find_entry(HashTable* table, int slot,
     return NULL;
 }
 
+static void insert_entry(HashStripe* stripe, HashEntry* entry) {
+    HashEntry** bucket = hash_bucket(stripe, entry->hash);
+    entry->prev = NULL;
+    entry->next = *bucket;
+    if (entry->next != NULL) {
+        entry->next->prev = entry;
+    }
+    *bucket = entry;
+}
+
+// Moves the stripe's entries to a bucket array of new_bucket_count buckets.
+// On allocation failure the stripe keeps its current buckets, which still
+// work, only with longer chains.
+static bool resize_stripe(HashStripe* stripe, size_t new_bucket_count) {
+    HashEntry** new_buckets =
+        static_cast<HashEntry**>(g_malloc_dispatch->calloc(new_bucket_count, sizeof(HashEntry*)));
+    if (new_buckets == NULL) {
+        return false;
+    }
+
+    HashEntry** old_buckets = stripe->buckets;
+    size_t old_bucket_count = stripe->bucket_count;
+    stripe->buckets = new_buckets;
+    stripe->bucket_count = new_bucket_count;
+    for (size_t i = 0; i < old_bucket_count; ++i) {
+        HashEntry* entry = old_buckets[i];
+        while (entry != NULL) {
+            HashEntry* next = entry->next;
+            insert_entry(stripe, entry);
+            entry = next;
+        }
+    }
+    g_malloc_dispatch->free(old_buckets);
+    return true;
+}
+
 static HashEntry* record_backtrace(uintptr_t* backtrace, size_t numEntries, size_t size) {
     size_t hash = get_hash(backtrace, numEntries);
-    size_t slot = hash % HASHTABLE_SIZE;
 
     if (size & SIZE_FLAG_MASK) {
         debug_log("malloc_debug: allocation %zx exceeds bit width\n", size);
@@ -134,33 +172,34 @@ static HashEntry* record_backtrace(uintptr_t* backtrace, size_t numEntries, size
     }
 
     // Keep the lock held for as little time as possible to prevent deadlocks.
-    ScopedPthreadMutexLocker locker(&g_hash_table->lock);
-    HashEntry* entry = find_entry(g_hash_table, slot, backtrace, numEntries, size);
+    HashStripe* stripe = hash_stripe(g_hash_table, hash);
+    ScopedPthreadMutexLocker locker(&stripe->lock);
+    HashEntry* entry = find_entry(stripe, hash, backtrace, numEntries, size);
     if (entry != NULL) {
         entry->allocations++;
     } else {
+        if (stripe->buckets == NULL && !resize_stripe(stripe, HASHTABLE_MIN_BUCKETS)) {
+            return NULL;
+        }
+
         // create a new entry
         entry = static_cast<HashEntry*>(g_malloc_dispatch->malloc(sizeof(HashEntry) + numEntries*sizeof(uintptr_t)));
         if (!entry) {
             return NULL;
         }
         entry->allocations = 1;
-        entry->slot = slot;
-        entry->prev = NULL;
-        entry->next = g_hash_table->slots[slot];
+        entry->hash = hash;
         entry->numEntries = numEntries;
         entry->size = size;
 
         memcpy(entry->backtrace, backtrace, numEntries * sizeof(uintptr_t));
 
-        g_hash_table->slots[slot] = entry;
+        insert_entry(stripe, entry);
 
-        if (entry->next != NULL) {
-            entry->next->prev = entry;
+        // we just added an entry, grow the stripe if it's getting crowded
+        if (++stripe->count > stripe->bucket_count) {
+            resize_stripe(stripe, stripe->bucket_count * 2);
         }
-
-        // we just added an entry, increase the size of the hashtable
-        g_hash_table->count++;
     }
 
     return entry;
@@ -168,20 +207,23 @@ static HashEntry* record_backtrace(uintptr_t* backtrace, size_t numEntries, size
 
 static int is_valid_entry(HashEntry* entry) {
   if (entry != NULL) {
-    for (size_t i = 0; i < HASHTABLE_SIZE; ++i) {
-      HashEntry* e1 = g_hash_table->slots[i];
-      while (e1 != NULL) {
-        if (e1 == entry) {
-          return 1;
+    for (size_t i = 0; i < HASHTABLE_STRIPES; ++i) {
+      HashStripe* stripe = &g_hash_table->stripes[i];
+      ScopedPthreadMutexLocker locker(&stripe->lock);
+      for (size_t j = 0; j < stripe->bucket_count; ++j) {
+        for (HashEntry* e1 = stripe->buckets[j]; e1 != NULL; e1 = e1->next) {
+          if (e1 == entry) {
+            return 1;
+          }
         }
-        e1 = e1->next;
       }
     }
   }
   return 0;
 }
 
-static void remove_entry(HashEntry* entry) {
+// Requires the lock of the entry's stripe.
+static void remove_entry(HashStripe* stripe, HashEntry* entry) {
   HashEntry* prev = entry->prev;
   HashEntry* next = entry->next;
 
@@ -190,11 +232,11 @@ static void remove_entry(HashEntry* entry) {
 
   if (prev == NULL) {
     // we are the head of the list. set the head to be next
-    g_hash_table->slots[entry->slot] = entry->next;
+    *hash_bucket(stripe, entry->hash) = entry->next;
   }
 
-  // we just removed and entry, decrease the size of the hashtable
-  g_hash_table->count--;
+  // we just removed and entry, decrease the size of the stripe
+  stripe->count--;
 }
 
 // =============================================================================
@@ -339,14 +381,18 @@ extern "C" void leak_free(void* mem) {
     }
   }
 
-  ScopedPthreadMutexLocker locker(&g_hash_table->lock);
   if (header->guard == GUARD || is_valid_entry(header->entry)) {
-    // decrement the allocations
+    // decrement the allocations; the entry can't go away before that since
+    // this allocation is one of them
     HashEntry* entry = header->entry;
-    entry->allocations--;
-    if (entry->allocations <= 0) {
-      remove_entry(entry);
-      g_malloc_dispatch->free(entry);
+    if (entry != NULL) {
+      HashStripe* stripe = hash_stripe(g_hash_table, entry->hash);
+      ScopedPthreadMutexLocker locker(&stripe->lock);
+      entry->allocations--;
+      if (entry->allocations <= 0) {
+        remove_entry(stripe, entry);
+        g_malloc_dispatch->free(entry);
+      }
     }
 
     // now free the memory!
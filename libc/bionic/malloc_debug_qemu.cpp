@@ -599,7 +599,7 @@ extern "C" void* qemu_instrumented_valloc(size_t);
  * Return:
  *  0 on success, or -1 on failure.
 */
-extern "C" bool malloc_debug_initialize(HashTable*, const MallocDebug* malloc_dispatch) {
+extern "C" bool malloc_debug_initialize(HashTable*, const MallocDebug* malloc_dispatch, int) {
     g_malloc_dispatch = malloc_dispatch;
 
     /* We will be using emulator's magic page to report memory allocation
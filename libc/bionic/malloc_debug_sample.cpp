@@ -0,0 +1,523 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sampling heap profiler, libc.debug.malloc level 50.
+//
+// Rather than tracking every allocation, this picks allocations as a Poisson
+// process over the allocated bytes, with a mean of one sample every
+// libc.debug.malloc.sample_interval bytes (512KiB by default). Only the
+// sampled allocations get a backtrace, so the cost stays low enough for
+// production services. write_malloc_sample_profile() writes the samples in
+// the format of pprof's heap profiles, which pprof scales back up.
+//
+// The allocations themselves are left untouched (there is no header), so a
+// free only has to check whether the pointer was sampled, which is a
+// lock-free lookup in a small open-addressing table. Each live sample keeps
+// its own backtrace until it is freed; a ring of the most recent samples,
+// live or not, provides the allocation history.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/system_properties.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug_stacktrace.h"
+#include "malloc_debug_backtrace.h"
+#include "malloc_debug_common.h"
+#include "malloc_debug_disable.h"
+
+#include "private/bionic_macros.h"
+#include "private/libc_logging.h"
+#include "private/ScopedPthreadMutexLocker.h"
+
+extern const MallocDebug* g_malloc_dispatch;
+
+// The most recent samples, live or not.
+static constexpr size_t kSampleRingSize = 4096;
+
+// Sampled pointers that haven't been freed yet. The table is kept at most
+// half full.
+static constexpr size_t kSampleTableBits = 14;
+static constexpr size_t kSampleTableSize = 1 << kSampleTableBits;
+static constexpr size_t kMaxLiveSamples = kSampleTableSize / 2;
+
+static size_t g_sample_interval = 512 * 1024;
+
+// =============================================================================
+// Per-thread sampling state
+// =============================================================================
+
+struct SampleThreadState {
+  size_t bytes_until_sample;
+  uint64_t random;
+};
+
+static pthread_key_t g_sample_state_key;
+
+static uint64_t next_random(SampleThreadState* state) {
+  // xorshift64*.
+  uint64_t x = state->random;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  state->random = x;
+  return x * 2685821657736338717ULL;
+}
+
+// Returns the number of bytes to allocate before the next sample, which is
+// exponentially distributed with a mean of g_sample_interval.
+static size_t next_sample_distance(SampleThreadState* state) {
+  // q is uniform in [1, 2^26], and log2(q / 2^26) is computed without libm:
+  // the log2 of the mantissa comes from a quadratic that's within 0.5%.
+  uint32_t q = static_cast<uint32_t>(next_random(state) >> 38) + 1;
+  int exponent = 31 - __builtin_clz(q);
+  double m = static_cast<double>(q) / static_cast<double>(1u << exponent);
+  double log2_m = (-0.34484843 * m + 2.02466578) * m - 1.67487759;
+  double log2_u = exponent + log2_m - 26;
+  double distance = -log2_u * M_LN2 * g_sample_interval;
+  return (distance < 1.0) ? 1 : static_cast<size_t>(distance);
+}
+
+static void free_thread_state(void* state) {
+  g_malloc_dispatch->free(state);
+}
+
+static SampleThreadState* get_thread_state() {
+  SampleThreadState* state =
+      reinterpret_cast<SampleThreadState*>(pthread_getspecific(g_sample_state_key));
+  if (__predict_true(state != NULL)) {
+    return state;
+  }
+
+  state = reinterpret_cast<SampleThreadState*>(g_malloc_dispatch->malloc(sizeof(*state)));
+  if (state == NULL) {
+    return NULL;
+  }
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  state->random = (static_cast<uint64_t>(gettid()) << 32) ^ now.tv_nsec ^
+      reinterpret_cast<uintptr_t>(state);
+  if (state->random == 0) {
+    state->random = 1;
+  }
+  state->bytes_until_sample = next_sample_distance(state);
+  pthread_setspecific(g_sample_state_key, state);
+  return state;
+}
+
+// The fast path of every allocation: counts the bytes down to the next sample.
+static inline bool should_sample(size_t bytes) {
+  SampleThreadState* state = get_thread_state();
+  if (state == NULL) {
+    return false;
+  }
+  if (__predict_true(state->bytes_until_sample > bytes)) {
+    state->bytes_until_sample -= bytes;
+    return false;
+  }
+  state->bytes_until_sample = next_sample_distance(state);
+  return true;
+}
+
+// =============================================================================
+// Sample records
+// =============================================================================
+
+// Records are only written with g_sample_lock held, and are read without it
+// by write_malloc_sample_profile: seq is odd while a record is being written.
+struct SampleRecord {
+  atomic_uint seq;
+  // False if the record was never used, or is a free live sample record.
+  bool used;
+  size_t size;
+  size_t depth;
+  uintptr_t frames[BACKTRACE_SIZE];
+};
+
+// The allocation history.
+static SampleRecord g_samples[kSampleRingSize];
+static size_t g_next_sample;
+
+// The live samples, and the indexes of the unused ones.
+static SampleRecord g_live_samples[kMaxLiveSamples];
+static uint32_t g_free_live_samples[kMaxLiveSamples];
+static size_t g_free_live_sample_count;
+
+static pthread_mutex_t g_sample_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Requires g_sample_lock.
+static void write_record(SampleRecord* record, bool used, size_t size, size_t depth,
+                         const uintptr_t* frames) {
+  unsigned seq = atomic_load_explicit(&record->seq, memory_order_relaxed);
+  atomic_store_explicit(&record->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  record->used = used;
+  record->size = size;
+  record->depth = depth;
+  if (depth != 0) {
+    memcpy(record->frames, frames, depth * sizeof(uintptr_t));
+  }
+  atomic_store_explicit(&record->seq, seq + 2, memory_order_release);
+}
+
+// =============================================================================
+// Live sample table
+// =============================================================================
+
+// Linear probing, with backward-shift deletion so there are no tombstones.
+// Modifications happen with g_sample_lock held and make seq odd; lookups
+// don't take the lock, and retry if seq changed under them.
+static atomic_uint g_table_seq;
+static atomic_size_t g_table_count;
+static atomic_uintptr_t g_table_keys[kSampleTableSize];
+static uint32_t g_table_values[kSampleTableSize];
+
+static inline size_t table_slot(uintptr_t key) {
+  return static_cast<size_t>(
+      (static_cast<uint64_t>(key >> 4) * 0x9e3779b97f4a7c15ULL) >> (64 - kSampleTableBits));
+}
+
+static inline size_t table_next(size_t slot) {
+  return (slot + 1) & (kSampleTableSize - 1);
+}
+
+static bool table_contains(uintptr_t key) {
+  while (true) {
+    unsigned seq = atomic_load_explicit(&g_table_seq, memory_order_acquire);
+    if ((seq & 1) == 0) {
+      bool found = false;
+      size_t slot = table_slot(key);
+      for (size_t i = 0; i < kSampleTableSize; ++i, slot = table_next(slot)) {
+        uintptr_t k = atomic_load_explicit(&g_table_keys[slot], memory_order_relaxed);
+        if (k == key || k == 0) {
+          found = (k == key);
+          break;
+        }
+      }
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&g_table_seq, memory_order_relaxed) == seq) {
+        return found;
+      }
+    }
+  }
+}
+
+static void table_begin_write() {
+  unsigned seq = atomic_load_explicit(&g_table_seq, memory_order_relaxed);
+  atomic_store_explicit(&g_table_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void table_end_write() {
+  unsigned seq = atomic_load_explicit(&g_table_seq, memory_order_relaxed);
+  atomic_store_explicit(&g_table_seq, seq + 1, memory_order_release);
+}
+
+// Requires g_sample_lock.
+// There is a free slot since there are at most kMaxLiveSamples keys.
+static void table_insert(uintptr_t key, uint32_t value) {
+  size_t count = atomic_load_explicit(&g_table_count, memory_order_relaxed);
+  size_t slot = table_slot(key);
+  while (atomic_load_explicit(&g_table_keys[slot], memory_order_relaxed) != 0) {
+    slot = table_next(slot);
+  }
+  table_begin_write();
+  g_table_values[slot] = value;
+  atomic_store_explicit(&g_table_keys[slot], key, memory_order_relaxed);
+  atomic_store_explicit(&g_table_count, count + 1, memory_order_relaxed);
+  table_end_write();
+}
+
+// Requires g_sample_lock.
+static bool table_remove(uintptr_t key, uint32_t* value) {
+  size_t slot = table_slot(key);
+  while (true) {
+    uintptr_t k = atomic_load_explicit(&g_table_keys[slot], memory_order_relaxed);
+    if (k == 0) {
+      return false;
+    }
+    if (k == key) {
+      break;
+    }
+    slot = table_next(slot);
+  }
+  *value = g_table_values[slot];
+
+  table_begin_write();
+  size_t hole = slot;
+  for (size_t next = table_next(hole); ; next = table_next(next)) {
+    uintptr_t k = atomic_load_explicit(&g_table_keys[next], memory_order_relaxed);
+    if (k == 0) {
+      break;
+    }
+    // An entry can move back into the hole unless its home slot is
+    // (cyclically) after the hole.
+    size_t home = table_slot(k);
+    bool stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+    if (!stays) {
+      atomic_store_explicit(&g_table_keys[hole], k, memory_order_relaxed);
+      g_table_values[hole] = g_table_values[next];
+      hole = next;
+    }
+  }
+  atomic_store_explicit(&g_table_keys[hole], 0, memory_order_relaxed);
+  atomic_store_explicit(&g_table_count,
+                        atomic_load_explicit(&g_table_count, memory_order_relaxed) - 1,
+                        memory_order_relaxed);
+  table_end_write();
+  return true;
+}
+
+// =============================================================================
+// Recording and forgetting samples
+// =============================================================================
+
+static void record_sample(void* ptr, size_t bytes) {
+  uintptr_t frames[BACKTRACE_SIZE];
+  size_t depth = GET_BACKTRACE(frames, BACKTRACE_SIZE);
+
+  ScopedPthreadMutexLocker locker(&g_sample_lock);
+  write_record(&g_samples[g_next_sample++ % kSampleRingSize], true, bytes, depth, frames);
+
+  // With too many live samples, this one still counts towards the
+  // allocations, but not as live since its free can't be seen.
+  if (g_free_live_sample_count > 0) {
+    uint32_t index = g_free_live_samples[--g_free_live_sample_count];
+    write_record(&g_live_samples[index], true, bytes, depth, frames);
+    table_insert(reinterpret_cast<uintptr_t>(ptr), index);
+  }
+}
+
+static inline bool is_sampled(void* ptr) {
+  return atomic_load_explicit(&g_table_count, memory_order_relaxed) != 0 &&
+      table_contains(reinterpret_cast<uintptr_t>(ptr));
+}
+
+// Requires g_sample_lock.
+static void forget_sample_locked(void* ptr) {
+  uint32_t index;
+  if (table_remove(reinterpret_cast<uintptr_t>(ptr), &index)) {
+    write_record(&g_live_samples[index], false, 0, 0, NULL);
+    g_free_live_samples[g_free_live_sample_count++] = index;
+  }
+}
+
+// Must be called before the memory goes back to the allocator, since the
+// address could be sampled again right after.
+static void forget_sample(void* ptr) {
+  if (is_sampled(ptr)) {
+    ScopedPthreadMutexLocker locker(&g_sample_lock);
+    forget_sample_locked(ptr);
+  }
+}
+
+static inline void* maybe_sample(void* ptr, size_t bytes) {
+  if (ptr != NULL && should_sample(bytes)) {
+    record_sample(ptr, bytes);
+  }
+  return ptr;
+}
+
+// =============================================================================
+// malloc sample functions
+// =============================================================================
+
+extern "C" void* sample_malloc(size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->malloc(bytes);
+  }
+  return maybe_sample(g_malloc_dispatch->malloc(bytes), bytes);
+}
+
+extern "C" void sample_free(void* mem) {
+  if (mem != NULL && !DebugCallsDisabled()) {
+    forget_sample(mem);
+  }
+  g_malloc_dispatch->free(mem);
+}
+
+extern "C" void* sample_calloc(size_t n_elements, size_t elem_size) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->calloc(n_elements, elem_size);
+  }
+  // On overflow, the allocation fails and the size doesn't matter.
+  return maybe_sample(g_malloc_dispatch->calloc(n_elements, elem_size), n_elements * elem_size);
+}
+
+extern "C" void* sample_realloc(void* mem, size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->realloc(mem, bytes);
+  }
+  if (mem == NULL || !is_sampled(mem)) {
+    return maybe_sample(g_malloc_dispatch->realloc(mem, bytes), bytes);
+  }
+
+  // A sampled block is only forgotten once realloc has succeeded (or freed
+  // it, for a size of 0), and before its address can be sampled again.
+  void* new_mem;
+  {
+    ScopedPthreadMutexLocker locker(&g_sample_lock);
+    new_mem = g_malloc_dispatch->realloc(mem, bytes);
+    if (new_mem != NULL || bytes == 0) {
+      forget_sample_locked(mem);
+    }
+  }
+  return maybe_sample(new_mem, bytes);
+}
+
+extern "C" void* sample_memalign(size_t alignment, size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->memalign(alignment, bytes);
+  }
+  return maybe_sample(g_malloc_dispatch->memalign(alignment, bytes), bytes);
+}
+
+extern "C" int sample_posix_memalign(void** memptr, size_t alignment, size_t size) {
+  int result = g_malloc_dispatch->posix_memalign(memptr, alignment, size);
+  if (result == 0 && !DebugCallsDisabled()) {
+    maybe_sample(*memptr, size);
+  }
+  return result;
+}
+
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+extern "C" void* sample_pvalloc(size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->pvalloc(bytes);
+  }
+  return maybe_sample(g_malloc_dispatch->pvalloc(bytes), bytes);
+}
+
+extern "C" void* sample_valloc(size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->valloc(bytes);
+  }
+  return maybe_sample(g_malloc_dispatch->valloc(bytes), bytes);
+}
+#endif
+
+extern "C" size_t sample_malloc_usable_size(const void* mem) {
+  return g_malloc_dispatch->malloc_usable_size(mem);
+}
+
+extern "C" struct mallinfo sample_mallinfo() {
+  return g_malloc_dispatch->mallinfo();
+}
+
+// =============================================================================
+// Profile output
+// =============================================================================
+
+struct SampleSnapshot {
+  size_t size;
+  size_t depth;
+  uintptr_t frames[BACKTRACE_SIZE];
+};
+
+static bool read_sample(const SampleRecord* record, SampleSnapshot* snapshot) {
+  unsigned seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+  if ((seq & 1) != 0 || !record->used) {
+    return false;
+  }
+  snapshot->size = record->size;
+  snapshot->depth = MIN(record->depth, static_cast<size_t>(BACKTRACE_SIZE));
+  memcpy(snapshot->frames, record->frames, snapshot->depth * sizeof(uintptr_t));
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&record->seq, memory_order_relaxed) == seq;
+}
+
+static void write_frames(int fd, const SampleSnapshot& snapshot) {
+  for (size_t j = 0; j < snapshot.depth; ++j) {
+    __libc_format_fd(fd, " 0x%zx", static_cast<size_t>(snapshot.frames[j]));
+  }
+  __libc_format_fd(fd, "\n");
+}
+
+static void copy_maps(int fd) {
+  int maps_fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (maps_fd == -1) {
+    return;
+  }
+  char buf[4096];
+  ssize_t n;
+  while ((n = TEMP_FAILURE_RETRY(read(maps_fd, buf, sizeof(buf)))) > 0) {
+    if (TEMP_FAILURE_RETRY(write(fd, buf, n)) != n) {
+      break;
+    }
+  }
+  close(maps_fd);
+}
+
+// Writes pprof's "heap_v2" text format: the live samples are the in-use
+// columns, and the samples in the ring (live or not) the allocation columns.
+extern "C" int sample_write_profile(int fd) {
+  ScopedDisableDebugCalls disable;
+
+  SampleSnapshot snapshot;
+  size_t live_count = 0, live_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+  for (size_t i = 0; i < kMaxLiveSamples; ++i) {
+    if (read_sample(&g_live_samples[i], &snapshot)) {
+      live_count++;
+      live_bytes += snapshot.size;
+    }
+  }
+  for (size_t i = 0; i < kSampleRingSize; ++i) {
+    if (read_sample(&g_samples[i], &snapshot)) {
+      alloc_count++;
+      alloc_bytes += snapshot.size;
+    }
+  }
+
+  __libc_format_fd(fd, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+                   live_count, live_bytes, alloc_count, alloc_bytes, g_sample_interval);
+  for (size_t i = 0; i < kMaxLiveSamples; ++i) {
+    if (read_sample(&g_live_samples[i], &snapshot)) {
+      __libc_format_fd(fd, "1: %zu [0: 0] @", snapshot.size);
+      write_frames(fd, snapshot);
+    }
+  }
+  for (size_t i = 0; i < kSampleRingSize; ++i) {
+    if (read_sample(&g_samples[i], &snapshot)) {
+      __libc_format_fd(fd, "0: 0 [1: %zu] @", snapshot.size);
+      write_frames(fd, snapshot);
+    }
+  }
+
+  __libc_format_fd(fd, "\nMAPPED_LIBRARIES:\n");
+  copy_maps(fd);
+  return 0;
+}
+
+__LIBC_HIDDEN__ void sample_initialize() {
+  char value[PROP_VALUE_MAX];
+  if (__system_property_get("libc.debug.malloc.sample_interval", value) && atoi(value) > 0) {
+    g_sample_interval = atoi(value);
+  }
+  for (size_t i = 0; i < kMaxLiveSamples; ++i) {
+    g_free_live_samples[i] = kMaxLiveSamples - 1 - i;
+  }
+  g_free_live_sample_count = kMaxLiveSamples;
+  pthread_key_create(&g_sample_state_key, free_thread_state);
+  info_log("%s: sampling an allocation every %zu bytes\n", getprogname(), g_sample_interval);
+}
@@ -56,12 +56,7 @@ private:
   DISALLOW_COPY_AND_ASSIGN(Elem);
 };
 
-int malloc_info(int options, FILE* fp) {
-  if (options != 0) {
-    errno = EINVAL;
-    return -1;
-  }
-
+static void jemalloc_info(FILE* fp) {
   Elem root(fp, "malloc", "version=\"jemalloc-1\"");
 
   // Dump all of the large allocations in the arenas.
@@ -89,6 +84,53 @@ int malloc_info(int options, FILE* fp) {
       }
     }
   }
+}
+
+// Other allocators only have mallinfo()'s totals.
+static void total_info(FILE* fp) {
+  struct mallinfo mi = mallinfo();
+  Elem total_elem(fp, "total");
+  Elem(fp, "allocated").contents("%zu", mi.uordblks);
+  Elem(fp, "free").contents("%zu", mi.fordblks);
+  Elem(fp, "mapped").contents("%zu", mi.hblkhd);
+}
+
+static void dlmalloc_info(FILE* fp) {
+  Elem root(fp, "malloc", "version=\"dlmalloc-1\"");
+
+  total_info(fp);
+
+  struct mallinfo tc = __mallinfo_thread_cache_info();
+  if (tc.uordblks != 0 || tc.fordblks != 0) {
+    Elem tc_elem(fp, "thread-cache");
+    Elem(fp, "threads").contents("%zu", tc.ordblks);
+    Elem(fp, "cached-blocks").contents("%zu", tc.smblks);
+    Elem(fp, "cached-bytes").contents("%zu", tc.fsmblks);
+    Elem(fp, "hits").contents("%zu", tc.uordblks);
+    Elem(fp, "misses").contents("%zu", tc.fordblks);
+    Elem(fp, "released").contents("%zu", tc.keepcost);
+  }
+}
+
+int malloc_info(int options, FILE* fp) {
+  if (options != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  switch (__malloc_info_backend()) {
+    case kMallocInfoJemalloc:
+      jemalloc_info(fp);
+      break;
+    case kMallocInfoDlmalloc:
+      dlmalloc_info(fp);
+      break;
+    default: {
+      Elem root(fp, "malloc", "version=\"malloc-1\"");
+      total_info(fp);
+      break;
+    }
+  }
 
   return 0;
 }
@@ -27,6 +27,24 @@ __LIBC_HIDDEN__ size_t __mallinfo_nbins();
 __LIBC_HIDDEN__ struct mallinfo __mallinfo_arena_info(size_t);
 __LIBC_HIDDEN__ struct mallinfo __mallinfo_bin_info(size_t, size_t);
 
+// Totals of the per-thread caches, if any: ordblks is the number of threads
+// using a cache, smblks and fsmblks the number and size of the cached blocks,
+// uordblks and fordblks the cache hits and misses, and keepcost the number of
+// blocks given back to the heap.
+__LIBC_HIDDEN__ struct mallinfo __mallinfo_thread_cache_info();
+
+// The allocator malloc() is backed by (see malloc_debug_common.cpp). The
+// arena and bin functions above describe jemalloc's heap, and the thread
+// cache is dlmalloc's, so malloc_info() reports only those of the
+// allocator in use.
+enum MallocInfoBackend {
+  kMallocInfoJemalloc,
+  kMallocInfoDlmalloc,
+  kMallocInfoOther,
+};
+
+__LIBC_HIDDEN__ enum MallocInfoBackend __malloc_info_backend();
+
 __END_DECLS
 
 #endif // LIBC_BIONIC_MALLOC_INFO_H_
@@ -388,7 +388,12 @@ extern "C" int dlmalloc_trim(size_t) {
 }
 #else
 extern "C" int dlmalloc_trim_real(size_t);
+extern "C" void dlmalloc_tc_trim() __attribute__((weak));
 extern "C" int dlmalloc_trim(size_t pad) {
+  // The blocks in the thread caches are allocated as far as dlmalloc knows.
+  if (dlmalloc_tc_trim) {
+    dlmalloc_tc_trim();
+  }
   return dlmalloc_trim_real(pad);
 }
 #endif
@@ -58,6 +58,7 @@ void __init_tls(pthread_internal_t* thread) {
     // So assume the worst and zero the TLS area.
     memset(thread->tls, 0, sizeof(thread->tls));
     memset(thread->key_data, 0, sizeof(thread->key_data));
+    thread->malloc_thread_cache = NULL;
   }
 
   // Slot 0 must point to itself. The x86 Linux kernel reads the TLS from %fs:0.
@@ -38,6 +38,8 @@ extern "C" __noreturn void _exit_with_stack_teardown(void*, size_t);
 extern "C" __noreturn void __exit(int);
 extern "C" int __set_tid_address(int*);
 extern "C" void __cxa_thread_finalize();
+// Only there when libc is built with dlmalloc (see dlmalloc_thread_cache.h).
+extern "C" void dlmalloc_tc_thread_exit() __attribute__((weak));
 
 /* CAVEAT: our implementation of pthread_cleanup_push/pop doesn't support C++ exceptions
  *         and thread cancelation
@@ -79,6 +81,12 @@ void pthread_exit(void* return_value) {
   // space (see pthread_key_delete).
   pthread_key_clean_all();
 
+  // The TLS destructors were the last code of this thread that could free
+  // memory, so give the blocks cached by malloc back to the heap.
+  if (dlmalloc_tc_thread_exit) {
+    dlmalloc_tc_thread_exit();
+  }
+
   if (thread->alternate_signal_stack != NULL) {
     // Tell the kernel to stop using the alternate signal stack.
     stack_t ss;
@@ -98,6 +98,9 @@ struct pthread_internal_t {
 
   pthread_key_data_t key_data[BIONIC_PTHREAD_KEY_COUNT];
 
+  // The small block cache of the dlmalloc build (see dlmalloc_thread_cache.cpp).
+  void* malloc_thread_cache;
+
   /*
    * The dynamic linker implements dlerror(3), which makes it hard for us to implement this
    * per-thread buffer by simply using malloc(3) and free(3).
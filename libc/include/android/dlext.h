@@ -80,6 +80,36 @@ enum {
    */
   ANDROID_DLEXT_FORCE_FIXED_VADDR = 0x80,
 
+  /* When set, share the GNU RELRO section of the library through a store
+   * managed by the dynamic linker instead of relro_fd: the first process to
+   * load the file at a given address publishes its relocated RELRO pages and
+   * later processes loading it at the same address map the identical pages
+   * from there. Requires ANDROID_DLEXT_RESERVED_ADDRESS; cannot be combined
+   * with ANDROID_DLEXT_WRITE_RELRO or ANDROID_DLEXT_USE_RELRO.
+   */
+  ANDROID_DLEXT_USE_SHARED_RELRO = 0x100,
+
+  /* When set, ask the kernel to start reading the segments of the library
+   * into the page cache as soon as they are mapped, so that the page faults
+   * taken during relocation and startup don't each wait for a small read.
+   * This does not populate the mappings: writable pages only become private
+   * to the process when they are written to, as usual.
+   * This only applies to the library being opened, not to its dependencies.
+   */
+  ANDROID_DLEXT_READAHEAD_SEGMENTS = 0x200,
+
+  /* When set, align the library to a 2MB boundary (unless it is loaded at a
+   * reserved or fixed address) and move the 2MB aligned parts of its text
+   * onto transparent huge pages to reduce iTLB misses. The text is copied to
+   * anonymous memory for this, so it is no longer shared with other processes
+   * using the library; only use this for large libraries with hot code.
+   * The moved text no longer appears in /proc/self/maps as a mapping of the
+   * library file, so tools that use the maps to symbolize addresses (such as
+   * debuggerd and simpleperf) can't attribute those addresses to the library.
+   * This only applies to the library being opened, not to its dependencies.
+   */
+  ANDROID_DLEXT_HUGE_PAGE_TEXT = 0x400,
+
   /* Mask of valid bits */
   ANDROID_DLEXT_VALID_FLAG_BITS       = ANDROID_DLEXT_RESERVED_ADDRESS |
                                         ANDROID_DLEXT_RESERVED_ADDRESS_HINT |
@@ -88,7 +118,10 @@ enum {
                                         ANDROID_DLEXT_USE_LIBRARY_FD |
                                         ANDROID_DLEXT_USE_LIBRARY_FD_OFFSET |
                                         ANDROID_DLEXT_FORCE_LOAD |
-                                        ANDROID_DLEXT_FORCE_FIXED_VADDR,
+                                        ANDROID_DLEXT_FORCE_FIXED_VADDR |
+                                        ANDROID_DLEXT_USE_SHARED_RELRO |
+                                        ANDROID_DLEXT_READAHEAD_SEGMENTS |
+                                        ANDROID_DLEXT_HUGE_PAGE_TEXT,
 };
 
 typedef struct {
@@ -102,6 +135,15 @@ typedef struct {
 
 extern void* android_dlopen_ext(const char* filename, int flag, const android_dlextinfo* extinfo);
 
+/* Looks up count symbols in handle (with the same semantics as dlsym) while
+ * taking the linker lock and walking the dependency tree of handle only once.
+ * addrs[i] is set to the address of symbols[i], or to NULL if it could not be
+ * resolved, in which case dlerror() describes the last such symbol.
+ * Returns the number of symbols resolved.
+ */
+extern size_t android_dlsym_many(void* handle, const char* const symbols[], void* addrs[],
+                                 size_t count);
+
 __END_DECLS
 
 #endif /* __ANDROID_DLEXT_H__ */
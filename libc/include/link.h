@@ -44,6 +44,9 @@ struct dl_phdr_info {
   const char* dlpi_name;
   const ElfW(Phdr)* dlpi_phdr;
   ElfW(Half) dlpi_phnum;
+  /* Total number of objects loaded/unloaded so far. */
+  unsigned long long dlpi_adds;
+  unsigned long long dlpi_subs;
 };
 
 int dl_iterate_phdr(int (*)(struct dl_phdr_info*, size_t, void*), void*);
@@ -41,11 +41,11 @@ extern size_t malloc_usable_size(const void* p);
 struct mallinfo {
   size_t arena;    /* Total number of non-mmapped bytes currently allocated from OS. */
   size_t ordblks;  /* Number of free chunks. */
-  size_t smblks;   /* (Unused.) */
+  size_t smblks;   /* Number of blocks in the per-thread caches (dlmalloc only.) */
   size_t hblks;    /* (Unused.) */
   size_t hblkhd;   /* Total number of bytes in mmapped regions. */
   size_t usmblks;  /* Maximum total allocated space; greater than total if trimming has occurred. */
-  size_t fsmblks;  /* (Unused.) */
+  size_t fsmblks;  /* Total bytes in the per-thread caches (dlmalloc only.) */
   size_t uordblks; /* Total allocated space (normal or mmapped.) */
   size_t fordblks; /* Total free space. */
   size_t keepcost; /* Upper bound on number of bytes releasable by malloc_trim. */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BIONIC_FRAME_WALK_H_
+#define _BIONIC_FRAME_WALK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On these architectures, a function built with frame pointers starts its
+// frame with a record of the caller's frame pointer followed by the return
+// address, and the frame pointer register points at that record. Walking
+// the records is much cheaper than unwinding with the unwind tables, but
+// only sees the frames of code built with -fno-omit-frame-pointer.
+#if defined(__aarch64__) || defined(__i386__) || defined(__x86_64__)
+#define HAVE_BIONIC_FRAME_WALK 1
+
+struct frame_record_t {
+  uintptr_t next;
+  uintptr_t return_address;
+};
+
+// Stores the return addresses of at most max_depth frames into frames,
+// starting with the record at fp, and returns how many were stored. Every
+// record read has to be above the previous one and below stack_top, so a
+// function without a frame pointer ends the walk rather than sending it
+// somewhere that might not be mapped. The caller must make sure the whole
+// range from fp up to stack_top is a single stack.
+static inline size_t walk_frame_records(uintptr_t fp, uintptr_t stack_top,
+                                        uintptr_t* frames, size_t max_depth) {
+  size_t depth = 0;
+  while (depth < max_depth && fp != 0 && (fp % sizeof(uintptr_t)) == 0 &&
+         fp < stack_top && stack_top - fp >= sizeof(frame_record_t)) {
+    const frame_record_t* record = reinterpret_cast<const frame_record_t*>(fp);
+    if (record->return_address == 0) {
+      break;
+    }
+    frames[depth++] = record->return_address;
+    if (record->next <= fp) {
+      break;
+    }
+    fp = record->next;
+  }
+  return depth;
+}
+#endif
+
+#endif // _BIONIC_FRAME_WALK_H_
@@ -40,5 +40,7 @@ void android_update_LD_LIBRARY_PATH(const char* ld_library_path __unused) { }
 
 void* android_dlopen_ext(const char* filename __unused, int flag __unused, const android_dlextinfo* extinfo __unused) { return 0; }
 
+size_t android_dlsym_many(void* handle __unused, const char* const symbols[] __unused, void* addrs[] __unused, size_t count __unused) { return 0; }
+
 void android_set_application_target_sdk_version(uint32_t target __unused) { }
 uint32_t android_get_application_target_sdk_version() { return 0; }
@@ -11,15 +11,21 @@ LOCAL_SRC_FILES := \
     linker_allocator.cpp \
     linker_sdk_versions.cpp \
     linker_block_allocator.cpp \
+    linker_dir_cache.cpp \
     linker_libc_support.c \
+    linker_load_profile.cpp \
     linker_memory.cpp \
     linker_phdr.cpp \
+    linker_phdr_snapshot.cpp \
+    linker_soinfo_registry.cpp \
+    linker_symbol_cache.cpp \
+    linker_zip_cache.cpp \
     rt.cpp \
 
-LOCAL_SRC_FILES_arm     := arch/arm/begin.S
-LOCAL_SRC_FILES_arm64   := arch/arm64/begin.S
-LOCAL_SRC_FILES_x86     := arch/x86/begin.c
-LOCAL_SRC_FILES_x86_64  := arch/x86_64/begin.S
+LOCAL_SRC_FILES_arm     := arch/arm/begin.S arch/arm/plt_resolve.S
+LOCAL_SRC_FILES_arm64   := arch/arm64/begin.S arch/arm64/plt_resolve.S
+LOCAL_SRC_FILES_x86     := arch/x86/begin.c arch/x86/plt_resolve.S
+LOCAL_SRC_FILES_x86_64  := arch/x86_64/begin.S arch/x86_64/plt_resolve.S
 LOCAL_SRC_FILES_mips    := arch/mips/begin.S linker_mips.cpp
 LOCAL_SRC_FILES_mips64  := arch/mips64/begin.S linker_mips.cpp
 
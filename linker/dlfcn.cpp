@@ -24,8 +24,11 @@
 #include <android/dlext.h>
 #include <android/api-level.h>
 
+#include <vector>
+
 #include <bionic/pthread_internal.h>
 #include "private/bionic_tls.h"
+#include "private/ErrnoRestorer.h"
 #include "private/ScopedPthreadMutexLocker.h"
 #include "private/ThreadLocalBuffer.h"
 
@@ -85,6 +88,22 @@ void* dlopen(const char* filename, int flags) {
   return dlopen_ext(filename, flags, nullptr);
 }
 
+static void* dlsym_result(const char* symbol, soinfo* found, const ElfW(Sym)* sym) {
+  if (sym != nullptr) {
+    unsigned bind = ELF_ST_BIND(sym->st_info);
+
+    if ((bind == STB_GLOBAL || bind == STB_WEAK) && sym->st_shndx != 0) {
+      return reinterpret_cast<void*>(found->resolve_symbol_address(sym));
+    }
+
+    __bionic_format_dlerror("symbol found but not global", symbol);
+    return nullptr;
+  } else {
+    __bionic_format_dlerror("undefined symbol", symbol);
+    return nullptr;
+  }
+}
+
 void* dlsym(void* handle, const char* symbol) {
   ScopedPthreadMutexLocker locker(&g_dl_mutex);
 
@@ -111,19 +130,53 @@ void* dlsym(void* handle, const char* symbol) {
     sym = dlsym_handle_lookup(reinterpret_cast<soinfo*>(handle), &found, symbol);
   }
 
-  if (sym != nullptr) {
-    unsigned bind = ELF_ST_BIND(sym->st_info);
+  return dlsym_result(symbol, found, sym);
+}
 
-    if ((bind == STB_GLOBAL || bind == STB_WEAK) && sym->st_shndx != 0) {
-      return reinterpret_cast<void*>(found->resolve_symbol_address(sym));
+size_t android_dlsym_many(void* handle, const char* const symbols[], void* addrs[], size_t count) {
+  ScopedPthreadMutexLocker locker(&g_dl_mutex);
+
+  for (size_t i = 0; i < count; ++i) {
+    addrs[i] = nullptr;
+  }
+
+#if !defined(__LP64__)
+  if (handle == nullptr) {
+    __bionic_format_dlerror("dlsym library handle is null", nullptr);
+    return 0;
+  }
+#endif
+
+  for (size_t i = 0; i < count; ++i) {
+    if (symbols[i] == nullptr) {
+      __bionic_format_dlerror("dlsym symbol name is null", nullptr);
+      return 0;
     }
+  }
 
-    __bionic_format_dlerror("symbol found but not global", symbol);
-    return nullptr;
+  std::vector<soinfo*> found(count);
+  std::vector<const ElfW(Sym)*> syms(count);
+
+  if (handle == RTLD_DEFAULT || handle == RTLD_NEXT) {
+    void* caller_addr = __builtin_return_address(0);
+    soinfo* caller = find_containing_library(caller_addr);
+    for (size_t i = 0; i < count; ++i) {
+      syms[i] = dlsym_linear_lookup(symbols[i], &found[i], caller, handle);
+    }
   } else {
-    __bionic_format_dlerror("undefined symbol", symbol);
-    return nullptr;
+    dlsym_handle_lookup_many(reinterpret_cast<soinfo*>(handle), count, symbols,
+                             &found[0], &syms[0]);
+  }
+
+  size_t resolved = 0;
+  for (size_t i = 0; i < count; ++i) {
+    addrs[i] = dlsym_result(symbols[i], found[i], syms[i]);
+    if (addrs[i] != nullptr) {
+      ++resolved;
+    }
   }
+
+  return resolved;
 }
 
 int dladdr(const void* addr, Dl_info* info) {
@@ -159,7 +212,7 @@ int dlclose(void* handle) {
 }
 
 int dl_iterate_phdr(int (*cb)(dl_phdr_info* info, size_t size, void* data), void* data) {
-  ScopedPthreadMutexLocker locker(&g_dl_mutex);
+  // No lock: unwinders call this for every exception thrown.
   return do_dl_iterate_phdr(cb, data);
 }
 
@@ -173,6 +226,22 @@ uint32_t android_get_application_target_sdk_version() {
   return get_application_target_sdk_version();
 }
 
+#if !defined(__mips__)
+// Called by __linker_plt_resolve_trampoline on the first call through
+// a PLT slot of a library that is bound lazily. Returns the address the
+// trampoline should jump to.
+extern "C" ElfW(Addr) __linker_plt_resolve(soinfo* si, size_t reloc_index) {
+  // The call being bound must not observe errno changes made by the linker.
+  ErrnoRestorer errno_restorer;
+  ScopedPthreadMutexLocker locker(&g_dl_mutex);
+  ElfW(Addr) target;
+  if (!do_bind_plt_slot(si, reloc_index, &target)) {
+    __libc_fatal("%s", linker_get_error_buffer());
+  }
+  return target;
+}
+#endif
+
 // name_offset: starting index of the name in libdl_info.strtab
 #define ELF32_SYM_INITIALIZER(name_offset, value, shndx) \
     { name_offset, \
@@ -199,11 +268,11 @@ static const char ANDROID_LIBDL_STRTAB[] =
   // 00000000001 1111111112222222222 3333333333444444444455555555556666666666777 777777788888888889999999999
   // 01234567890 1234567890123456789 0123456789012345678901234567890123456789012 345678901234567890123456789
     "erate_phdr\0android_dlopen_ext\0android_set_application_target_sdk_version\0android_get_application_tar"
-  // 0000000000111111
-  // 0123456789012345
-    "get_sdk_version\0"
+  // 0000000000111111 1111222222222233333
+  // 0123456789012345 6789012345678901234
+    "get_sdk_version\0android_dlsym_many\0"
 #if defined(__arm__)
-  // 216
+  // 235
     "dl_unwind_find_exidx\0"
 #endif
     ;
@@ -225,8 +294,9 @@ static ElfW(Sym) g_libdl_symtab[] = {
   ELFW(SYM_INITIALIZER)(111, &android_dlopen_ext, 1),
   ELFW(SYM_INITIALIZER)(130, &android_set_application_target_sdk_version, 1),
   ELFW(SYM_INITIALIZER)(173, &android_get_application_target_sdk_version, 1),
+  ELFW(SYM_INITIALIZER)(216, &android_dlsym_many, 1),
 #if defined(__arm__)
-  ELFW(SYM_INITIALIZER)(216, &dl_unwind_find_exidx, 1),
+  ELFW(SYM_INITIALIZER)(235, &dl_unwind_find_exidx, 1),
 #endif
 };
 
@@ -243,9 +313,9 @@ static ElfW(Sym) g_libdl_symtab[] = {
 // Note that adding any new symbols here requires stubbing them out in libdl.
 static unsigned g_libdl_buckets[1] = { 1 };
 #if defined(__arm__)
-static unsigned g_libdl_chains[] = { 0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0 };
+static unsigned g_libdl_chains[] = { 0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0 };
 #else
-static unsigned g_libdl_chains[] = { 0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0 };
+static unsigned g_libdl_chains[] = { 0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0 };
 #endif
 
 static uint8_t __libdl_info_buf[sizeof(soinfo)] __attribute__((aligned(8)));
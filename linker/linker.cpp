@@ -40,28 +40,42 @@
 #include <sys/prctl.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <new>
 #include <string>
+#include <utility>
 #include <vector>
 
 // Private C library headers.
 #include "private/bionic_tls.h"
 #include "private/KernelArgumentBlock.h"
 #include "private/ScopedPthreadMutexLocker.h"
+#include "private/ScopedReaddir.h"
 #include "private/ScopeGuard.h"
 #include "private/UniquePtr.h"
 
 #include "linker.h"
 #include "linker_block_allocator.h"
 #include "linker_debug.h"
+#include "linker_dir_cache.h"
+#include "linker_gnu_hash.h"
+#include "linker_load_profile.h"
 #include "linker_sleb128.h"
 #include "linker_phdr.h"
+#include "linker_phdr_snapshot.h"
 #include "linker_relocs.h"
 #include "linker_reloc_iterators.h"
-#include "ziparchive/zip_archive.h"
+#include "linker_soinfo_registry.h"
+#include "linker_symbol_cache.h"
+#include "linker_zip_cache.h"
 
 extern void __libc_init_AT_SECURE(KernelArgumentBlock&);
 
+#if !defined(__mips__)
+// Installed in GOT[2] of lazily bound libraries (see arch/*/plt_resolve.S).
+extern "C" void __linker_plt_resolve_trampoline();
+#endif
+
 // Override macros to use C++ style casts.
 #undef ELF_ST_TYPE
 #define ELF_ST_TYPE(x) (static_cast<uint32_t>(x) & 0xf)
@@ -75,6 +89,11 @@ static soinfo* solist;
 static soinfo* sonext;
 static soinfo* somain; // main process, always the one after libdl_info
 
+// Libraries added to and removed from solist so far, reported to
+// dl_iterate_phdr() callbacks as dlpi_adds and dlpi_subs.
+static uint64_t g_soinfo_adds = 1; // libdl_info
+static uint64_t g_soinfo_subs = 0;
+
 static const char* const kDefaultLdPaths[] = {
 #if defined(__LP64__)
   "/vendor/lib64",
@@ -111,6 +130,8 @@ static std::vector<std::string> g_ld_preload_names;
 
 static std::vector<soinfo*> g_ld_preloads;
 
+static bool g_ld_bind_now = false;
+
 __LIBC_HIDDEN__ int g_ld_debug_verbosity;
 
 __LIBC_HIDDEN__ abort_msg_t* g_abort_message = nullptr; // For debuggerd.
@@ -254,6 +275,7 @@ static soinfo* soinfo_alloc(const char* name, struct stat* file_stat,
 
   sonext->next = si;
   sonext = si;
+  ++g_soinfo_adds;
 
   TRACE("name %s: allocated soinfo @ %p", name, si);
   return si;
@@ -287,6 +309,7 @@ static void soinfo_free(soinfo* si) {
 
   // clear links to/from si
   si->remove_all_links();
+  SoinfoRegistry::remove(si);
 
   // prev will never be null, because the first entry in solist is
   // always the static libdl_info.
@@ -294,6 +317,7 @@ static void soinfo_free(soinfo* si) {
   if (si == sonext) {
     sonext = prev;
   }
+  ++g_soinfo_subs;
 
   si->~soinfo();
   g_soinfo_allocator.free(si);
@@ -361,37 +385,28 @@ static bool realpath_fd(int fd, std::string* realpath) {
 // Intended to be called by libc's __gnu_Unwind_Find_exidx().
 //
 // This function is exposed via dlfcn.cpp and libdl.so.
+//
+// Like dl_iterate_phdr() it does not take the dlfcn lock.
 _Unwind_Ptr dl_unwind_find_exidx(_Unwind_Ptr pc, int* pcount) {
-  uintptr_t addr = reinterpret_cast<uintptr_t>(pc);
-
-  for (soinfo* si = solist; si != 0; si = si->next) {
-    if ((addr >= si->base) && (addr < (si->base + si->size))) {
-        *pcount = si->ARM_exidx_count;
-        return reinterpret_cast<_Unwind_Ptr>(si->ARM_exidx);
-    }
-  }
-  *pcount = 0;
-  return nullptr;
+  return PhdrSnapshot::find_exidx(pc, pcount);
 }
 
 #endif
 
+// Makes the current contents of solist visible to dl_iterate_phdr().
+// This has to be done before running any code of newly loaded libraries,
+// which may need to be unwound through.
+static void publish_solist() {
+  if (!PhdrSnapshot::is_current(g_soinfo_adds, g_soinfo_subs)) {
+    PhdrSnapshot::publish(solist, g_soinfo_adds, g_soinfo_subs);
+  }
+}
+
 // Here, we only have to provide a callback to iterate across all the
-// loaded libraries. gcc_eh does the rest.
+// loaded libraries. gcc_eh does the rest. This is called without the
+// dlfcn lock: it walks the last published snapshot of solist.
 int do_dl_iterate_phdr(int (*cb)(dl_phdr_info* info, size_t size, void* data), void* data) {
-  int rv = 0;
-  for (soinfo* si = solist; si != nullptr; si = si->next) {
-    dl_phdr_info dl_info;
-    dl_info.dlpi_addr = si->link_map_head.l_addr;
-    dl_info.dlpi_name = si->link_map_head.l_name;
-    dl_info.dlpi_phdr = si->phdr;
-    dl_info.dlpi_phnum = si->phnum;
-    rv = cb(&dl_info, sizeof(dl_phdr_info), data);
-    if (rv != 0) {
-      break;
-    }
-  }
-  return rv;
+  return PhdrSnapshot::iterate(cb, data);
 }
 
 const ElfW(Versym)* soinfo::get_versym(size_t n) const {
@@ -516,6 +531,11 @@ bool soinfo::find_symbol_by_name(SymbolName& symbol_name,
     *symbol = symbol_index == 0 ? nullptr : symtab_ + symbol_index;
   }
 
+  LoadProfileEntry* profile = get_load_profile();
+  if (profile != nullptr) {
+    ++(symbol_index == 0 ? profile->not_found_in : profile->found_in);
+  }
+
   return success;
 }
 
@@ -531,6 +551,13 @@ static bool is_symbol_global_and_defined(const soinfo* si, const ElfW(Sym)* s) {
   return false;
 }
 
+// Most candidates on a hash chain differ from the name being looked up
+// in the very first bytes; check those inline before calling strcmp.
+static inline bool symbol_name_equals(const char* sym_name, const char* name) {
+  return sym_name[0] == name[0] &&
+      (name[0] == '\0' || (sym_name[1] == name[1] && strcmp(sym_name + 1, name + 1) == 0));
+}
+
 static const ElfW(Versym) kVersymHiddenBit = 0x8000;
 
 static inline bool is_versym_hidden(const ElfW(Versym)* versym) {
@@ -598,7 +625,7 @@ bool soinfo::gnu_lookup(SymbolName& symbol_name,
     }
     if (((gnu_chain_[n] ^ hash) >> 1) == 0 &&
         check_symbol_version(verneed, verdef) &&
-        strcmp(get_string(s->st_name), symbol_name.get_name()) == 0 &&
+        symbol_name_equals(get_string(s->st_name), symbol_name.get_name()) &&
         is_symbol_global_and_defined(this, s)) {
       TRACE_TYPE(LOOKUP, "FOUND %s in %s (%p) %zd",
           symbol_name.get_name(), get_realpath(), reinterpret_cast<void*>(s->st_value),
@@ -638,7 +665,7 @@ bool soinfo::elf_lookup(SymbolName& symbol_name,
     }
 
     if (check_symbol_version(verneed, verdef) &&
-        strcmp(get_string(s->st_name), symbol_name.get_name()) == 0 &&
+        symbol_name_equals(get_string(s->st_name), symbol_name.get_name()) &&
         is_symbol_global_and_defined(this, s)) {
       TRACE_TYPE(LOOKUP, "FOUND %s in %s (%p) %zd",
                  symbol_name.get_name(), get_realpath(),
@@ -657,6 +684,21 @@ bool soinfo::elf_lookup(SymbolName& symbol_name,
   return true;
 }
 
+bool soinfo::is_symbol_version_acceptable(uint32_t symbol_index,
+                                          const version_info* vi) const {
+  ElfW(Versym) verneed = 0;
+  if (!find_verdef_version_index(vi, &verneed)) {
+    return false;
+  }
+
+  const ElfW(Versym)* verdef = get_versym(symbol_index);
+  if (verneed == kVersymNotNeeded && is_versym_hidden(verdef)) {
+    return false;
+  }
+
+  return check_symbol_version(verneed, verdef);
+}
+
 soinfo::soinfo(const char* realpath, const struct stat* file_stat,
                off64_t file_offset, int rtld_flags) {
   memset(this, 0, sizeof(*this));
@@ -671,10 +713,27 @@ soinfo::soinfo(const char* realpath, const struct stat* file_stat,
   if (file_stat != nullptr) {
     this->st_dev_ = file_stat->st_dev;
     this->st_ino_ = file_stat->st_ino;
+    this->st_mtime_ = file_stat->st_mtime;
     this->file_offset_ = file_offset;
   }
 
   this->rtld_flags_ = rtld_flags;
+  this->load_profile_ = LoadProfile::create_entry(get_realpath());
+}
+
+// The scope a lazily bound library's PLT slots are resolved in. The version
+// tracker and the local group don't change once the library is linked; the
+// global group is rebuilt when solist has changed.
+struct LazyBindScope {
+  VersionTracker version_tracker;
+  soinfo::soinfo_list_t global_group;
+  soinfo::soinfo_list_t local_group;
+  uint64_t adds;
+  uint64_t subs;
+};
+
+soinfo::~soinfo() {
+  delete lazy_bind_scope_;
 }
 
 
@@ -699,25 +758,147 @@ uint32_t SymbolName::elf_hash() {
 
 uint32_t SymbolName::gnu_hash() {
   if (!has_gnu_hash_) {
-    uint32_t h = 5381;
-    const uint8_t* name = reinterpret_cast<const uint8_t*>(name_);
-    while (*name != 0) {
-      h += (h << 5) + *name++; // h*33 + c = h + h * 32 + c = h + h << 5 + c
-    }
-
-    gnu_hash_ =  h;
+    gnu_hash_ = calculate_gnu_hash(name_);
     has_gnu_hash_ = true;
   }
 
   return gnu_hash_;
 }
 
+// Remembers the results of soinfo_do_lookup() for one pair of global and
+// local groups, so that a symbol referenced by many libraries of the group
+// is only searched for once instead of once per reference. The result of
+// a lookup only depends on the name, the version and the groups (unless
+// the library doing the lookup has DT_SYMBOLIC, these are not cached).
+//
+// find_libraries() installs one for the duration of linking a new group;
+// any dlopen() or dlclose() gets a new one built from scratch.
+class GroupLookupCache {
+ public:
+  GroupLookupCache(const soinfo::soinfo_list_t& global_group,
+                   const soinfo::soinfo_list_t& local_group)
+      : global_group_(&global_group), local_group_(&local_group),
+        entries_(kInitialSize), count_(0) {}
+
+  bool is_for(const soinfo::soinfo_list_t& global_group,
+              const soinfo::soinfo_list_t& local_group) const {
+    return &global_group == global_group_ && &local_group == local_group_;
+  }
+
+  bool find(SymbolName& symbol_name, const version_info* vi,
+            soinfo** si_found_in, const ElfW(Sym)** symbol) {
+    const entry* e = find_entry(symbol_name, vi);
+    if (e->name == nullptr) {
+      return false;
+    }
+
+    if (e->symbol != nullptr) {
+      *si_found_in = e->si;
+    }
+    *symbol = e->symbol;
+    return true;
+  }
+
+  void insert(SymbolName& symbol_name, const version_info* vi,
+              soinfo* si_found_in, const ElfW(Sym)* symbol) {
+    // Keep the load factor under 3/4.
+    if ((count_ + 1) * 4 > entries_.size() * 3) {
+      grow();
+    }
+
+    entry* e = find_entry(symbol_name, vi);
+    if (e->name == nullptr) {
+      e->hash = hash(symbol_name, vi);
+      e->name = symbol_name.get_name();
+      e->version = vi != nullptr ? vi->name : nullptr;
+      ++count_;
+    }
+    e->si = si_found_in;
+    e->symbol = symbol;
+  }
+
+ private:
+  static const size_t kInitialSize = 256;
+
+  struct entry {
+    uint32_t hash;
+    const char* name;  // nullptr for an empty entry.
+    const char* version;
+    soinfo* si;
+    const ElfW(Sym)* symbol;
+  };
+
+  static uint32_t hash(SymbolName& symbol_name, const version_info* vi) {
+    return symbol_name.gnu_hash() ^ (vi != nullptr ? vi->elf_hash * 31 : 0);
+  }
+
+  entry* find_entry(SymbolName& symbol_name, const version_info* vi) {
+    uint32_t h = hash(symbol_name, vi);
+    const char* version = vi != nullptr ? vi->name : nullptr;
+    size_t mask = entries_.size() - 1;
+
+    for (size_t i = h & mask; ; i = (i + 1) & mask) {
+      entry* e = &entries_[i];
+      if (e->name == nullptr) {
+        return e;
+      }
+
+      if (e->hash == h && strcmp(e->name, symbol_name.get_name()) == 0 &&
+          (e->version == version ||
+           (e->version != nullptr && version != nullptr && strcmp(e->version, version) == 0))) {
+        return e;
+      }
+    }
+  }
+
+  void grow() {
+    std::vector<entry> old_entries(entries_.size() * 2);
+    old_entries.swap(entries_);
+
+    size_t mask = entries_.size() - 1;
+    for (const entry& old_entry : old_entries) {
+      if (old_entry.name == nullptr) {
+        continue;
+      }
+
+      size_t i = old_entry.hash & mask;
+      while (entries_[i].name != nullptr) {
+        i = (i + 1) & mask;
+      }
+      entries_[i] = old_entry;
+    }
+  }
+
+  const soinfo::soinfo_list_t* global_group_;
+  const soinfo::soinfo_list_t* local_group_;
+  std::vector<entry> entries_;
+  size_t count_;
+
+  DISALLOW_COPY_AND_ASSIGN(GroupLookupCache);
+};
+
+static GroupLookupCache* g_group_lookup_cache = nullptr;
+
 bool soinfo_do_lookup(soinfo* si_from, const char* name, const version_info* vi,
                       soinfo** si_found_in, const soinfo::soinfo_list_t& global_group,
                       const soinfo::soinfo_list_t& local_group, const ElfW(Sym)** symbol) {
   SymbolName symbol_name(name);
   const ElfW(Sym)* s = nullptr;
 
+  LoadProfileEntry* profile = si_from->get_load_profile();
+  if (profile != nullptr) {
+    ++profile->lookups;
+  }
+
+  GroupLookupCache* lookup_cache = nullptr;
+  if (!si_from->has_DT_SYMBOLIC && g_group_lookup_cache != nullptr &&
+      g_group_lookup_cache->is_for(global_group, local_group)) {
+    lookup_cache = g_group_lookup_cache;
+    if (lookup_cache->find(symbol_name, vi, si_found_in, symbol)) {
+      return true;
+    }
+  }
+
   /* "This element's presence in a shared object library alters the dynamic linker's
    * symbol resolution algorithm for references within the library. Instead of starting
    * a symbol search with the executable file, the dynamic linker starts from the shared
@@ -801,6 +982,10 @@ bool soinfo_do_lookup(soinfo* si_from, const char* name, const version_info* vi,
                reinterpret_cast<void*>((*si_found_in)->load_bias));
   }
 
+  if (lookup_cache != nullptr) {
+    lookup_cache->insert(symbol_name, vi, s != nullptr ? *si_found_in : nullptr, s);
+  }
+
   *symbol = s;
   return true;
 }
@@ -868,6 +1053,7 @@ class LoadTask {
  public:
   struct deleter_t {
     void operator()(LoadTask* t) {
+      t->~LoadTask();
       TypeBasedAllocator<LoadTask>::free(t);
     }
   };
@@ -888,12 +1074,45 @@ class LoadTask {
   soinfo* get_needed_by() const {
     return needed_by_;
   }
+
+  // The file opened for this task, either by prefetch_load_tasks()
+  // or by load_library(). The task owns the descriptor.
+  int get_fd() const {
+    return fd_;
+  }
+
+  off64_t get_file_offset() const {
+    return file_offset_;
+  }
+
+  void set_fd(int fd, off64_t file_offset) {
+    fd_ = fd;
+    file_offset_ = file_offset;
+  }
+
+  bool is_prefetched() const {
+    return prefetched_;
+  }
+
+  void set_prefetched() {
+    prefetched_ = true;
+  }
+
+  ~LoadTask() {
+    if (fd_ != -1) {
+      close(fd_);
+    }
+  }
+
  private:
   LoadTask(const char* name, soinfo* needed_by)
-    : name_(name), needed_by_(needed_by) {}
+    : name_(name), needed_by_(needed_by), fd_(-1), file_offset_(0), prefetched_(false) {}
 
   const char* name_;
   soinfo* needed_by_;
+  int fd_;
+  off64_t file_offset_;
+  bool prefetched_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(LoadTask);
 };
@@ -990,6 +1209,42 @@ const ElfW(Sym)* dlsym_handle_lookup(soinfo* si, soinfo** found, const char* nam
   return dlsym_handle_lookup(si, nullptr, found, symbol_name);
 }
 
+// This is used by android_dlsym_many(). Does the same as dlsym_handle_lookup()
+// for every name, but only walks the dependency tree once.
+void dlsym_handle_lookup_many(soinfo* si, size_t count, const char* const names[],
+                              soinfo* found[], const ElfW(Sym)* syms[]) {
+  if (si == somain) {
+    for (size_t i = 0; i < count; ++i) {
+      syms[i] = dlsym_linear_lookup(names[i], &found[i], nullptr, RTLD_DEFAULT);
+    }
+    return;
+  }
+
+  std::vector<soinfo*> scope;
+  walk_dependencies_tree(&si, 1, [&](soinfo* current_soinfo) {
+    scope.push_back(current_soinfo);
+    return true;
+  });
+
+  for (size_t i = 0; i < count; ++i) {
+    SymbolName symbol_name(names[i]);
+    syms[i] = nullptr;
+    found[i] = nullptr;
+
+    for (soinfo* current_soinfo : scope) {
+      if (!current_soinfo->find_symbol_by_name(symbol_name, nullptr, &syms[i])) {
+        syms[i] = nullptr;
+        break;
+      }
+
+      if (syms[i] != nullptr) {
+        found[i] = current_soinfo;
+        break;
+      }
+    }
+  }
+}
+
 /* This is used by dlsym(3) to performs a global symbol lookup. If the
    start value is null (for RTLD_DEFAULT), the search starts at the
    beginning of the global solist. Otherwise the search starts at the
@@ -1048,13 +1303,7 @@ const ElfW(Sym)* dlsym_linear_lookup(const char* name,
 }
 
 soinfo* find_containing_library(const void* p) {
-  ElfW(Addr) address = reinterpret_cast<ElfW(Addr)>(p);
-  for (soinfo* si = solist; si != nullptr; si = si->next) {
-    if (address >= si->base && address - si->base < si->size) {
-      return si;
-    }
-  }
-  return nullptr;
+  return SoinfoRegistry::find_by_address(reinterpret_cast<ElfW(Addr)>(p));
 }
 
 ElfW(Sym)* soinfo::find_symbol_by_address(const void* addr) {
@@ -1104,7 +1353,7 @@ ElfW(Sym)* soinfo::elf_addr_lookup(const void* addr) {
 }
 
 static int open_library_in_zipfile(const char* const path,
-                                   off64_t* file_offset) {
+                                   off64_t* file_offset, off64_t* file_length) {
   TRACE("Trying zip file open from path '%s'", path);
 
   // Treat an '!/' separator inside a path as the separator between the name
@@ -1131,32 +1380,12 @@ static int open_library_in_zipfile(const char* const path,
     return -1;
   }
 
-  ZipArchiveHandle handle;
-  if (OpenArchiveFd(fd, "", &handle, false) != 0) {
-    // invalid zip-file (?)
-    close(fd);
-    return -1;
-  }
-
-  auto archive_guard = make_scope_guard([&]() {
-    CloseArchive(handle);
-  });
-
-  ZipEntry entry;
-
-  if (FindEntry(handle, ZipEntryName(file_path), &entry) != 0) {
-    // Entry was not found.
-    close(fd);
-    return -1;
-  }
-
-  // Check if it is properly stored
-  if (entry.method != kCompressStored || (entry.offset % PAGE_SIZE) != 0) {
+  // Invalid zip-file, entry not found or not properly stored.
+  if (!ZipArchiveCache::find_entry(fd, file_path, file_offset, file_length)) {
     close(fd);
     return -1;
   }
 
-  *file_offset = entry.offset;
   return fd;
 }
 
@@ -1170,8 +1399,13 @@ static bool format_path(char* buf, size_t buf_size, const char* path, const char
   return true;
 }
 
-static int open_library_on_default_path(const char* name, off64_t* file_offset) {
+static int open_library_on_default_path(const char* name,
+                                        off64_t* file_offset, off64_t* file_length) {
   for (size_t i = 0; g_default_ld_paths[i] != nullptr; ++i) {
+    if (!SearchDirCache::may_contain(g_default_ld_paths[i], name)) {
+      continue;
+    }
+
     char buf[512];
     if (!format_path(buf, sizeof(buf), g_default_ld_paths[i], name)) {
       continue;
@@ -1180,6 +1414,7 @@ static int open_library_on_default_path(const char* name, off64_t* file_offset)
     int fd = TEMP_FAILURE_RETRY(open(buf, O_RDONLY | O_CLOEXEC));
     if (fd != -1) {
       *file_offset = 0;
+      *file_length = 0;
       return fd;
     }
   }
@@ -1187,23 +1422,30 @@ static int open_library_on_default_path(const char* name, off64_t* file_offset)
   return -1;
 }
 
-static int open_library_on_ld_library_path(const char* name, off64_t* file_offset) {
+static int open_library_on_ld_library_path(const char* name,
+                                           off64_t* file_offset, off64_t* file_length) {
   for (const auto& path_str : g_ld_library_paths) {
     char buf[512];
     const char* const path = path_str.c_str();
+    // Paths inside zip files are looked up in the cached zip directory instead.
+    if (strstr(path, kZipFileSeparator) == nullptr && !SearchDirCache::may_contain(path, name)) {
+      continue;
+    }
+
     if (!format_path(buf, sizeof(buf), path, name)) {
       continue;
     }
 
     int fd = -1;
     if (strstr(buf, kZipFileSeparator) != nullptr) {
-      fd = open_library_in_zipfile(buf, file_offset);
+      fd = open_library_in_zipfile(buf, file_offset, file_length);
     }
 
     if (fd == -1) {
       fd = TEMP_FAILURE_RETRY(open(buf, O_RDONLY | O_CLOEXEC));
       if (fd != -1) {
         *file_offset = 0;
+        *file_length = 0;
       }
     }
 
@@ -1215,13 +1457,15 @@ static int open_library_on_ld_library_path(const char* name, off64_t* file_offse
   return -1;
 }
 
-static int open_library(const char* name, off64_t* file_offset) {
+// Sets *file_offset to where the library starts in the file, and
+// *file_length to its size, or to 0 if it takes up the rest of the file.
+static int open_library(const char* name, off64_t* file_offset, off64_t* file_length) {
   TRACE("[ opening %s ]", name);
 
   // If the name contains a slash, we should attempt to open it directly and not search the paths.
   if (strchr(name, '/') != nullptr) {
     if (strstr(name, kZipFileSeparator) != nullptr) {
-      int fd = open_library_in_zipfile(name, file_offset);
+      int fd = open_library_in_zipfile(name, file_offset, file_length);
       if (fd != -1) {
         return fd;
       }
@@ -1230,14 +1474,16 @@ static int open_library(const char* name, off64_t* file_offset) {
     int fd = TEMP_FAILURE_RETRY(open(name, O_RDONLY | O_CLOEXEC));
     if (fd != -1) {
       *file_offset = 0;
+      *file_length = 0;
     }
     return fd;
   }
 
   // Otherwise we try LD_LIBRARY_PATH first, and fall back to the built-in well known paths.
-  int fd = open_library_on_ld_library_path(name, file_offset);
+  // The cached directory listings let us skip the directories that do not have the library.
+  int fd = open_library_on_ld_library_path(name, file_offset, file_length);
   if (fd == -1) {
-    fd = open_library_on_default_path(name, file_offset);
+    fd = open_library_on_default_path(name, file_offset, file_length);
   }
   return fd;
 }
@@ -1293,16 +1539,11 @@ static soinfo* load_library(int fd, off64_t file_offset,
   // Check for symlink and other situations where
   // file can have different names, unless ANDROID_DLEXT_FORCE_LOAD is set
   if (extinfo == nullptr || (extinfo->flags & ANDROID_DLEXT_FORCE_LOAD) == 0) {
-    for (soinfo* si = solist; si != nullptr; si = si->next) {
-      if (si->get_st_dev() != 0 &&
-          si->get_st_ino() != 0 &&
-          si->get_st_dev() == file_stat.st_dev &&
-          si->get_st_ino() == file_stat.st_ino &&
-          si->get_file_offset() == file_offset) {
-        TRACE("library \"%s\" is already loaded under different name/path \"%s\" - "
-            "will return existing soinfo", name, si->get_realpath());
-        return si;
-      }
+    soinfo* si = SoinfoRegistry::find_by_file(file_stat.st_dev, file_stat.st_ino, file_offset);
+    if (si != nullptr) {
+      TRACE("library \"%s\" is already loaded under different name/path \"%s\" - "
+          "will return existing soinfo", name, si->get_realpath());
+      return si;
     }
   }
 
@@ -1318,10 +1559,12 @@ static soinfo* load_library(int fd, off64_t file_offset,
   }
 
   // Read the ELF header and load the segments.
+  uint64_t load_start_ns = LoadProfile::now_ns();
   ElfReader elf_reader(realpath.c_str(), fd, file_offset, file_stat.st_size);
   if (!elf_reader.Load(extinfo)) {
     return nullptr;
   }
+  uint64_t prelink_start_ns = LoadProfile::now_ns();
 
   soinfo* si = soinfo_alloc(realpath.c_str(), &file_stat, file_offset, rtld_flags);
   if (si == nullptr) {
@@ -1338,6 +1581,14 @@ static soinfo* load_library(int fd, off64_t file_offset,
     return nullptr;
   }
 
+  SoinfoRegistry::add(si);
+
+  LoadProfileEntry* profile = si->get_load_profile();
+  if (profile != nullptr) {
+    profile->load_ns += prelink_start_ns - load_start_ns;
+    profile->prelink_ns += LoadProfile::now_ns() - prelink_start_ns;
+  }
+
   for_each_dt_needed(si, [&] (const char* name) {
     load_tasks.push_back(LoadTask::create(name, si));
   });
@@ -1345,9 +1596,9 @@ static soinfo* load_library(int fd, off64_t file_offset,
   return si;
 }
 
-static soinfo* load_library(LoadTaskList& load_tasks,
-                            const char* name, int rtld_flags,
-                            const android_dlextinfo* extinfo) {
+static soinfo* load_library(LoadTaskList& load_tasks, LoadTask* task,
+                            int rtld_flags, const android_dlextinfo* extinfo) {
+  const char* name = task->get_name();
   if (extinfo != nullptr && (extinfo->flags & ANDROID_DLEXT_USE_LIBRARY_FD) != 0) {
     off64_t file_offset = 0;
     if ((extinfo->flags & ANDROID_DLEXT_USE_LIBRARY_FD_OFFSET) != 0) {
@@ -1356,16 +1607,28 @@ static soinfo* load_library(LoadTaskList& load_tasks,
     return load_library(extinfo->library_fd, file_offset, load_tasks, name, rtld_flags, extinfo);
   }
 
-  // Open the file.
-  off64_t file_offset;
-  int fd = open_library(name, &file_offset);
-  if (fd == -1) {
-    DL_ERR("library \"%s\" not found", name);
-    return nullptr;
+  // Open the file unless it has already been opened by prefetch_load_tasks().
+  uint64_t open_ns = 0;
+  if (task->get_fd() == -1) {
+    uint64_t open_start_ns = LoadProfile::now_ns();
+    off64_t file_offset;
+    off64_t file_length;
+    int fd = open_library(name, &file_offset, &file_length);
+    if (fd == -1) {
+      DL_ERR("library \"%s\" not found", name);
+      return nullptr;
+    }
+    task->set_fd(fd, file_offset);
+    open_ns = LoadProfile::now_ns() - open_start_ns;
   }
-  soinfo* result = load_library(fd, file_offset, load_tasks, name, rtld_flags, extinfo);
-  close(fd);
-  return result;
+
+  soinfo* si = load_library(task->get_fd(), task->get_file_offset(), load_tasks,
+                            name, rtld_flags, extinfo);
+  if (si != nullptr && si->get_load_profile() != nullptr) {
+    si->get_load_profile()->open_ns += open_ns;
+  }
+
+  return si;
 }
 
 // Returns true if library was found and false in 2 cases
@@ -1380,9 +1643,14 @@ static bool find_loaded_library_by_soname(const char* name, soinfo** candidate)
     return false;
   }
 
+  const std::vector<soinfo*>* soinfos = SoinfoRegistry::find_by_soname(name);
+  if (soinfos == nullptr) {
+    return false;
+  }
+
   uint32_t target_sdk_version = get_application_target_sdk_version();
 
-  for (soinfo* si = solist; si != nullptr; si = si->next) {
+  for (soinfo* si : *soinfos) {
     // If the library was opened under different target sdk version
     // skip this step and try to reopen it. The exceptions are
     // "libdl.so" and global group. There is no point in skipping
@@ -1393,30 +1661,28 @@ static bool find_loaded_library_by_soname(const char* name, soinfo** candidate)
       continue;
     }
 
-    const char* soname = si->get_soname();
-    if (soname != nullptr && (strcmp(name, soname) == 0)) {
-      // If the library was opened under different target sdk version
-      // skip this step and try to reopen it. The exceptions are
-      // "libdl.so" and global group. There is no point in skipping
-      // them because relocation process is going to use them
-      // in any case.
-      bool is_libdl = si == solist;
-      if (is_libdl || (si->get_dt_flags_1() & DF_1_GLOBAL) != 0 ||
-          !si->is_linked() || si->get_target_sdk_version() == target_sdk_version) {
-        *candidate = si;
-        return true;
-      } else if (*candidate == nullptr) {
-        // for the different sdk version - remember the first library.
-        *candidate = si;
-      }
+    // If the library was opened under different target sdk version
+    // skip this step and try to reopen it. The exceptions are
+    // "libdl.so" and global group. There is no point in skipping
+    // them because relocation process is going to use them
+    // in any case.
+    bool is_libdl = si == solist;
+    if (is_libdl || (si->get_dt_flags_1() & DF_1_GLOBAL) != 0 ||
+        !si->is_linked() || si->get_target_sdk_version() == target_sdk_version) {
+      *candidate = si;
+      return true;
+    } else if (*candidate == nullptr) {
+      // for the different sdk version - remember the first library.
+      *candidate = si;
     }
   }
 
   return false;
 }
 
-static soinfo* find_library_internal(LoadTaskList& load_tasks, const char* name,
+static soinfo* find_library_internal(LoadTaskList& load_tasks, LoadTask* task,
                                      int rtld_flags, const android_dlextinfo* extinfo) {
+  const char* name = task->get_name();
   soinfo* candidate;
 
   if (find_loaded_library_by_soname(name, &candidate)) {
@@ -1428,7 +1694,7 @@ static soinfo* find_library_internal(LoadTaskList& load_tasks, const char* name,
   TRACE("[ '%s' find_loaded_library_by_soname returned false (*candidate=%s@%p). Trying harder...]",
       name, candidate == nullptr ? "n/a" : candidate->get_realpath(), candidate);
 
-  soinfo* si = load_library(load_tasks, name, rtld_flags, extinfo);
+  soinfo* si = load_library(load_tasks, task, rtld_flags, extinfo);
 
   // In case we were unable to load the library but there
   // is a candidate loaded under the same soname but different
@@ -1440,6 +1706,64 @@ static soinfo* find_library_internal(LoadTaskList& load_tasks, const char* name,
   return si;
 }
 
+// Maximum number of files prefetch_load_tasks() opens ahead of time.
+static const size_t kMaxPrefetchedLoadTasks = 16;
+
+// Opens the library for the task and asks the kernel to start reading
+// it in. Returns false if nothing was opened.
+static bool prefetch_load_task(LoadTask* task, const android_dlextinfo* extinfo) {
+  task->set_prefetched();
+
+  // The library comes from extinfo->library_fd, see load_library().
+  if (task->get_needed_by() == nullptr && extinfo != nullptr &&
+      (extinfo->flags & ANDROID_DLEXT_USE_LIBRARY_FD) != 0) {
+    return false;
+  }
+
+  soinfo* candidate;
+  if (find_loaded_library_by_soname(task->get_name(), &candidate)) {
+    return false;
+  }
+
+  off64_t file_offset;
+  off64_t file_length;
+  int fd = open_library(task->get_name(), &file_offset, &file_length);
+  if (fd == -1) {
+    // load_library() will try again and report the error.
+    return false;
+  }
+
+  task->set_fd(fd, file_offset);
+
+  // Only read the library itself, not the rest of the zip file it may be
+  // stored in. A zero length means "up to the end of the file".
+  int error = posix_fadvise(fd, file_offset, file_length, POSIX_FADV_WILLNEED);
+  if (error != 0) {
+    TRACE("[ posix_fadvise for \"%s\" failed: %s ]", task->get_name(), strerror(error));
+  }
+  return true;
+}
+
+// Libraries are loaded one at a time, and for every one of them the
+// linker waits for the disk while mapping and prelinking it. To overlap
+// that I/O with the work on the library at hand, open the files for the
+// next few pending load tasks (the rest of the current breadth-first
+// level and whatever is queued after it) and start reading them in.
+static void prefetch_load_tasks(LoadTask* task, LoadTaskList& load_tasks,
+                                const android_dlextinfo* extinfo) {
+  size_t prefetched_count = prefetch_load_task(task, extinfo) ? 1 : 0;
+  load_tasks.visit([&](LoadTask* pending_task) {
+    if (prefetched_count == kMaxPrefetchedLoadTasks) {
+      return false;
+    }
+
+    if (!pending_task->is_prefetched() && prefetch_load_task(pending_task, extinfo)) {
+      ++prefetched_count;
+    }
+    return true;
+  });
+}
+
 static void soinfo_unload(soinfo* si);
 
 // TODO: this is slightly unusual way to construct
@@ -1464,6 +1788,7 @@ static bool find_libraries(soinfo* start_with, const char* const library_names[]
       size_t library_names_count, soinfo* soinfos[], std::vector<soinfo*>* ld_preloads,
       size_t ld_preloads_count, int rtld_flags, const android_dlextinfo* extinfo) {
   // Step 0: prepare.
+  SearchDirCache::begin_search();
   LoadTaskList load_tasks;
   for (size_t i = 0; i < library_names_count; ++i) {
     const char* name = library_names[i];
@@ -1505,7 +1830,11 @@ static bool find_libraries(soinfo* start_with, const char* const library_names[]
       task.get() != nullptr; task.reset(load_tasks.pop_front())) {
     soinfo* needed_by = task->get_needed_by();
 
-    soinfo* si = find_library_internal(load_tasks, task->get_name(),
+    if (!task->is_prefetched()) {
+      prefetch_load_tasks(task.get(), load_tasks, extinfo);
+    }
+
+    soinfo* si = find_library_internal(load_tasks, task.get(),
                                        rtld_flags, needed_by == nullptr ? extinfo : nullptr);
     if (si == nullptr) {
       return false;
@@ -1549,6 +1878,13 @@ static bool find_libraries(soinfo* start_with, const char* const library_names[]
   // the root of the local group was not linked.
   bool was_local_group_root_linked = local_group.front()->is_linked();
 
+  GroupLookupCache lookup_cache(global_group, local_group);
+  GroupLookupCache* previous_lookup_cache = g_group_lookup_cache;
+  g_group_lookup_cache = &lookup_cache;
+  auto lookup_cache_guard = make_scope_guard([&]() {
+    g_group_lookup_cache = previous_lookup_cache;
+  });
+
   bool linked = local_group.visit([&](soinfo* si) {
     if (!si->is_linked()) {
       if (!si->link_image(global_group, local_group, extinfo)) {
@@ -1583,6 +1919,116 @@ static soinfo* find_library(const char* name, int rtld_flags, const android_dlex
   return si;
 }
 
+// Adds the libraries of the local group of 'root' to 'unload_list' (depth
+// first, the order their destructors are called in), and the libraries of
+// other groups they depend on to 'external_list'.
+static void soinfo_collect_unload_group(soinfo* root, std::vector<soinfo*>* unload_list,
+                                        std::vector<soinfo*>* external_list) {
+  soinfo::soinfo_list_t depth_first_list;
+  depth_first_list.push_back(root);
+  soinfo* si = nullptr;
+
+  while ((si = depth_first_list.pop_front()) != nullptr) {
+    if (si->is_unloading()) {
+      continue;
+    }
+
+    si->set_unloading();
+    unload_list->push_back(si);
+
+    if (si->has_min_version(0)) {
+      si->get_children().for_each([&] (soinfo* child) {
+        TRACE("%s@%p needs to unload %s@%p", si->get_realpath(), si,
+            child->get_realpath(), child);
+
+        if (child->is_unloading()) {
+          return;
+        } else if (child->is_linked() && child->get_local_group_root() != root) {
+          external_list->push_back(child);
+        } else {
+          depth_first_list.push_front(child);
+        }
+      });
+    } else {
+#if !defined(__work_around_b_19059885__)
+      __libc_fatal("soinfo for \"%s\"@%p has no version", si->get_realpath(), si);
+#else
+      PRINT("warning: soinfo for \"%s\"@%p has no version", si->get_realpath(), si);
+      for_each_dt_needed(si, [&] (const char* library_name) {
+        TRACE("deprecated (old format of soinfo): %s needs to unload %s",
+            si->get_realpath(), library_name);
+
+        soinfo* needed = find_library(library_name, RTLD_NOLOAD, nullptr);
+        if (needed != nullptr) {
+          // Not found: for example if symlink was deleted between dlopen and dlclose
+          // Since we cannot really handle errors at this point - print and continue.
+          PRINT("warning: couldn't find %s needed by %s on unload.",
+              library_name, si->get_realpath());
+          return;
+        } else if (needed->is_unloading()) {
+          // already visited
+          return;
+        } else if (needed->is_linked() && needed->get_local_group_root() != root) {
+          // external group
+          external_list->push_back(needed);
+        } else {
+          // local group
+          depth_first_list.push_front(needed);
+        }
+      });
+#endif
+    }
+  }
+}
+
+// Frees everything in 'unload_list' at once: one pass over solist instead
+// of one per library, and adjacent mappings (libraries loaded next to each
+// other) released with a single munmap. The libraries are only unmapped once
+// no dl_iterate_phdr() or dl_unwind_find_exidx() caller can still see them.
+static void soinfo_free_unloaded(const std::vector<soinfo*>& unload_list) {
+  std::vector<std::pair<ElfW(Addr), size_t>> mappings;
+
+  for (soinfo* si : unload_list) {
+    TRACE("name %s: freeing soinfo @ %p", si->get_realpath(), si);
+    if (si->base != 0 && si->size != 0) {
+      mappings.push_back(std::make_pair(si->base, si->size));
+    }
+    si->remove_all_links();
+    SoinfoRegistry::remove(si);
+  }
+
+  // The first entry in solist is always the static libdl_info,
+  // which is never unloaded.
+  soinfo* prev = solist;
+  for (soinfo* si = solist->next; si != nullptr; si = si->next) {
+    if (si->is_unloading()) {
+      prev->next = si->next;
+    } else {
+      prev = si;
+    }
+  }
+  sonext = prev;
+  g_soinfo_subs += unload_list.size();
+
+  publish_solist();
+  PhdrSnapshot::wait_for_readers();
+
+  std::sort(mappings.begin(), mappings.end());
+  for (size_t i = 0; i < mappings.size(); ) {
+    ElfW(Addr) start = mappings[i].first;
+    ElfW(Addr) end = start + mappings[i].second;
+    for (++i; i < mappings.size() && mappings[i].first == end; ++i) {
+      end += mappings[i].second;
+    }
+    munmap(reinterpret_cast<void*>(start), end - start);
+  }
+
+  for (soinfo* si : unload_list) {
+    si->~soinfo();
+    g_soinfo_allocator.free(si);
+  }
+}
+
 static void soinfo_unload(soinfo* root) {
   // Note that the library can be loaded but not linked;
   // in which case there is no root but we still need
@@ -1601,81 +2047,56 @@ static void soinfo_unload(soinfo* root) {
 
   size_t ref_count = root->is_linked() ? root->decrement_ref_count() : 0;
 
-  if (ref_count == 0) {
-    soinfo::soinfo_list_t local_unload_list;
-    soinfo::soinfo_list_t external_unload_list;
-    soinfo::soinfo_list_t depth_first_list;
-    depth_first_list.push_back(root);
-    soinfo* si = nullptr;
+  if (ref_count != 0) {
+    TRACE("not unloading '%s' group, decrementing ref_count to %zd",
+        root->get_realpath(), ref_count);
+    return;
+  }
+
+  // Find everything that goes away with this group in one pass over the
+  // graph: the group itself, and the groups it depends on that are left
+  // without references once it is gone (and so on).
+  std::vector<soinfo*> group_roots;
+  std::vector<soinfo*> unload_list;
+  group_roots.push_back(root);
 
-    while ((si = depth_first_list.pop_front()) != nullptr) {
-      if (local_unload_list.contains(si)) {
+  for (size_t i = 0; i < group_roots.size(); ++i) {
+    std::vector<soinfo*> external_list;
+    soinfo_collect_unload_group(group_roots[i], &unload_list, &external_list);
+
+    for (soinfo* external : external_list) {
+      soinfo* external_root = external->get_local_group_root();
+      if (std::find(group_roots.begin(), group_roots.end(), external_root) != group_roots.end()) {
         continue;
       }
 
-      local_unload_list.push_back(si);
-
-      if (si->has_min_version(0)) {
-        soinfo* child = nullptr;
-        while ((child = si->get_children().pop_front()) != nullptr) {
-          TRACE("%s@%p needs to unload %s@%p", si->get_realpath(), si,
-              child->get_realpath(), child);
+      if (!external_root->can_unload()) {
+        TRACE("not unloading '%s' - the binary is flagged with NODELETE",
+            external_root->get_realpath());
+        continue;
+      }
 
-          if (local_unload_list.contains(child)) {
-            continue;
-          } else if (child->is_linked() && child->get_local_group_root() != root) {
-            external_unload_list.push_back(child);
-          } else {
-            depth_first_list.push_front(child);
-          }
-        }
+      ref_count = external_root->decrement_ref_count();
+      if (ref_count == 0) {
+        group_roots.push_back(external_root);
       } else {
-#if !defined(__work_around_b_19059885__)
-        __libc_fatal("soinfo for \"%s\"@%p has no version", si->get_realpath(), si);
-#else
-        PRINT("warning: soinfo for \"%s\"@%p has no version", si->get_realpath(), si);
-        for_each_dt_needed(si, [&] (const char* library_name) {
-          TRACE("deprecated (old format of soinfo): %s needs to unload %s",
-              si->get_realpath(), library_name);
-
-          soinfo* needed = find_library(library_name, RTLD_NOLOAD, nullptr);
-          if (needed != nullptr) {
-            // Not found: for example if symlink was deleted between dlopen and dlclose
-            // Since we cannot really handle errors at this point - print and continue.
-            PRINT("warning: couldn't find %s needed by %s on unload.",
-                library_name, si->get_realpath());
-            return;
-          } else if (local_unload_list.contains(needed)) {
-            // already visited
-            return;
-          } else if (needed->is_linked() && needed->get_local_group_root() != root) {
-            // external group
-            external_unload_list.push_back(needed);
-          } else {
-            // local group
-            depth_first_list.push_front(needed);
-          }
-        });
-#endif
+        TRACE("not unloading '%s' group, decrementing ref_count to %zd",
+            external_root->get_realpath(), ref_count);
       }
     }
+  }
 
-    local_unload_list.for_each([](soinfo* si) {
-      si->call_destructors();
-    });
-
-    while ((si = local_unload_list.pop_front()) != nullptr) {
-      notify_gdb_of_unload(si);
-      soinfo_free(si);
-    }
+  // Dependencies are unloaded after the libraries that need them,
+  // so they are still there while the destructors run.
+  for (soinfo* si : unload_list) {
+    si->call_destructors();
+  }
 
-    while ((si = external_unload_list.pop_front()) != nullptr) {
-      soinfo_unload(si);
-    }
-  } else {
-    TRACE("not unloading '%s' group, decrementing ref_count to %zd",
-        root->get_realpath(), ref_count);
+  for (soinfo* si : unload_list) {
+    notify_gdb_of_unload(si);
   }
+
+  soinfo_free_unloaded(unload_list);
 }
 
 void do_android_get_LD_LIBRARY_PATH(char* buffer, size_t buffer_size) {
@@ -1703,6 +2124,8 @@ void do_android_get_LD_LIBRARY_PATH(char* buffer, size_t buffer_size) {
 
 void do_android_update_LD_LIBRARY_PATH(const char* ld_library_path) {
   parse_LD_LIBRARY_PATH(ld_library_path);
+  // Drop the listings of the directories that are no longer searched.
+  SearchDirCache::clear();
 }
 
 soinfo* do_dlopen(const char* name, int flags, const android_dlextinfo* extinfo) {
@@ -1721,13 +2144,23 @@ soinfo* do_dlopen(const char* name, int flags, const android_dlextinfo* extinfo)
           "ANDROID_DLEXT_USE_LIBRARY_FD): 0x%" PRIx64, extinfo->flags);
       return nullptr;
     }
+    if ((extinfo->flags & ANDROID_DLEXT_USE_SHARED_RELRO) != 0 &&
+        ((extinfo->flags & ANDROID_DLEXT_RESERVED_ADDRESS) == 0 ||
+         (extinfo->flags & (ANDROID_DLEXT_WRITE_RELRO | ANDROID_DLEXT_USE_RELRO)) != 0)) {
+      DL_ERR("invalid extended flag combination (ANDROID_DLEXT_USE_SHARED_RELRO requires "
+          "ANDROID_DLEXT_RESERVED_ADDRESS and excludes ANDROID_DLEXT_WRITE_RELRO and "
+          "ANDROID_DLEXT_USE_RELRO): 0x%" PRIx64, extinfo->flags);
+      return nullptr;
+    }
   }
 
   ProtectedDataGuard guard;
   soinfo* si = find_library(name, flags, extinfo);
+  publish_solist();
   if (si != nullptr) {
     si->call_constructors();
   }
+  LoadProfile::report();
   return si;
 }
 
@@ -1736,6 +2169,13 @@ void do_dlclose(soinfo* si) {
   soinfo_unload(si);
 }
 
+#if !defined(__mips__)
+bool do_bind_plt_slot(soinfo* si, size_t reloc_index, ElfW(Addr)* target) {
+  ProtectedDataGuard guard;
+  return si->bind_plt_slot(reloc_index, target);
+}
+#endif
+
 static ElfW(Addr) call_ifunc_resolver(ElfW(Addr) resolver_addr) {
   typedef ElfW(Addr) (*ifunc_resolver_t)(void);
   ifunc_resolver_t ifunc_resolver = reinterpret_cast<ifunc_resolver_t>(resolver_addr);
@@ -1871,13 +2311,36 @@ static ElfW(Addr) get_addend(ElfW(Rel)* rel, ElfW(Addr) reloc_addr) {
 
 template<typename ElfRelIteratorT>
 bool soinfo::relocate(const VersionTracker& version_tracker, ElfRelIteratorT&& rel_iterator,
-                      const soinfo_list_t& global_group, const soinfo_list_t& local_group) {
+                      const soinfo_list_t& global_group, const soinfo_list_t& local_group,
+                      SymbolResolutionCache* symbol_cache) {
   for (size_t idx = 0; rel_iterator.has_next(); ++idx) {
+    // Relative relocations, the bulk of them in most libraries, tend to come
+    // in runs covering tables of pointers; apply those without going through
+    // the switch below one relocation at a time.
+    size_t run = rel_iterator.apply_relative_run(load_bias);
+    if (run != 0) {
+      TRACE_TYPE(RELO, "RELO RELATIVE run of %zd at index %zd", run, idx);
+#if STATS
+      for (size_t i = 0; i < run; ++i) {
+        count_relocation(kRelocRelative);
+      }
+#endif
+      if (load_profile_ != nullptr) {
+        load_profile_->relocations += run;
+      }
+      idx += run - 1;
+      continue;
+    }
+
     const auto rel = rel_iterator.next();
     if (rel == nullptr) {
       return false;
     }
 
+    if (load_profile_ != nullptr) {
+      ++load_profile_->relocations;
+    }
+
     ElfW(Word) type = ELFW(R_TYPE)(rel->r_info);
     ElfW(Word) sym = ELFW(R_SYM)(rel->r_info);
 
@@ -1896,14 +2359,26 @@ bool soinfo::relocate(const VersionTracker& version_tracker, ElfRelIteratorT&& r
 
     if (sym != 0) {
       sym_name = get_string(symtab_[sym].st_name);
+
       const version_info* vi = nullptr;
 
       if (!lookup_version_info(version_tracker, sym, sym_name, &vi)) {
         return false;
       }
 
-      if (!soinfo_do_lookup(this, sym_name, vi, &lsi, global_group, local_group, &s)) {
-        return false;
+      if (symbol_cache != nullptr && symbol_cache->lookup(sym, sym_name, vi, &lsi, &s)) {
+        if (load_profile_ != nullptr) {
+          ++load_profile_->cached_lookups;
+        }
+      } else {
+        if (!soinfo_do_lookup(this, sym_name, vi, &lsi, global_group, local_group, &s)) {
+          return false;
+        }
+
+        if (symbol_cache != nullptr) {
+          symbol_cache->record(sym, s == nullptr ? nullptr : lsi,
+                               s == nullptr ? 0 : s - lsi->symtab_);
+        }
       }
 
       if (s == nullptr) {
@@ -2235,8 +2710,224 @@ bool soinfo::relocate(const VersionTracker& version_tracker, ElfRelIteratorT&& r
   }
   return true;
 }
+
+bool soinfo::can_bind_lazily() const {
+  if ((flags_ & FLAG_LINKER) != 0 || g_ld_bind_now) {
+    return false;
+  }
+
+  // Note that RTLD_NOW is 0 on 32-bit platforms.
+  uint32_t rtld_flags = get_rtld_flags();
+  if ((rtld_flags & RTLD_LAZY) == 0 || (rtld_flags & RTLD_NOW) != 0) {
+    return false;
+  }
+
+  if ((get_dt_flags_1() & DF_1_NOW) != 0) {
+    return false;
+  }
+
+#if defined(USE_RELA)
+  size_t plt_rel_count = plt_rela_ != nullptr ? plt_rela_count_ : 0;
+#else
+  size_t plt_rel_count = plt_rel_ != nullptr ? plt_rel_count_ : 0;
+#endif
+  if (plt_got_ == nullptr || plt_rel_count == 0) {
+    return false;
+  }
+
+  // The GOT is written to every time a slot gets bound, it can not
+  // live on a page that is going to be made read-only by GNU RELRO.
+  ElfW(Addr) got_start = reinterpret_cast<ElfW(Addr)>(plt_got_);
+  ElfW(Addr) got_end = got_start + (3 + plt_rel_count) * sizeof(ElfW(Addr));
+  for (size_t i = 0; i < phnum; ++i) {
+    if (phdr[i].p_type != PT_GNU_RELRO) {
+      continue;
+    }
+
+    ElfW(Addr) seg_page_start = PAGE_START(phdr[i].p_vaddr) + load_bias;
+    ElfW(Addr) seg_page_end = PAGE_END(phdr[i].p_vaddr + phdr[i].p_memsz) + load_bias;
+    if (got_start < seg_page_end && got_end > seg_page_start) {
+      DEBUG("%s: PLT GOT is in the GNU RELRO segment, binding it eagerly", get_realpath());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool soinfo::prepare_lazy_plt(const VersionTracker& version_tracker,
+                              const soinfo_list_t& global_group,
+                              const soinfo_list_t& local_group,
+                              SymbolResolutionCache* symbol_cache) {
+#if defined(USE_RELA)
+  ElfW(Rela)* plt_rel = plt_rela_;
+  size_t plt_rel_count = plt_rela_count_;
+#else
+  ElfW(Rel)* plt_rel = plt_rel_;
+  size_t plt_rel_count = plt_rel_count_;
+#endif
+
+  for (size_t i = 0; i < plt_rel_count; ++i) {
+    if (ELFW(R_TYPE)(plt_rel[i].r_info) != R_GENERIC_JUMP_SLOT) {
+      // Everything else (R_GENERIC_IRELATIVE, for example) is applied right away.
+      if (!relocate(version_tracker, plain_reloc_iterator(plt_rel + i, 1),
+                    global_group, local_group, symbol_cache)) {
+        return false;
+      }
+      continue;
+    }
+
+    // An unbound slot points back into the PLT: to PLT0 on arm and arm64 and
+    // to the push following the indirect jump on x86 and x86_64. Either way
+    // it only needs to be adjusted by the load bias.
+    ElfW(Addr) reloc = static_cast<ElfW(Addr)>(plt_rel[i].r_offset + load_bias);
+    *reinterpret_cast<ElfW(Addr)*>(reloc) += load_bias;
+  }
+
+  // GOT[1] and GOT[2] are reserved for the dynamic linker; PLT0 passes
+  // GOT[1] to the function in GOT[2].
+  ElfW(Addr)* got = reinterpret_cast<ElfW(Addr)*>(plt_got_);
+  got[1] = reinterpret_cast<ElfW(Addr)>(this);
+  got[2] = reinterpret_cast<ElfW(Addr)>(&__linker_plt_resolve_trampoline);
+
+  return true;
+}
+
+bool soinfo::bind_plt_slot(size_t reloc_index, ElfW(Addr)* target) {
+#if defined(USE_RELA)
+  if (reloc_index >= plt_rela_count_) {
+    DL_ERR("invalid PLT relocation index %zd in \"%s\"", reloc_index, get_realpath());
+    return false;
+  }
+  const ElfW(Rela)* rel = plt_rela_ + reloc_index;
+  ElfW(Addr) addend = rel->r_addend;
+#else
+  if (reloc_index >= plt_rel_count_) {
+    DL_ERR("invalid PLT relocation index %zd in \"%s\"", reloc_index, get_realpath());
+    return false;
+  }
+  const ElfW(Rel)* rel = plt_rel_ + reloc_index;
+  ElfW(Addr) addend = 0;
+#endif
+
+  ElfW(Word) type = ELFW(R_TYPE)(rel->r_info);
+  if (type != R_GENERIC_JUMP_SLOT) {
+    DL_ERR("unexpected reloc type %d for PLT slot %zd in \"%s\"",
+           type, reloc_index, get_realpath());
+    return false;
+  }
+
+  ElfW(Word) sym = ELFW(R_SYM)(rel->r_info);
+  const char* sym_name = get_string(symtab_[sym].st_name);
+
+  // Search the same scope link_image() would have used. Every call through
+  // an unbound slot gets here, so build it only once (the caller holds the
+  // dlfcn lock).
+  LazyBindScope* scope = lazy_bind_scope_;
+  if (scope == nullptr) {
+    scope = new LazyBindScope();
+    if (!scope->version_tracker.init(this)) {
+      delete scope;
+      return false;
+    }
+    soinfo* local_group_root = get_local_group_root();
+    walk_dependencies_tree(&local_group_root, 1, [&] (soinfo* si) {
+      scope->local_group.push_back(si);
+      return true;
+    });
+    scope->adds = 0;
+    scope->subs = 0;
+    lazy_bind_scope_ = scope;
+  }
+  if (scope->adds != g_soinfo_adds || scope->subs != g_soinfo_subs) {
+    scope->global_group.clear();
+    make_global_group().for_each([&](soinfo* si) {
+      scope->global_group.push_back(si);
+    });
+    scope->adds = g_soinfo_adds;
+    scope->subs = g_soinfo_subs;
+  }
+
+  const version_info* vi = nullptr;
+  if (!lookup_version_info(scope->version_tracker, sym, sym_name, &vi)) {
+    return false;
+  }
+
+  soinfo* lsi = nullptr;
+  const ElfW(Sym)* s = nullptr;
+  if (!soinfo_do_lookup(this, sym_name, vi, &lsi, scope->global_group, scope->local_group, &s)) {
+    return false;
+  }
+
+  ElfW(Addr) sym_addr = 0;
+  if (s != nullptr) {
+    sym_addr = lsi->resolve_symbol_address(s);
+  } else if (ELF_ST_BIND(symtab_[sym].st_info) != STB_WEAK) {
+    DL_ERR("cannot locate symbol \"%s\" referenced by \"%s\"...", sym_name, get_realpath());
+    return false;
+  }
+
+  ElfW(Addr) reloc = static_cast<ElfW(Addr)>(rel->r_offset + load_bias);
+  TRACE_TYPE(RELO, "RELO JMP_SLOT (lazy) %16p <- %16p %s\n",
+             reinterpret_cast<void*>(reloc),
+             reinterpret_cast<void*>(sym_addr + addend), sym_name);
+
+  *reinterpret_cast<ElfW(Addr)*>(reloc) = sym_addr + addend;
+  *target = sym_addr + addend;
+  return true;
+}
 #endif  // !defined(__mips__)
 
+// Applies relative relocations encoded by "relocation_packer -r": an even
+// entry is the address of a relocation, an odd entry is a bitmap of which
+// of the following 63 (31 on LP32) words are relocated too. The value to
+// relocate is always the one stored at the address, even for RELA.
+bool soinfo::relocate_relr(const ElfW(Addr)* begin, const ElfW(Addr)* end) {
+  const size_t bitmap_words = 8 * sizeof(ElfW(Addr)) - 1;
+  ElfW(Addr)* where = nullptr;
+  size_t relocation_count = 0;
+
+  for (const ElfW(Addr)* entry = begin; entry != end; ++entry) {
+    if ((*entry & 1) == 0) {
+      where = reinterpret_cast<ElfW(Addr)*>(load_bias + *entry);
+      *where++ += load_bias;
+      ++relocation_count;
+      continue;
+    }
+
+    if (where == nullptr) {
+      DL_ERR("\"%s\" has a relocation bitmap without an address", get_realpath());
+      return false;
+    }
+
+    // Apply each run of set bits at once.
+    ElfW(Addr)* reloc = where;
+    for (ElfW(Addr) bitmap = *entry >> 1; bitmap != 0; ) {
+      size_t skip = __builtin_ctzl(bitmap);
+      reloc += skip;
+      bitmap >>= skip;
+      // The top bit is always clear, so ~bitmap is never 0.
+      size_t run = __builtin_ctzl(~bitmap);
+      apply_relative_relocation_run(reloc, run, load_bias);
+      relocation_count += run;
+      reloc += run;
+      bitmap >>= run;
+    }
+    where += bitmap_words;
+  }
+
+  DEBUG("[ %s: %zd bitmap encoded relative relocations ]", get_realpath(), relocation_count);
+#if STATS
+  for (size_t i = 0; i < relocation_count; ++i) {
+    count_relocation(kRelocRelative);
+  }
+#endif
+  if (load_profile_ != nullptr) {
+    load_profile_->relocations += relocation_count;
+  }
+  return true;
+}
+
 void soinfo::call_array(const char* array_name __unused, linker_function_t* functions,
                         size_t count, bool reverse) {
   if (functions == nullptr) {
@@ -2302,9 +2993,16 @@ void soinfo::call_constructors() {
 
   TRACE("\"%s\": calling constructors", get_realpath());
 
+  uint64_t constructors_start_ns = LoadProfile::now_ns();
+
   // DT_INIT should be called before DT_INIT_ARRAY if both are present.
   call_function("DT_INIT", init_func_);
   call_array("DT_INIT_ARRAY", init_array_, init_array_count_, false);
+
+  LoadProfileEntry* profile = get_load_profile();
+  if (profile != nullptr) {
+    profile->constructors_ns += LoadProfile::now_ns() - constructors_start_ns;
+  }
 }
 
 void soinfo::call_destructors() {
@@ -2336,14 +3034,23 @@ void soinfo::remove_all_links() {
     return;
   }
 
-  // 1. Untie connected soinfos from 'this'.
+  // 1. Untie connected soinfos from 'this'. There is no need to update
+  // the ones being unloaded together with it, their lists go away as well.
   children_.for_each([&] (soinfo* child) {
+    if (child->is_unloading()) {
+      return;
+    }
+
     child->parents_.remove_if([&] (const soinfo* parent) {
       return parent == this;
     });
   });
 
   parents_.for_each([&] (soinfo* parent) {
+    if (parent->is_unloading()) {
+      return;
+    }
+
     parent->children_.remove_if([&] (const soinfo* child) {
       return child == this;
     });
@@ -2370,6 +3077,14 @@ ino_t soinfo::get_st_ino() const {
   return 0;
 }
 
+time_t soinfo::get_st_mtime() const {
+  if (has_min_version(3)) {
+    return st_mtime_;
+  }
+
+  return 0;
+}
+
 off64_t soinfo::get_file_offset() const {
   if (has_min_version(1)) {
     return file_offset_;
@@ -2378,6 +3093,14 @@ off64_t soinfo::get_file_offset() const {
   return 0;
 }
 
+LoadProfileEntry* soinfo::get_load_profile() const {
+  if (has_min_version(4)) {
+    return load_profile_;
+  }
+
+  return nullptr;
+}
+
 uint32_t soinfo::get_rtld_flags() const {
   if (has_min_version(1)) {
     return rtld_flags_;
@@ -2481,6 +3204,14 @@ bool soinfo::is_gnu_hash() const {
   return (flags_ & FLAG_GNU_HASH) != 0;
 }
 
+size_t soinfo::get_symbol_count() const {
+  if (!is_gnu_hash()) {
+    return nchain_;
+  }
+
+  return gnu_hash_symbol_count(gnu_bucket_, gnu_nbucket_, gnu_chain_);
+}
+
 bool soinfo::can_unload() const {
   return (get_rtld_flags() & (RTLD_NODELETE | RTLD_GLOBAL)) == 0;
 }
@@ -2489,6 +3220,10 @@ bool soinfo::is_linked() const {
   return (flags_ & FLAG_LINKED) != 0;
 }
 
+bool soinfo::is_unloading() const {
+  return (flags_ & FLAG_UNLOADING) != 0;
+}
+
 bool soinfo::is_main_executable() const {
   return (flags_ & FLAG_EXE) != 0;
 }
@@ -2497,6 +3232,10 @@ void soinfo::set_linked() {
   flags_ |= FLAG_LINKED;
 }
 
+void soinfo::set_unloading() {
+  flags_ |= FLAG_UNLOADING;
+}
+
 void soinfo::set_linker_flag() {
   flags_ |= FLAG_LINKER;
 }
@@ -2562,6 +3301,7 @@ bool soinfo::prelink_image() {
   //
   // source: http://www.sco.com/developers/gabi/1998-04-29/ch5.dynamic.html
   uint32_t needed_count = 0;
+  bool bind_now = false;
   for (ElfW(Dyn)* d = dynamic; d->d_tag != DT_NULL; ++d) {
     DEBUG("d = %p, d[0](tag) = %p d[1](val) = %p",
           d, reinterpret_cast<void*>(d->d_tag), reinterpret_cast<void*>(d->d_un.d_val));
@@ -2650,11 +3390,9 @@ bool soinfo::prelink_image() {
         break;
 
       case DT_PLTGOT:
-#if defined(__mips__)
-        // Used by mips and mips64.
+        // Used by mips and mips64 for GOT relocation and by
+        // other platforms for lazy binding.
         plt_got_ = reinterpret_cast<ElfW(Addr)**>(load_bias + d->d_un.d_ptr);
-#endif
-        // Ignore for other platforms... (because RTLD_LAZY is not supported)
         break;
 
       case DT_DEBUG:
@@ -2829,6 +3567,9 @@ bool soinfo::prelink_image() {
         if (d->d_un.d_val & DF_SYMBOLIC) {
           has_DT_SYMBOLIC = true;
         }
+        if (d->d_un.d_val & DF_BIND_NOW) {
+          bind_now = true;
+        }
         break;
 
       case DT_FLAGS_1:
@@ -2873,8 +3614,9 @@ bool soinfo::prelink_image() {
         mips_gotsym_ = d->d_un.d_val;
         break;
 #endif
-      // Ignored: "Its use has been superseded by the DF_BIND_NOW flag"
+      // "Its use has been superseded by the DF_BIND_NOW flag"
       case DT_BIND_NOW:
+        bind_now = true;
         break;
 
       case DT_VERSYM:
@@ -2908,6 +3650,12 @@ bool soinfo::prelink_image() {
   DEBUG("si->base = %p, si->strtab = %p, si->symtab = %p",
         reinterpret_cast<void*>(base), strtab_, symtab_);
 
+  // DT_BIND_NOW and DF_BIND_NOW mean the same thing as DF_1_NOW,
+  // keep them all in one place.
+  if (bind_now) {
+    set_dt_flags_1(get_dt_flags_1() | DF_1_NOW);
+  }
+
   // Sanity checks.
   if (relocating_linker && needed_count != 0) {
     DL_ERR("linker cannot have DT_NEEDED dependencies on other libraries");
@@ -2953,8 +3701,149 @@ bool soinfo::prelink_image() {
   return true;
 }
 
+static const char* const kSharedRelroDir = "/data/misc/shared_relro";
+
+static bool make_shared_relro_path(const soinfo* si, char* buf, size_t buf_size,
+                                   const char* suffix) {
+  // The relocated RELRO contents depend on the file and on the address it
+  // was loaded at (the addresses of the dependencies are checked by
+  // comparing the pages before they are replaced).
+  int n = __libc_format_buffer(buf, buf_size,
+                               "%s/%" PRIx64 "_%" PRIx64 "_%" PRIx64 "_%" PRIx64 "_%" PRIx64 ".relro%s",
+                               kSharedRelroDir,
+                               static_cast<uint64_t>(si->get_st_dev()),
+                               static_cast<uint64_t>(si->get_st_ino()),
+                               static_cast<uint64_t>(si->get_st_mtime()),
+                               static_cast<uint64_t>(si->get_file_offset()),
+                               static_cast<uint64_t>(si->load_bias),
+                               suffix);
+  return n > 0 && n < static_cast<int>(buf_size);
+}
+
+// A private file mapping keeps following the file contents until the page
+// is written to, so only use files that nobody but their owner can modify,
+// and whose owner is either us or the owner of the store.
+static bool is_trusted_shared_relro(int fd) {
+  struct stat file_stat;
+  struct stat dir_stat;
+  if (TEMP_FAILURE_RETRY(fstat(fd, &file_stat)) != 0 ||
+      TEMP_FAILURE_RETRY(stat(kSharedRelroDir, &dir_stat)) != 0) {
+    return false;
+  }
+
+  return S_ISREG(file_stat.st_mode) &&
+      (file_stat.st_mode & (S_IWGRP | S_IWOTH)) == 0 &&
+      (file_stat.st_uid == getuid() || file_stat.st_uid == dir_stat.st_uid);
+}
+
+// Removes the files published for other versions of the library: the same
+// dev and inode with another mtime (which is also what a new file that
+// reused the inode looks like). Nothing would ever use or remove them.
+static void remove_stale_shared_relros(const soinfo* si) {
+  char prefix[64];
+  char current[96];
+  int prefix_len = __libc_format_buffer(prefix, sizeof(prefix), "%" PRIx64 "_%" PRIx64 "_",
+                                        static_cast<uint64_t>(si->get_st_dev()),
+                                        static_cast<uint64_t>(si->get_st_ino()));
+  int current_len = __libc_format_buffer(current, sizeof(current), "%s%" PRIx64 "_", prefix,
+                                         static_cast<uint64_t>(si->get_st_mtime()));
+
+  ScopedReaddir dir(kSharedRelroDir);
+  if (dir.IsBad()) {
+    return;
+  }
+
+  dirent* e;
+  while ((e = dir.ReadEntry()) != nullptr) {
+    if (strncmp(e->d_name, prefix, prefix_len) != 0 ||
+        strncmp(e->d_name, current, current_len) == 0) {
+      continue;
+    }
+
+    char path[PATH_MAX];
+    int n = __libc_format_buffer(path, sizeof(path), "%s/%s", kSharedRelroDir, e->d_name);
+    if (n > 0 && n < static_cast<int>(sizeof(path)) && unlink(path) == 0) {
+      TRACE("[ removed stale shared RELRO \"%s\" ]", path);
+    }
+  }
+}
+
+// Implements ANDROID_DLEXT_USE_SHARED_RELRO: maps the GNU RELRO pages
+// published by an earlier process that loaded the same file at the same
+// address over our relocated ones or, if there is nothing to map yet,
+// publishes ours. This is an optimization only: failures leave the
+// private relocated pages in place and do not fail the load.
+static void share_gnu_relro(soinfo* si) {
+  if (si->get_st_dev() == 0 && si->get_st_ino() == 0) {
+    return;
+  }
+
+  char path[PATH_MAX];
+  if (!make_shared_relro_path(si, path, sizeof(path), "")) {
+    return;
+  }
+
+  int fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+  if (fd != -1) {
+    if (!is_trusted_shared_relro(fd)) {
+      DL_WARN("\"%s\": ignoring untrusted shared RELRO file \"%s\"", si->get_realpath(), path);
+    } else if (phdr_table_map_gnu_relro(si->phdr, si->phnum, si->load_bias, fd) < 0) {
+      DEBUG("%s: failed mapping shared RELRO \"%s\": %s", si->get_realpath(), path,
+            strerror(errno));
+    } else {
+      TRACE("[ mapped shared RELRO \"%s\" for \"%s\" ]", path, si->get_realpath());
+    }
+    close(fd);
+    return;
+  }
+
+  if (errno != ENOENT) {
+    return;
+  }
+
+  // Write to a temporary file and rename it, so that other processes
+  // never see a partially written one.
+  char tmp_path[PATH_MAX];
+  char suffix[32];
+  __libc_format_buffer(suffix, sizeof(suffix), ".%d", getpid());
+  if (!make_shared_relro_path(si, tmp_path, sizeof(tmp_path), suffix)) {
+    return;
+  }
+
+  fd = TEMP_FAILURE_RETRY(open(tmp_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644));
+  if (fd == -1) {
+    DEBUG("%s: unable to create shared RELRO \"%s\": %s", si->get_realpath(), tmp_path,
+          strerror(errno));
+    return;
+  }
+
+  bool published =
+      phdr_table_serialize_gnu_relro(si->phdr, si->phnum, si->load_bias, fd) == 0 &&
+      rename(tmp_path, path) == 0;
+  close(fd);
+
+  if (!published) {
+    DEBUG("%s: unable to publish shared RELRO \"%s\": %s", si->get_realpath(), path,
+          strerror(errno));
+    unlink(tmp_path);
+    return;
+  }
+
+  TRACE("[ published shared RELRO \"%s\" for \"%s\" ]", path, si->get_realpath());
+
+  // A new file is published once per version of the library, which is
+  // when the files of the previous version become stale.
+  remove_stale_shared_relros(si);
+}
+
 bool soinfo::link_image(const soinfo_list_t& global_group, const soinfo_list_t& local_group,
                         const android_dlextinfo* extinfo) {
+  uint64_t link_start_ns = LoadProfile::now_ns();
+  auto profile_guard = make_scope_guard([&]() {
+    if (load_profile_ != nullptr) {
+      load_profile_->link_ns += LoadProfile::now_ns() - link_start_ns;
+    }
+  });
 
   local_group_root_ = local_group.front();
   if (local_group_root_ == nullptr) {
@@ -2993,31 +3882,77 @@ bool soinfo::link_image(const soinfo_list_t& global_group, const soinfo_list_t&
   }
 #endif
 
+  // The linker relocates itself before any of this is set up.
+  SymbolResolutionCache symbol_cache(this, global_group, local_group);
+  SymbolResolutionCache* symbol_cache_ptr =
+      ((flags_ & FLAG_LINKER) == 0 && symbol_cache.is_enabled()) ? &symbol_cache : nullptr;
+
+#if !defined(__mips__)
+  if (can_bind_lazily()) {
+    flags_ |= FLAG_LAZY_BIND;
+  }
+#endif
+
   if (android_relocs_ != nullptr) {
+    const uint8_t* packed_relocs = nullptr;
+    size_t packed_relocs_size = 0;
+
     // check signature
     if (android_relocs_size_ > 3 &&
         android_relocs_[0] == 'A' &&
         android_relocs_[1] == 'P' &&
         android_relocs_[2] == 'S' &&
         android_relocs_[3] == '2') {
-      DEBUG("[ android relocating %s ]", get_realpath());
+      packed_relocs = android_relocs_ + 4;
+      packed_relocs_size = android_relocs_size_ - 4;
+    } else if (android_relocs_size_ >= 2 * sizeof(ElfW(Addr)) &&
+               (reinterpret_cast<uintptr_t>(android_relocs_) % sizeof(ElfW(Addr))) == 0 &&
+               android_relocs_[0] == 'A' &&
+               android_relocs_[1] == 'P' &&
+               android_relocs_[2] == 'R' &&
+               android_relocs_[3] == '1') {
+      // The header word is followed by the number of bitmap encoded words,
+      // the words, and optionally an 'APS2' stream with the other relocations.
+      const ElfW(Addr)* relr = reinterpret_cast<const ElfW(Addr)*>(android_relocs_) + 1;
+      const size_t relr_count = *relr++;
+      if (relr_count > android_relocs_size_ / sizeof(ElfW(Addr)) - 2) {
+        DL_ERR("\"%s\" has bad android relocation bitmap size: %zd", get_realpath(), relr_count);
+        return false;
+      }
 
-      bool relocated = false;
-      const uint8_t* packed_relocs = android_relocs_ + 4;
-      const size_t packed_relocs_size = android_relocs_size_ - 4;
+      DEBUG("[ android relocating %s relative ]", get_realpath());
+      if (!relocate_relr(relr, relr + relr_count)) {
+        return false;
+      }
+
+      // Anything else is padding left by the packer.
+      const uint8_t* rest = reinterpret_cast<const uint8_t*>(relr + relr_count);
+      const size_t rest_size = android_relocs_size_ - (rest - android_relocs_);
+      if (rest_size > 3 &&
+          rest[0] == 'A' &&
+          rest[1] == 'P' &&
+          rest[2] == 'S' &&
+          rest[3] == '2') {
+        packed_relocs = rest + 4;
+        packed_relocs_size = rest_size - 4;
+      }
+    } else {
+      DL_ERR("bad android relocation header.");
+      return false;
+    }
 
-      relocated = relocate(
+    if (packed_relocs != nullptr) {
+      DEBUG("[ android relocating %s ]", get_realpath());
+
+      bool relocated = relocate(
           version_tracker,
           packed_reloc_iterator<sleb128_decoder>(
             sleb128_decoder(packed_relocs, packed_relocs_size)),
-          global_group, local_group);
+          global_group, local_group, symbol_cache_ptr);
 
       if (!relocated) {
         return false;
       }
-    } else {
-      DL_ERR("bad android relocation header.");
-      return false;
     }
   }
 
@@ -3025,14 +3960,16 @@ bool soinfo::link_image(const soinfo_list_t& global_group, const soinfo_list_t&
   if (rela_ != nullptr) {
     DEBUG("[ relocating %s ]", get_realpath());
     if (!relocate(version_tracker,
-            plain_reloc_iterator(rela_, rela_count_), global_group, local_group)) {
+            plain_reloc_iterator(rela_, rela_count_), global_group, local_group,
+            symbol_cache_ptr)) {
       return false;
     }
   }
-  if (plt_rela_ != nullptr) {
+  if (plt_rela_ != nullptr && (flags_ & FLAG_LAZY_BIND) == 0) {
     DEBUG("[ relocating %s plt ]", get_realpath());
     if (!relocate(version_tracker,
-            plain_reloc_iterator(plt_rela_, plt_rela_count_), global_group, local_group)) {
+            plain_reloc_iterator(plt_rela_, plt_rela_count_), global_group, local_group,
+            symbol_cache_ptr)) {
       return false;
     }
   }
@@ -3040,14 +3977,25 @@ bool soinfo::link_image(const soinfo_list_t& global_group, const soinfo_list_t&
   if (rel_ != nullptr) {
     DEBUG("[ relocating %s ]", get_realpath());
     if (!relocate(version_tracker,
-            plain_reloc_iterator(rel_, rel_count_), global_group, local_group)) {
+            plain_reloc_iterator(rel_, rel_count_), global_group, local_group,
+            symbol_cache_ptr)) {
       return false;
     }
   }
-  if (plt_rel_ != nullptr) {
+  if (plt_rel_ != nullptr && (flags_ & FLAG_LAZY_BIND) == 0) {
     DEBUG("[ relocating %s plt ]", get_realpath());
     if (!relocate(version_tracker,
-            plain_reloc_iterator(plt_rel_, plt_rel_count_), global_group, local_group)) {
+            plain_reloc_iterator(plt_rel_, plt_rel_count_), global_group, local_group,
+            symbol_cache_ptr)) {
+      return false;
+    }
+  }
+#endif
+
+#if !defined(__mips__)
+  if ((flags_ & FLAG_LAZY_BIND) != 0) {
+    DEBUG("[ preparing %s plt for lazy binding ]", get_realpath());
+    if (!prepare_lazy_plt(version_tracker, global_group, local_group, symbol_cache_ptr)) {
       return false;
     }
   }
@@ -3059,6 +4007,10 @@ bool soinfo::link_image(const soinfo_list_t& global_group, const soinfo_list_t&
   }
 #endif
 
+  if (symbol_cache_ptr != nullptr) {
+    symbol_cache_ptr->save();
+  }
+
   DEBUG("[ finished linking %s ]", get_realpath());
 
 #if !defined(__LP64__)
@@ -3094,6 +4046,10 @@ bool soinfo::link_image(const soinfo_list_t& global_group, const soinfo_list_t&
              get_realpath(), strerror(errno));
       return false;
     }
+  } else if (extinfo && (extinfo->flags & ANDROID_DLEXT_USE_SHARED_RELRO) &&
+             local_group_root_ == this) {
+    // Only the root library is loaded at the reserved address.
+    share_gnu_relro(this);
   }
 
   notify_gdb_of_load(this);
@@ -3121,6 +4077,7 @@ static void add_vdso(KernelArgumentBlock& args __unused) {
   si->load_bias = get_elf_exec_load_bias(ehdr_vdso);
 
   si->prelink_image();
+  SoinfoRegistry::add(si);
   si->link_image(g_empty_list, soinfo::soinfo_list_t::make_list(si), nullptr);
 #endif
 }
@@ -3128,12 +4085,6 @@ static void add_vdso(KernelArgumentBlock& args __unused) {
 /*
  * This is linker soinfo for GDB. See details below.
  */
-#if defined(__LP64__)
-#define LINKER_PATH "/system/bin/linker64"
-#else
-#define LINKER_PATH "/system/bin/linker"
-#endif
-
 // This is done to avoid calling c-tor prematurely
 // because soinfo c-tor needs memory allocator
 // which might be initialized after global variables.
@@ -3206,11 +4157,22 @@ static ElfW(Addr) __linker_init_post_relocation(KernelArgumentBlock& args, ElfW(
   // doesn't cost us anything.
   const char* ldpath_env = nullptr;
   const char* ldpreload_env = nullptr;
+  const char* ld_symbol_cache_dir_env = nullptr;
+  const char* ld_load_profile_env = nullptr;
+  // LD_BIND_NOW can only make binding stricter, so it is honored even
+  // for AT_SECURE processes.
+  const char* ld_bind_now_env = getenv("LD_BIND_NOW");
+  g_ld_bind_now = ld_bind_now_env != nullptr && *ld_bind_now_env != '\0';
   if (!getauxval(AT_SECURE)) {
     ldpath_env = getenv("LD_LIBRARY_PATH");
     ldpreload_env = getenv("LD_PRELOAD");
+    ld_symbol_cache_dir_env = getenv("LD_SYMBOL_CACHE_DIR");
+    ld_load_profile_env = getenv("LD_LOAD_PROFILE");
   }
 
+  // Before the first soinfo is allocated, so that every library gets a profile entry.
+  LoadProfile::init(ld_load_profile_env);
+
   INFO("[ android linker & debugger ]");
 
   soinfo* si = soinfo_alloc(args.argv[0], nullptr, 0, RTLD_GLOBAL);
@@ -3262,6 +4224,7 @@ static ElfW(Addr) __linker_init_post_relocation(KernelArgumentBlock& args, ElfW(
   // Use LD_LIBRARY_PATH and LD_PRELOAD (but only if we aren't setuid/setgid).
   parse_LD_LIBRARY_PATH(ldpath_env);
   parse_LD_PRELOAD(ldpreload_env);
+  SymbolResolutionCache::set_cache_dir(ld_symbol_cache_dir_env);
 
   somain = si;
 
@@ -3272,6 +4235,10 @@ static ElfW(Addr) __linker_init_post_relocation(KernelArgumentBlock& args, ElfW(
     exit(EXIT_FAILURE);
   }
 
+  // libdl.so is first in solist.
+  SoinfoRegistry::add(solist);
+  SoinfoRegistry::add(si);
+
   // add somain to global group
   si->set_dt_flags_1(si->get_dt_flags_1() | DF_1_GLOBAL);
 
@@ -3311,20 +4278,23 @@ static ElfW(Addr) __linker_init_post_relocation(KernelArgumentBlock& args, ElfW(
 
   add_vdso(args);
 
+  /* After the prelink_image, the si->load_bias is initialized.
+   * For so lib, the map->l_addr will be updated in notify_gdb_of_load.
+   * We need to update this value for so exe here. So Unwind_Backtrace
+   * for some arch like x86 could work correctly within so exe.
+   */
+  map->l_addr = si->load_bias;
+  publish_solist();
+
   {
     ProtectedDataGuard guard;
 
     si->call_pre_init_constructors();
-
-    /* After the prelink_image, the si->load_bias is initialized.
-     * For so lib, the map->l_addr will be updated in notify_gdb_of_load.
-     * We need to update this value for so exe here. So Unwind_Backtrace
-     * for some arch like x86 could work correctly within so exe.
-     */
-    map->l_addr = si->load_bias;
     si->call_constructors();
   }
 
+  LoadProfile::report();
+
 #if TIMING
   gettimeofday(&t1, nullptr);
   PRINT("LINKER TIME: %s: %d microseconds", args.argv[0], (int) (
@@ -91,16 +91,24 @@
 #define FLAG_EXE        0x00000004 // The main executable
 #define FLAG_LINKER     0x00000010 // The linker itself
 #define FLAG_GNU_HASH   0x00000040 // uses gnu hash
+#define FLAG_LAZY_BIND  0x00000080 // PLT entries are resolved on first call
+#define FLAG_UNLOADING  0x00000100 // Picked for unloading by the dlclose in progress
 #define FLAG_NEW_SOINFO 0x40000000 // new soinfo format
 
 #define SUPPORTED_DT_FLAGS_1 (DF_1_NOW | DF_1_GLOBAL | DF_1_NODELETE)
 
-#define SOINFO_VERSION 2
+#define SOINFO_VERSION 4
 
 #if defined(__work_around_b_19059885__)
 #define SOINFO_NAME_LEN 128
 #endif
 
+#if defined(__LP64__)
+#define LINKER_PATH "/system/bin/linker64"
+#else
+#define LINKER_PATH "/system/bin/linker"
+#endif
+
 typedef void (*linker_function_t)();
 
 // Android uses RELA for aarch64 and x86_64. mips64 still uses REL.
@@ -109,6 +117,9 @@ typedef void (*linker_function_t)();
 #endif
 
 struct soinfo;
+struct LoadProfileEntry;
+struct LazyBindScope;
+class SymbolResolutionCache;
 
 class SoinfoListAllocator {
  public:
@@ -206,11 +217,9 @@ struct soinfo {
   uint32_t* bucket_;
   uint32_t* chain_;
 
-#if defined(__mips__) || !defined(__LP64__)
-  // This is only used by mips and mips64, but needs to be here for
-  // all 32-bit architectures to preserve binary compatibility.
+  // DT_PLTGOT: used by mips and mips64 for the GOT relocation and by the
+  // other architectures for lazy binding.
   ElfW(Addr)** plt_got_;
-#endif
 
 #if defined(USE_RELA)
   ElfW(Rela)* plt_rela_;
@@ -269,6 +278,7 @@ struct soinfo {
 
  public:
   soinfo(const char* name, const struct stat* file_stat, off64_t file_offset, int rtld_flags);
+  ~soinfo();
 
   void call_constructors();
   void call_destructors();
@@ -282,7 +292,9 @@ struct soinfo {
 
   ino_t get_st_ino() const;
   dev_t get_st_dev() const;
+  time_t get_st_mtime() const;
   off64_t get_file_offset() const;
+  LoadProfileEntry* get_load_profile() const;
 
   uint32_t get_rtld_flags() const;
   uint32_t get_dt_flags_1() const;
@@ -303,6 +315,8 @@ struct soinfo {
   const char* get_string(ElfW(Word) index) const;
   bool can_unload() const;
   bool is_gnu_hash() const;
+  size_t get_symbol_count() const;
+  const ElfW(Sym)* get_symbol(size_t index) const { return symtab_ + index; }
 
   bool inline has_min_version(uint32_t min_version __unused) const {
 #if defined(__work_around_b_19059885__)
@@ -314,8 +328,10 @@ struct soinfo {
 
   bool is_linked() const;
   bool is_main_executable() const;
+  bool is_unloading() const;
 
   void set_linked();
+  void set_unloading();
   void set_linker_flag();
   void set_main_executable();
 
@@ -333,6 +349,13 @@ struct soinfo {
   size_t get_verdef_cnt() const;
 
   bool find_verdef_version_index(const version_info* vi, ElfW(Versym)* versym) const;
+  // True if the definition at symbol_index satisfies the version
+  // requirement vi the same way gnu_lookup() and elf_lookup() check it.
+  bool is_symbol_version_acceptable(uint32_t symbol_index, const version_info* vi) const;
+
+#if !defined(__mips__)
+  bool bind_plt_slot(size_t reloc_index, ElfW(Addr)* target);
+#endif
 
   uint32_t get_target_sdk_version() const;
 
@@ -349,7 +372,16 @@ struct soinfo {
   void call_function(const char* function_name, linker_function_t function);
   template<typename ElfRelIteratorT>
   bool relocate(const VersionTracker& version_tracker, ElfRelIteratorT&& rel_iterator,
-                const soinfo_list_t& global_group, const soinfo_list_t& local_group);
+                const soinfo_list_t& global_group, const soinfo_list_t& local_group,
+                SymbolResolutionCache* symbol_cache);
+  bool relocate_relr(const ElfW(Addr)* begin, const ElfW(Addr)* end);
+  // Lazy binding is not supported on mips.
+#if !defined(__mips__)
+  bool can_bind_lazily() const;
+  bool prepare_lazy_plt(const VersionTracker& version_tracker,
+                        const soinfo_list_t& global_group, const soinfo_list_t& local_group,
+                        SymbolResolutionCache* symbol_cache);
+#endif
 
  private:
   // This part of the structure is only available
@@ -397,6 +429,15 @@ struct soinfo {
 
   uint32_t target_sdk_version_;
 
+  // version >= 3
+  time_t st_mtime_;
+
+  // version >= 4
+  LoadProfileEntry* load_profile_;
+
+  // What bind_plt_slot() looks symbols up in, built on first use.
+  LazyBindScope* lazy_bind_scope_;
+
   friend soinfo* get_libdl_info();
 };
 
@@ -421,12 +462,18 @@ void do_android_update_LD_LIBRARY_PATH(const char* ld_library_path);
 soinfo* do_dlopen(const char* name, int flags, const android_dlextinfo* extinfo);
 void do_dlclose(soinfo* si);
 
+#if !defined(__mips__)
+bool do_bind_plt_slot(soinfo* si, size_t reloc_index, ElfW(Addr)* target);
+#endif
+
 int do_dl_iterate_phdr(int (*cb)(dl_phdr_info* info, size_t size, void* data), void* data);
 
 const ElfW(Sym)* dlsym_linear_lookup(const char* name, soinfo** found, soinfo* caller, void* handle);
 soinfo* find_containing_library(const void* addr);
 
 const ElfW(Sym)* dlsym_handle_lookup(soinfo* si, soinfo** found, const char* name);
+void dlsym_handle_lookup_many(soinfo* si, size_t count, const char* const names[],
+                              soinfo* found[], const ElfW(Sym)* syms[]);
 
 void debuggerd_init();
 extern "C" abort_msg_t* g_abort_message;
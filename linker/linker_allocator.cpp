@@ -17,9 +17,6 @@
 #include "linker_allocator.h"
 #include "linker.h"
 
-#include <algorithm>
-#include <vector>
-
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -41,8 +38,11 @@
 // For a pointer allocated using proxy-to-mmap allocator unmaps
 // the memory.
 //
-// For a pointer allocated using SmallObjectAllocator it adds
-// the block to free_blocks_list_. If the number of free pages reaches 2,
+// For a pointer allocated using SmallObjectAllocator it puts the block
+// in the magazine, where the next alloc() of the same size takes it
+// from. When the magazine is full half of it goes back to the free
+// lists of the pages the blocks belong to; the page header is found
+// from the address of the block. If the number of free pages reaches 2,
 // SmallObjectAllocator munmaps one of the pages keeping the other one
 // in reserve.
 
@@ -53,9 +53,9 @@ static const size_t kSmallObjectMaxSize = 1 << kSmallObjectMaxSizeLog2;
 // This type is used for large allocations (with size >1k)
 static const uint32_t kLargeObject = 111;
 
-bool operator<(const small_object_page_record& one, const small_object_page_record& two) {
-  return one.page_addr < two.page_addr;
-}
+// The blocks of a small object page start after the header,
+// at an offset that keeps them 16-byte aligned.
+static const size_t kSmallObjectPageHeaderSize = (sizeof(small_object_page_info) + 15) & ~15;
 
 static inline uint16_t log2(size_t number) {
   uint16_t result = 0;
@@ -70,122 +70,142 @@ static inline uint16_t log2(size_t number) {
 }
 
 LinkerSmallObjectAllocator::LinkerSmallObjectAllocator()
-    : type_(0), name_(nullptr), block_size_(0), free_pages_cnt_(0), free_blocks_list_(nullptr) {}
+    : type_(0), name_(nullptr), block_size_(0), blocks_per_page_(0), free_pages_cnt_(0),
+      page_list_(nullptr), magazine_capacity_(0), magazine_cnt_(0) {}
 
 void* LinkerSmallObjectAllocator::alloc() {
-  if (free_blocks_list_ == nullptr) {
+  void* ptr;
+  if (magazine_cnt_ > 0) {
+    ptr = magazine_[--magazine_cnt_];
+  } else {
+    ptr = alloc_from_page();
+  }
+
+  memset(ptr, 0, block_size_);
+  return ptr;
+}
+
+void LinkerSmallObjectAllocator::free(void* ptr) {
+  uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) % PAGE_SIZE;
+
+  if (offset < kSmallObjectPageHeaderSize ||
+      (offset - kSmallObjectPageHeaderSize) % block_size_ != 0) {
+    __libc_fatal("invalid pointer: %p (block_size=%zd)", ptr, block_size_);
+  }
+
+  if (magazine_cnt_ == magazine_capacity_) {
+    flush_magazine();
+  }
+
+  magazine_[magazine_cnt_++] = ptr;
+}
+
+void LinkerSmallObjectAllocator::flush_magazine() {
+  // Return the older half, the blocks freed last are the likeliest
+  // to still be in the cache.
+  size_t flush_cnt = (magazine_cnt_ + 1) / 2;
+  for (size_t i = 0; i < flush_cnt; ++i) {
+    free_to_page(magazine_[i]);
+  }
+
+  memmove(magazine_, magazine_ + flush_cnt, (magazine_cnt_ - flush_cnt) * sizeof(void*));
+  magazine_cnt_ -= flush_cnt;
+}
+
+void* LinkerSmallObjectAllocator::alloc_from_page() {
+  if (page_list_ == nullptr) {
     alloc_page();
   }
 
-  small_object_block_record* block_record = free_blocks_list_;
+  small_object_page_info* page = page_list_;
+  small_object_block_record* block_record = page->free_blocks_list;
   if (block_record->free_blocks_cnt > 1) {
     small_object_block_record* next_free = reinterpret_cast<small_object_block_record*>(
         reinterpret_cast<uint8_t*>(block_record) + block_size_);
     next_free->next = block_record->next;
     next_free->free_blocks_cnt = block_record->free_blocks_cnt - 1;
-    free_blocks_list_ = next_free;
+    page->free_blocks_list = next_free;
   } else {
-    free_blocks_list_ = block_record->next;
+    page->free_blocks_list = block_record->next;
   }
 
-  // bookkeeping...
-  auto page_record = find_page_record(block_record);
-
-  if (page_record->allocated_blocks_cnt == 0) {
+  if (page->allocated_blocks_cnt == 0) {
     free_pages_cnt_--;
   }
 
-  page_record->free_blocks_cnt--;
-  page_record->allocated_blocks_cnt++;
+  page->free_blocks_cnt--;
+  page->allocated_blocks_cnt++;
 
-  memset(block_record, 0, block_size_);
+  if (page->free_blocks_cnt == 0) {
+    remove_from_page_list(page);
+  }
 
   return block_record;
 }
 
-void LinkerSmallObjectAllocator::free_page(linker_vector_t::iterator page_record) {
-  void* page_start = reinterpret_cast<void*>(page_record->page_addr);
-  void* page_end = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(page_start) + PAGE_SIZE);
+void LinkerSmallObjectAllocator::free_to_page(void* ptr) {
+  small_object_page_info* page =
+      reinterpret_cast<small_object_page_info*>(PAGE_START(reinterpret_cast<uintptr_t>(ptr)));
 
-  while (free_blocks_list_ != nullptr &&
-      free_blocks_list_ > page_start &&
-      free_blocks_list_ < page_end) {
-    free_blocks_list_ = free_blocks_list_->next;
-  }
+  small_object_block_record* block_record = reinterpret_cast<small_object_block_record*>(ptr);
+  block_record->next = page->free_blocks_list;
+  block_record->free_blocks_cnt = 1;
+  page->free_blocks_list = block_record;
 
-  small_object_block_record* current = free_blocks_list_;
+  if (page->free_blocks_cnt++ == 0) {
+    add_to_page_list(page);
+  }
+  page->allocated_blocks_cnt--;
 
-  while (current != nullptr) {
-    while (current->next > page_start && current->next < page_end) {
-      current->next = current->next->next;
+  if (page->allocated_blocks_cnt == 0) {
+    if (free_pages_cnt_ > 0) {
+      // if we already have a free page - unmap this one.
+      free_page(page);
+    } else {
+      free_pages_cnt_++;
     }
-
-    current = current->next;
   }
-
-  munmap(page_start, PAGE_SIZE);
-  page_records_.erase(page_record);
-  free_pages_cnt_--;
 }
 
-void LinkerSmallObjectAllocator::free(void* ptr) {
-  auto page_record = find_page_record(ptr);
-
-  ssize_t offset = reinterpret_cast<uintptr_t>(ptr) - sizeof(page_info);
+void LinkerSmallObjectAllocator::free_page(small_object_page_info* page) {
+  // All the blocks of the page are on its own free list,
+  // so there is nothing else to unlink.
+  remove_from_page_list(page);
+  munmap(page, PAGE_SIZE);
+}
 
-  if (offset % block_size_ != 0) {
-    __libc_fatal("invalid pointer: %p (block_size=%zd)", ptr, block_size_);
+void LinkerSmallObjectAllocator::add_to_page_list(small_object_page_info* page) {
+  page->prev_page = nullptr;
+  page->next_page = page_list_;
+  if (page_list_ != nullptr) {
+    page_list_->prev_page = page;
   }
+  page_list_ = page;
+}
 
-  memset(ptr, 0, block_size_);
-  small_object_block_record* block_record = reinterpret_cast<small_object_block_record*>(ptr);
-
-  block_record->next = free_blocks_list_;
-  block_record->free_blocks_cnt = 1;
-
-  free_blocks_list_ = block_record;
-
-  page_record->free_blocks_cnt++;
-  page_record->allocated_blocks_cnt--;
+void LinkerSmallObjectAllocator::remove_from_page_list(small_object_page_info* page) {
+  if (page->prev_page != nullptr) {
+    page->prev_page->next_page = page->next_page;
+  } else {
+    page_list_ = page->next_page;
+  }
 
-  if (page_record->allocated_blocks_cnt == 0) {
-    if (free_pages_cnt_++ > 1) {
-      // if we already have a free page - unmap this one.
-      free_page(page_record);
-    }
+  if (page->next_page != nullptr) {
+    page->next_page->prev_page = page->prev_page;
   }
+
+  page->prev_page = nullptr;
+  page->next_page = nullptr;
 }
 
 void LinkerSmallObjectAllocator::init(uint32_t type, size_t block_size, const char* name) {
   type_ = type;
   block_size_ = block_size;
   name_ = name;
-}
-
-linker_vector_t::iterator LinkerSmallObjectAllocator::find_page_record(void* ptr) {
-  void* addr = reinterpret_cast<void*>(PAGE_START(reinterpret_cast<uintptr_t>(ptr)));
-  small_object_page_record boundary;
-  boundary.page_addr = addr;
-  linker_vector_t::iterator it = std::lower_bound(
-      page_records_.begin(), page_records_.end(), boundary);
-
-  if (it == page_records_.end() || it->page_addr != addr) {
-    // not found...
-    __libc_fatal("page record for %p was not found (block_size=%zd)", ptr, block_size_);
-  }
-
-  return it;
-}
-
-void LinkerSmallObjectAllocator::create_page_record(void* page_addr, size_t free_blocks_cnt) {
-  small_object_page_record record;
-  record.page_addr = page_addr;
-  record.free_blocks_cnt = free_blocks_cnt;
-  record.allocated_blocks_cnt = 0;
-
-  linker_vector_t::iterator it = std::lower_bound(
-      page_records_.begin(), page_records_.end(), record);
-  page_records_.insert(it, record);
+  blocks_per_page_ = (PAGE_SIZE - kSmallObjectPageHeaderSize)/block_size_;
+  // Never keep more than a page worth of blocks in the magazine.
+  magazine_capacity_ = blocks_per_page_ < kSmallObjectMagazineSize ?
+      blocks_per_page_ : kSmallObjectMagazineSize;
 }
 
 void LinkerSmallObjectAllocator::alloc_page() {
@@ -199,21 +219,22 @@ void LinkerSmallObjectAllocator::alloc_page() {
 
   memset(map_ptr, 0, PAGE_SIZE);
 
-  page_info* info = reinterpret_cast<page_info*>(map_ptr);
-  memcpy(info->signature, kSignature, sizeof(kSignature));
-  info->type = type_;
-  info->allocator_addr = this;
-
-  size_t free_blocks_cnt = (PAGE_SIZE - sizeof(page_info))/block_size_;
-
-  create_page_record(map_ptr, free_blocks_cnt);
+  small_object_page_info* page = reinterpret_cast<small_object_page_info*>(map_ptr);
+  memcpy(page->info.signature, kSignature, sizeof(kSignature));
+  page->info.type = type_;
+  page->info.allocator_addr = this;
 
-  small_object_block_record* first_block = reinterpret_cast<small_object_block_record*>(info + 1);
+  small_object_block_record* first_block = reinterpret_cast<small_object_block_record*>(
+      reinterpret_cast<uint8_t*>(map_ptr) + kSmallObjectPageHeaderSize);
+  first_block->next = nullptr;
+  first_block->free_blocks_cnt = blocks_per_page_;
 
-  first_block->next = free_blocks_list_;
-  first_block->free_blocks_cnt = free_blocks_cnt;
+  page->free_blocks_list = first_block;
+  page->free_blocks_cnt = blocks_per_page_;
+  page->allocated_blocks_cnt = 0;
 
-  free_blocks_list_ = first_block;
+  add_to_page_list(page);
+  free_pages_cnt_++;
 }
 
 
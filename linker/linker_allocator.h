@@ -23,8 +23,6 @@
 #include <stddef.h>
 #include <unistd.h>
 
-#include <vector>
-
 #include "private/bionic_prctl.h"
 #include "private/libc_logging.h"
 
@@ -47,56 +45,30 @@ struct page_info {
   };
 };
 
-struct small_object_page_record {
-  void* page_addr;
-  size_t free_blocks_cnt;
-  size_t allocated_blocks_cnt;
-};
-
-// for lower_bound...
-bool operator<(const small_object_page_record& one, const small_object_page_record& two);
-
 struct small_object_block_record {
   small_object_block_record* next;
   size_t free_blocks_cnt;
 };
 
-// This is implementation for std::vector allocator
-template <typename T>
-class linker_vector_allocator {
- public:
-  typedef T value_type;
-  typedef T* pointer;
-  typedef const T* const_pointer;
-  typedef T& reference;
-  typedef const T& const_reference;
-  typedef size_t size_type;
-  typedef ptrdiff_t difference_type;
-
-  T* allocate(size_t n, const T* hint = nullptr) {
-    size_t size = n * sizeof(T);
-    void* ptr = mmap(const_cast<T*>(hint), size,
-        PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, 0, 0);
-    if (ptr == MAP_FAILED) {
-      // Spec says we need to throw std::bad_alloc here but because our
-      // code does not support exception handling anyways - we are going to abort.
-      __libc_fatal("mmap failed");
-    }
-
-    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, ptr, size, "linker_alloc_vector");
-
-    return reinterpret_cast<T*>(ptr);
-  }
-
-  void deallocate(T* ptr, size_t n) {
-    munmap(ptr, n * sizeof(T));
-  }
-};
+// The header of the pages of the small object allocators. It starts with
+// the page_info, and keeps the bookkeeping of the page so that free() can
+// find it from the address of the block.
+struct small_object_page_info {
+  page_info info;
 
-typedef
-    std::vector<small_object_page_record, linker_vector_allocator<small_object_page_record>>
-    linker_vector_t;
+  // List of the pages that have free blocks.
+  small_object_page_info* next_page;
+  small_object_page_info* prev_page;
 
+  small_object_block_record* free_blocks_list;
+
+  size_t free_blocks_cnt;
+  size_t allocated_blocks_cnt;
+};
+
+// Recently freed blocks are kept in a magazine and handed out again
+// without touching the page bookkeeping.
+const size_t kSmallObjectMagazineSize = 16;
 
 class LinkerSmallObjectAllocator {
  public:
@@ -107,20 +79,26 @@ class LinkerSmallObjectAllocator {
 
   size_t get_block_size() const { return block_size_; }
  private:
+  void* alloc_from_page();
+  void free_to_page(void* ptr);
+  void flush_magazine();
+
   void alloc_page();
-  void free_page(linker_vector_t::iterator page_record);
-  linker_vector_t::iterator find_page_record(void* ptr);
-  void create_page_record(void* page_addr, size_t free_blocks_cnt);
+  void free_page(small_object_page_info* page);
+  void add_to_page_list(small_object_page_info* page);
+  void remove_from_page_list(small_object_page_info* page);
 
   uint32_t type_;
   const char* name_;
   size_t block_size_;
+  size_t blocks_per_page_;
 
   size_t free_pages_cnt_;
-  small_object_block_record* free_blocks_list_;
+  small_object_page_info* page_list_;
 
-  // sorted vector of page records
-  linker_vector_t page_records_;
+  size_t magazine_capacity_;
+  size_t magazine_cnt_;
+  void* magazine_[kSmallObjectMagazineSize];
 };
 
 class LinkerMemoryAllocator {
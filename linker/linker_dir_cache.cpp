@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker_dir_cache.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "linker_debug.h"
+#include "linker_gnu_hash.h"
+#include "private/ScopedReaddir.h"
+
+struct dir_listing {
+  struct entry {
+    uint32_t hash;
+    uint32_t name_offset;
+  };
+
+  std::string path;
+  // False if the directory could not be read (for example because it is
+  // searchable but not readable); nothing is known about its contents.
+  bool listed;
+  // True once the listing has been checked against the directory in the
+  // current search.
+  bool checked;
+  // The directory the listing was read from. A directory modified in the
+  // same second it was listed may be modified again without its mtime
+  // changing, so such a listing is never trusted for long.
+  struct stat dir_stat;
+  bool racy;
+
+  // All the names, NUL-terminated, and the entries sorted by hash.
+  std::string names;
+  std::vector<entry> entries;
+
+  void list();
+  bool is_current() const;
+  bool contains(const char* name) const;
+};
+
+void dir_listing::list() {
+  names.clear();
+  entries.clear();
+  listed = false;
+  checked = true;
+  racy = true;
+
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  if (TEMP_FAILURE_RETRY(stat(path.c_str(), &dir_stat)) != 0) {
+    return;
+  }
+  racy = dir_stat.st_mtime >= now.tv_sec - 1;
+
+  ScopedReaddir dir(path.c_str());
+  if (dir.IsBad()) {
+    return;
+  }
+
+  dirent* e;
+  while ((e = dir.ReadEntry()) != nullptr) {
+    entry new_entry;
+    new_entry.hash = calculate_gnu_hash(e->d_name);
+    new_entry.name_offset = names.size();
+    names.append(e->d_name, strlen(e->d_name) + 1);
+    entries.push_back(new_entry);
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) {
+    return a.hash < b.hash;
+  });
+
+  listed = true;
+  TRACE("[ listed search directory \"%s\": %zd entries ]", path.c_str(), entries.size());
+}
+
+bool dir_listing::is_current() const {
+  if (racy) {
+    return false;
+  }
+
+  struct stat current;
+  return TEMP_FAILURE_RETRY(stat(path.c_str(), &current)) == 0 &&
+         current.st_dev == dir_stat.st_dev &&
+         current.st_ino == dir_stat.st_ino &&
+         current.st_mtim.tv_sec == dir_stat.st_mtim.tv_sec &&
+         current.st_mtim.tv_nsec == dir_stat.st_mtim.tv_nsec;
+}
+
+bool dir_listing::contains(const char* name) const {
+  uint32_t hash = calculate_gnu_hash(name);
+  auto it = std::lower_bound(entries.begin(), entries.end(), hash,
+                             [](const entry& e, uint32_t h) {
+    return e.hash < h;
+  });
+
+  for (; it != entries.end() && it->hash == hash; ++it) {
+    if (strcmp(names.c_str() + it->name_offset, name) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static std::vector<dir_listing*> g_dir_listings;
+
+bool SearchDirCache::may_contain(const char* dir, const char* name) {
+  dir_listing* listing = nullptr;
+  for (dir_listing* candidate : g_dir_listings) {
+    if (candidate->path == dir) {
+      listing = candidate;
+      break;
+    }
+  }
+
+  if (listing == nullptr) {
+    listing = new dir_listing();
+    listing->path = dir;
+    listing->list();
+    g_dir_listings.push_back(listing);
+  } else if (!listing->checked) {
+    if (!listing->is_current()) {
+      listing->list();
+    }
+    listing->checked = true;
+  }
+
+  return !listing->listed || listing->contains(name);
+}
+
+void SearchDirCache::begin_search() {
+  for (dir_listing* listing : g_dir_listings) {
+    listing->checked = false;
+  }
+}
+
+void SearchDirCache::clear() {
+  for (dir_listing* listing : g_dir_listings) {
+    delete listing;
+  }
+  g_dir_listings.clear();
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINKER_DIR_CACHE_H
+#define __LINKER_DIR_CACHE_H
+
+#include "private/bionic_macros.h"
+
+// Cache of the contents of the library search directories (LD_LIBRARY_PATH
+// and the default paths), so that looking for a library costs one open()
+// in the directory that has it instead of one failing open() in every
+// directory searched before it.
+//
+// Each directory is listed on its first use. A listing is only trusted
+// while the directory's mtime is unchanged, which is checked once per
+// search (see begin_search), so a library installed since the listing was
+// read is still found in search order.
+class SearchDirCache {
+ public:
+  // Returns false if dir is known not to contain name. Returns true if it
+  // does, or if dir cannot be listed (it may still be searchable).
+  static bool may_contain(const char* dir, const char* name);
+
+  // Makes the next use of each listing check that its directory hasn't
+  // changed first. Called once per dlopen(), so that loading a library
+  // with many dependencies stat()s each directory only once.
+  static void begin_search();
+
+  // Forgets all the listings, so that they are read again on their next use.
+  static void clear();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SearchDirCache);
+};
+
+#endif  // __LINKER_DIR_CACHE_H
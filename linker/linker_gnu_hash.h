@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LINKER_GNU_HASH_H
+#define __LINKER_GNU_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The GNU hash is h = h * 33 + c over the bytes of the name. Every step
+// depends on the previous one, so instead of vector instructions (which
+// would also need runtime cpu feature checks the linker does not have) the
+// loop is unrolled by four: h * 33^4 + c0 * 33^3 + c1 * 33^2 + c2 * 33 + c3
+// has the multiplications of the four bytes independent of each other.
+//
+// This is kept in a header so that benchmarks/ can measure it.
+static inline uint32_t calculate_gnu_hash(const char* name) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(name);
+  uint32_t h = 5381;
+
+  // Never read past the terminating NUL: the name may end at a page boundary.
+  while (p[0] != 0 && p[1] != 0 && p[2] != 0 && p[3] != 0) {
+    h = h * (33 * 33 * 33 * 33) +
+        p[0] * (33 * 33 * 33) +
+        p[1] * (33 * 33) +
+        p[2] * 33 +
+        p[3];
+    p += 4;
+  }
+
+  while (*p != 0) {
+    h += (h << 5) + *p++; // h*33 + c = h + h * 32 + c = h + h << 5 + c
+  }
+
+  return h;
+}
+
+// DT_GNU_HASH doesn't record the number of symbols: it's one past the end
+// of the chain of the last non-empty bucket. chain is indexed by symbol
+// index, so it starts symndx entries before the real chain array.
+static inline size_t gnu_hash_symbol_count(const uint32_t* bucket, size_t nbucket,
+                                           const uint32_t* chain) {
+  uint32_t last = 0;
+  for (size_t i = 0; i < nbucket; ++i) {
+    if (bucket[i] > last) {
+      last = bucket[i];
+    }
+  }
+  if (last == 0) {
+    return 0;
+  }
+  while ((chain[last] & 1) == 0) {
+    ++last;
+  }
+  return last + 1;
+}
+
+#endif  // __LINKER_GNU_HASH_H
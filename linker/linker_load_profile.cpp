@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker_load_profile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "linker_debug.h"
+
+bool LoadProfile::enabled_ = false;
+
+static std::string g_load_profile_path;
+static bool g_load_profile_to_log = false;
+static std::vector<LoadProfileEntry*> g_load_profile_entries;
+
+void LoadProfile::init(const char* output) {
+  if (output == nullptr || *output == '\0') {
+    return;
+  }
+
+  if (strcmp(output, "logcat") == 0) {
+    g_load_profile_to_log = true;
+  } else {
+    g_load_profile_path = output;
+  }
+
+  enabled_ = true;
+}
+
+LoadProfileEntry* LoadProfile::create_entry(const char* realpath) {
+  if (!enabled_) {
+    return nullptr;
+  }
+
+  LoadProfileEntry* entry = new LoadProfileEntry(realpath);
+  g_load_profile_entries.push_back(entry);
+  return entry;
+}
+
+uint64_t LoadProfile::now_ns() {
+  if (!enabled_) {
+    return 0;
+  }
+
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+static const char* const kLoadProfileHeader =
+    "library open_us load_us prelink_us link_us constructors_us "
+    "relocations lookups cached_lookups found_in not_found_in";
+
+#define LOAD_PROFILE_FORMAT \
+    "%s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %zd %zd %zd %zd %zd"
+
+#define LOAD_PROFILE_ARGS(e) \
+    (e)->realpath.c_str(), (e)->open_ns / 1000, (e)->load_ns / 1000, (e)->prelink_ns / 1000, \
+    (e)->link_ns / 1000, (e)->constructors_ns / 1000, (e)->relocations, (e)->lookups, \
+    (e)->cached_lookups, (e)->found_in, (e)->not_found_in
+
+void LoadProfile::report() {
+  if (!enabled_) {
+    return;
+  }
+
+  if (g_load_profile_to_log) {
+    static bool header_logged = false;
+    if (!header_logged) {
+      __libc_format_log(ANDROID_LOG_INFO, "linker", "%s", kLoadProfileHeader);
+      header_logged = true;
+    }
+
+    // The log is append-only, so only report each library once; the
+    // numbers of a library that is still being searched keep growing
+    // after that, the file report always has the current ones.
+    for (LoadProfileEntry* entry : g_load_profile_entries) {
+      if (!entry->reported) {
+        __libc_format_log(ANDROID_LOG_INFO, "linker", LOAD_PROFILE_FORMAT,
+                          LOAD_PROFILE_ARGS(entry));
+        entry->reported = true;
+      }
+    }
+    return;
+  }
+
+  // The pid is that of the process writing the report, so that a forked
+  // child has a report of its own rather than overwriting its parent's.
+  char path[PATH_MAX];
+  int n = __libc_format_buffer(path, sizeof(path), "%s.%d", g_load_profile_path.c_str(), getpid());
+  if (n < 0 || n >= static_cast<int>(sizeof(path))) {
+    return;
+  }
+
+  int fd = TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+  if (fd == -1) {
+    DEBUG("unable to write load profile \"%s\": %s", path, strerror(errno));
+    return;
+  }
+
+  __libc_format_fd(fd, "# %s\n", kLoadProfileHeader);
+  for (LoadProfileEntry* entry : g_load_profile_entries) {
+    __libc_format_fd(fd, LOAD_PROFILE_FORMAT "\n", LOAD_PROFILE_ARGS(entry));
+    entry->reported = true;
+  }
+
+  close(fd);
+}
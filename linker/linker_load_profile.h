@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINKER_LOAD_PROFILE_H
+#define __LINKER_LOAD_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "private/bionic_macros.h"
+
+// Where the time went while loading one library. Entries are never freed,
+// so libraries that have been unloaded are still reported.
+struct LoadProfileEntry {
+  explicit LoadProfileEntry(const char* realpath)
+      : realpath(realpath), open_ns(0), load_ns(0), prelink_ns(0), link_ns(0),
+        constructors_ns(0), relocations(0), lookups(0), cached_lookups(0), found_in(0),
+        not_found_in(0), reported(false) {}
+
+  std::string realpath;
+
+  // open(), reading the headers and mapping the segments.
+  uint64_t open_ns;
+  uint64_t load_ns;
+  uint64_t prelink_ns;
+  // Relocation, including the symbol lookups it needs.
+  uint64_t link_ns;
+  // DT_INIT and DT_INIT_ARRAY of this library only.
+  uint64_t constructors_ns;
+
+  size_t relocations;
+  // Symbol lookups done on behalf of this library...
+  size_t lookups;
+  // Relocations resolved from the symbol resolution cache instead.
+  size_t cached_lookups;
+  // ...and the searches of this library's symbol table done on
+  // behalf of anyone, by whether the symbol was there or not.
+  size_t found_in;
+  size_t not_found_in;
+
+  bool reported;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadProfileEntry);
+};
+
+// Per-library load time profile. It is enabled by setting LD_LOAD_PROFILE
+// to a file name (the pid of the process writing the report is appended to
+// it) or to "logcat" (and the process is not AT_SECURE). The report is
+// refreshed every time the linker finishes loading a group of libraries: at
+// startup and after each dlopen().
+class LoadProfile {
+ public:
+  static void init(const char* output);
+
+  static bool is_enabled() {
+    return enabled_;
+  }
+
+  // Returns a new entry, or nullptr if profiling is disabled.
+  static LoadProfileEntry* create_entry(const char* realpath);
+
+  // Returns CLOCK_MONOTONIC in nanoseconds, or 0 if profiling is disabled
+  // (so that the callers do not pay for the clock_gettime calls).
+  static uint64_t now_ns();
+
+  static void report();
+
+ private:
+  static bool enabled_;
+};
+
+#endif  // __LINKER_LOAD_PROFILE_H
@@ -28,26 +28,31 @@
 
 #include "linker.h"
 #include "linker_debug.h"
+#include "linker_load_profile.h"
 #include "linker_relocs.h"
 #include "linker_reloc_iterators.h"
 #include "linker_sleb128.h"
+#include "linker_symbol_cache.h"
 
 template bool soinfo::relocate<plain_reloc_iterator>(const VersionTracker& version_tracker,
                                                      plain_reloc_iterator&& rel_iterator,
                                                      const soinfo_list_t& global_group,
-                                                     const soinfo_list_t& local_group);
+                                                     const soinfo_list_t& local_group,
+                                                     SymbolResolutionCache* symbol_cache);
 
 template bool soinfo::relocate<packed_reloc_iterator<sleb128_decoder>>(
     const VersionTracker& version_tracker,
     packed_reloc_iterator<sleb128_decoder>&& rel_iterator,
     const soinfo_list_t& global_group,
-    const soinfo_list_t& local_group);
+    const soinfo_list_t& local_group,
+    SymbolResolutionCache* symbol_cache);
 
 template <typename ElfRelIteratorT>
 bool soinfo::relocate(const VersionTracker& version_tracker,
                       ElfRelIteratorT&& rel_iterator,
                       const soinfo_list_t& global_group,
-                      const soinfo_list_t& local_group) {
+                      const soinfo_list_t& local_group,
+                      SymbolResolutionCache* symbol_cache) {
   for (size_t idx = 0; rel_iterator.has_next(); ++idx) {
     const auto rel = rel_iterator.next();
 
@@ -55,6 +60,10 @@ bool soinfo::relocate(const VersionTracker& version_tracker,
       return false;
     }
 
+    if (load_profile_ != nullptr) {
+      ++load_profile_->relocations;
+    }
+
     ElfW(Word) type = ELFW(R_TYPE)(rel->r_info);
     ElfW(Word) sym = ELFW(R_SYM)(rel->r_info);
 
@@ -72,14 +81,26 @@ bool soinfo::relocate(const VersionTracker& version_tracker,
 
     if (sym != 0) {
       sym_name = get_string(symtab_[sym].st_name);
+
       const version_info* vi = nullptr;
 
       if (!lookup_version_info(version_tracker, sym, sym_name, &vi)) {
         return false;
       }
 
-      if (!soinfo_do_lookup(this, sym_name, vi, &lsi, global_group, local_group, &s)) {
-        return false;
+      if (symbol_cache != nullptr && symbol_cache->lookup(sym, sym_name, vi, &lsi, &s)) {
+        if (load_profile_ != nullptr) {
+          ++load_profile_->cached_lookups;
+        }
+      } else {
+        if (!soinfo_do_lookup(this, sym_name, vi, &lsi, global_group, local_group, &s)) {
+          return false;
+        }
+
+        if (symbol_cache != nullptr) {
+          symbol_cache->record(sym, s == nullptr ? nullptr : lsi,
+                               s == nullptr ? 0 : s - lsi->symtab_);
+        }
       }
 
       if (s == nullptr) {
@@ -133,6 +133,9 @@ static int GetTargetElfMachine() {
                                       MAYBE_MAP_FLAG((x), PF_R, PROT_READ) | \
                                       MAYBE_MAP_FLAG((x), PF_W, PROT_WRITE))
 
+// Size of a transparent huge page (a PMD mapping with 4K pages).
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
 ElfReader::ElfReader(const char* name, int fd, off64_t file_offset, off64_t file_size)
     : name_(name), fd_(fd), file_offset_(file_offset), file_size_(file_size),
       phdr_num_(0), phdr_mmap_(nullptr), phdr_table_(nullptr), phdr_size_(0),
@@ -147,12 +150,19 @@ ElfReader::~ElfReader() {
 }
 
 bool ElfReader::Load(const android_dlextinfo* extinfo) {
-  return ReadElfHeader() &&
-         VerifyElfHeader() &&
-         ReadProgramHeader() &&
-         ReserveAddressSpace(extinfo) &&
-         LoadSegments() &&
-         FindPhdr();
+  if (!(ReadElfHeader() &&
+        VerifyElfHeader() &&
+        ReadProgramHeader() &&
+        ReserveAddressSpace(extinfo) &&
+        LoadSegments(extinfo) &&
+        FindPhdr())) {
+    return false;
+  }
+
+  if (extinfo != nullptr && (extinfo->flags & ANDROID_DLEXT_HUGE_PAGE_TEXT) != 0) {
+    RemapTextOnHugePages();
+  }
+  return true;
 }
 
 bool ElfReader::ReadElfHeader() {
@@ -338,12 +348,36 @@ bool ElfReader::ReserveAddressSpace(const android_dlextinfo* extinfo) {
              reserved_size - load_size_, load_size_, name_);
       return false;
     }
+    // To be able to put the text on huge pages, its pages have to be at the
+    // same offsets from a huge page boundary in memory as in the file.
+    size_t alignment = PAGE_SIZE;
+    if (extinfo != nullptr && (extinfo->flags & ANDROID_DLEXT_HUGE_PAGE_TEXT) != 0 &&
+        mmap_hint == nullptr && load_size_ >= kHugePageSize) {
+      alignment = kHugePageSize;
+    }
+
+    size_t mmap_size = load_size_ + alignment - PAGE_SIZE;
     int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
-    start = mmap(mmap_hint, load_size_, PROT_NONE, mmap_flags, -1, 0);
+    start = mmap(mmap_hint, mmap_size, PROT_NONE, mmap_flags, -1, 0);
     if (start == MAP_FAILED) {
       DL_ERR("couldn't reserve %zd bytes of address space for \"%s\"", load_size_, name_);
       return false;
     }
+
+    if (alignment != PAGE_SIZE) {
+      // Give back the unaligned head and the unused tail of the reservation.
+      uint8_t* mmap_start = reinterpret_cast<uint8_t*>(start);
+      uint8_t* aligned_start = reinterpret_cast<uint8_t*>(
+          BIONIC_ALIGN(reinterpret_cast<uintptr_t>(start), alignment));
+      if (aligned_start != mmap_start) {
+        munmap(mmap_start, aligned_start - mmap_start);
+      }
+      size_t tail_size = (mmap_start + mmap_size) - (aligned_start + load_size_);
+      if (tail_size != 0) {
+        munmap(aligned_start + load_size_, tail_size);
+      }
+      start = aligned_start;
+    }
   } else {
     start = extinfo->reserved_addr;
   }
@@ -353,7 +387,73 @@ bool ElfReader::ReserveAddressSpace(const android_dlextinfo* extinfo) {
   return true;
 }
 
-bool ElfReader::LoadSegments() {
+// Replaces the huge page aligned parts of the text segments (which are
+// file mappings and therefore always use small pages) with anonymous copies
+// on transparent huge pages to reduce iTLB misses. The copies are private to
+// the process and no longer backed by the file, so this trades memory for
+// speed; it is only worth it for large, hot libraries. This is best effort:
+// the file mapping is kept wherever anything fails.
+void ElfReader::RemapTextOnHugePages() {
+  for (size_t i = 0; i < phdr_num_; ++i) {
+    const ElfW(Phdr)* phdr = &phdr_table_[i];
+
+    if (phdr->p_type != PT_LOAD || (phdr->p_flags & PF_X) == 0 || (phdr->p_flags & PF_W) != 0) {
+      continue;
+    }
+
+    ElfW(Addr) seg_start = phdr->p_vaddr + load_bias_;
+    ElfW(Addr) seg_file_end = seg_start + phdr->p_filesz;
+
+    ElfW(Addr) huge_start = BIONIC_ALIGN(seg_start, kHugePageSize);
+    ElfW(Addr) huge_end = seg_file_end & ~(kHugePageSize - 1);
+    if (huge_start >= huge_end) {
+      continue;
+    }
+    size_t size = huge_end - huge_start;
+
+    // The copy has to be huge page aligned too, so that mremap() can move
+    // the huge pages instead of splitting them.
+    void* map = mmap(nullptr, size + kHugePageSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+      DEBUG("\"%s\": couldn't allocate huge page text copy: %s", name_, strerror(errno));
+      continue;
+    }
+
+    uint8_t* map_start = reinterpret_cast<uint8_t*>(map);
+    uint8_t* copy = reinterpret_cast<uint8_t*>(
+        BIONIC_ALIGN(reinterpret_cast<uintptr_t>(map), kHugePageSize));
+    if (copy != map_start) {
+      munmap(map_start, copy - map_start);
+    }
+    munmap(copy + size, (map_start + size + kHugePageSize) - (copy + size));
+
+    if (madvise(copy, size, MADV_HUGEPAGE) != 0) {
+      DEBUG("\"%s\": transparent huge pages are not available: %s", name_, strerror(errno));
+      munmap(copy, size);
+      return;
+    }
+
+    memcpy(copy, reinterpret_cast<void*>(huge_start), size);
+
+    if (mprotect(copy, size, PFLAGS_TO_PROT(phdr->p_flags)) != 0 ||
+        mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED,
+               reinterpret_cast<void*>(huge_start)) == MAP_FAILED) {
+      DEBUG("\"%s\": couldn't remap text segment %zd on huge pages: %s",
+            name_, i, strerror(errno));
+      munmap(copy, size);
+      continue;
+    }
+
+    TRACE("[ \"%s\": text segment %zd: %zd bytes at %p remapped on huge pages ]",
+          name_, i, size, reinterpret_cast<void*>(huge_start));
+  }
+}
+
+bool ElfReader::LoadSegments(const android_dlextinfo* extinfo) {
+  bool readahead = extinfo != nullptr &&
+      (extinfo->flags & ANDROID_DLEXT_READAHEAD_SEGMENTS) != 0;
+
   for (size_t i = 0; i < phdr_num_; ++i) {
     const ElfW(Phdr)* phdr = &phdr_table_[i];
 
@@ -402,6 +502,15 @@ bool ElfReader::LoadSegments() {
         DL_ERR("couldn't map \"%s\" segment %zd: %s", name_, i, strerror(errno));
         return false;
       }
+
+      // Start reading the segment into the page cache in the background, so
+      // that the page faults that follow don't each wait for a small read.
+      // This only reads the file: nothing is faulted into the mapping, and a
+      // page of a writable segment still only gets a private copy once it is
+      // written to. It is only a hint, so failures are ignored.
+      if (readahead) {
+        madvise(seg_addr, file_length, MADV_WILLNEED);
+      }
     }
 
     // if the segment is writable, and does not end on a page boundary,
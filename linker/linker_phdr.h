@@ -55,7 +55,8 @@ class ElfReader {
   bool VerifyElfHeader();
   bool ReadProgramHeader();
   bool ReserveAddressSpace(const android_dlextinfo* extinfo);
-  bool LoadSegments();
+  bool LoadSegments(const android_dlextinfo* extinfo);
+  void RemapTextOnHugePages();
   bool FindPhdr();
   bool CheckPhdr(ElfW(Addr));
 
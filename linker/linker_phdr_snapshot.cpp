@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker_phdr_snapshot.h"
+
+#include <sched.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct phdr_snapshot {
+  struct library {
+    dl_phdr_info info;
+    ElfW(Addr) base;
+    size_t size;
+#if defined(__arm__)
+    _Unwind_Ptr exidx;
+    int exidx_count;
+#endif
+  };
+
+  uint64_t adds;
+  uint64_t subs;
+  std::vector<library> libraries;
+  // The libraries with a mapping, sorted by base address.
+  std::vector<const library*> by_address;
+  // The dlpi_phdr and dlpi_name of the libraries point in here.
+  std::vector<ElfW(Phdr)> phdrs;
+  std::string names;
+};
+
+static std::atomic<phdr_snapshot*> g_phdr_snapshot(nullptr);
+
+// Readers announce themselves in the counter of the current epoch, see
+// ScopedPhdrSnapshotReader. A reader counted in the current epoch may be
+// using any snapshot retired since the epoch began; a reader counted in the
+// previous one may also be using the snapshots retired during that one.
+static std::atomic<uint32_t> g_phdr_snapshot_epoch(0);
+static std::atomic<size_t> g_phdr_snapshot_readers[2];
+
+// Snapshots replaced during the current epoch, and during the previous one.
+// Only touched with the lock held.
+static std::vector<phdr_snapshot*> g_retired_phdr_snapshots;
+static std::vector<phdr_snapshot*> g_expiring_phdr_snapshots;
+
+static void free_phdr_snapshots(std::vector<phdr_snapshot*>* snapshots) {
+  for (phdr_snapshot* snapshot : *snapshots) {
+    delete snapshot;
+  }
+  snapshots->clear();
+}
+
+void PhdrSnapshot::publish(const soinfo* solist, uint64_t adds, uint64_t subs) {
+  phdr_snapshot* snapshot = new phdr_snapshot();
+  snapshot->adds = adds;
+  snapshot->subs = subs;
+
+  // Size everything first: the pointers into phdrs and names
+  // must not be invalidated by a reallocation.
+  size_t library_count = 0;
+  size_t phdr_count = 0;
+  size_t names_size = 0;
+  for (const soinfo* si = solist; si != nullptr; si = si->next) {
+    ++library_count;
+    phdr_count += si->phnum;
+    if (si->link_map_head.l_name != nullptr) {
+      names_size += strlen(si->link_map_head.l_name) + 1;
+    }
+  }
+
+  snapshot->libraries.reserve(library_count);
+  snapshot->phdrs.reserve(phdr_count);
+  snapshot->names.reserve(names_size);
+
+  for (const soinfo* si = solist; si != nullptr; si = si->next) {
+    phdr_snapshot::library library;
+    library.info.dlpi_addr = si->link_map_head.l_addr;
+    library.info.dlpi_name = nullptr;
+    if (si->link_map_head.l_name != nullptr) {
+      library.info.dlpi_name = snapshot->names.data() + snapshot->names.size();
+      snapshot->names.append(si->link_map_head.l_name, strlen(si->link_map_head.l_name) + 1);
+    }
+    library.info.dlpi_phdr = nullptr;
+    if (si->phnum != 0) {
+      library.info.dlpi_phdr = snapshot->phdrs.data() + snapshot->phdrs.size();
+      snapshot->phdrs.insert(snapshot->phdrs.end(), si->phdr, si->phdr + si->phnum);
+    }
+    library.info.dlpi_phnum = si->phnum;
+    library.info.dlpi_adds = adds;
+    library.info.dlpi_subs = subs;
+    library.base = si->base;
+    library.size = si->size;
+#if defined(__arm__)
+    library.exidx = reinterpret_cast<_Unwind_Ptr>(si->ARM_exidx);
+    library.exidx_count = static_cast<int>(si->ARM_exidx_count);
+#endif
+    snapshot->libraries.push_back(library);
+  }
+
+  for (const phdr_snapshot::library& library : snapshot->libraries) {
+    if (library.size != 0) {
+      snapshot->by_address.push_back(&library);
+    }
+  }
+  std::sort(snapshot->by_address.begin(), snapshot->by_address.end(),
+            [](const phdr_snapshot::library* a, const phdr_snapshot::library* b) {
+    return a->base < b->base;
+  });
+
+  phdr_snapshot* old_snapshot = g_phdr_snapshot.exchange(snapshot);
+  if (old_snapshot != nullptr) {
+    g_retired_phdr_snapshots.push_back(old_snapshot);
+  }
+
+  // Once the previous epoch's readers are gone, nothing retired before the
+  // current epoch began can be in use. If the current epoch has no readers
+  // either, nothing retired at all can be: a reader that has not announced
+  // itself yet is going to see the new snapshot. Otherwise start a new
+  // epoch, so that the current readers can drain while new readers are
+  // counted separately. Readers that keep coming never hold a snapshot back
+  // for longer than the readers that were there when it was replaced.
+  uint32_t epoch = g_phdr_snapshot_epoch.load();
+  if (g_phdr_snapshot_readers[(epoch + 1) & 1].load() == 0) {
+    free_phdr_snapshots(&g_expiring_phdr_snapshots);
+    if (g_phdr_snapshot_readers[epoch & 1].load() == 0) {
+      free_phdr_snapshots(&g_retired_phdr_snapshots);
+    } else {
+      g_expiring_phdr_snapshots.swap(g_retired_phdr_snapshots);
+      g_phdr_snapshot_epoch.store(epoch + 1);
+    }
+  }
+}
+
+void PhdrSnapshot::wait_for_readers() {
+  // The previous epoch's readers first: nobody joins them anymore. Then
+  // count newcomers in the other counter, and wait for the current ones.
+  uint32_t epoch = g_phdr_snapshot_epoch.load();
+  while (g_phdr_snapshot_readers[(epoch + 1) & 1].load() != 0) {
+    sched_yield();
+  }
+  g_phdr_snapshot_epoch.store(epoch + 1);
+  while (g_phdr_snapshot_readers[epoch & 1].load() != 0) {
+    sched_yield();
+  }
+
+  free_phdr_snapshots(&g_expiring_phdr_snapshots);
+  free_phdr_snapshots(&g_retired_phdr_snapshots);
+}
+
+bool PhdrSnapshot::is_current(uint64_t adds, uint64_t subs) {
+  phdr_snapshot* snapshot = g_phdr_snapshot.load();
+  return snapshot != nullptr && snapshot->adds == adds && snapshot->subs == subs;
+}
+
+class ScopedPhdrSnapshotReader {
+ public:
+  ScopedPhdrSnapshotReader() {
+    // If publish() has started a new epoch in the meantime, it may already
+    // have seen this reader's counter drained, so announce again.
+    while (true) {
+      epoch_ = g_phdr_snapshot_epoch.load();
+      g_phdr_snapshot_readers[epoch_ & 1].fetch_add(1);
+      if (g_phdr_snapshot_epoch.load() == epoch_) {
+        break;
+      }
+      g_phdr_snapshot_readers[epoch_ & 1].fetch_sub(1, std::memory_order_release);
+    }
+    snapshot_ = g_phdr_snapshot.load();
+  }
+
+  ~ScopedPhdrSnapshotReader() {
+    g_phdr_snapshot_readers[epoch_ & 1].fetch_sub(1, std::memory_order_release);
+  }
+
+  const phdr_snapshot* get() const {
+    return snapshot_;
+  }
+
+ private:
+  uint32_t epoch_;
+  const phdr_snapshot* snapshot_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedPhdrSnapshotReader);
+};
+
+int PhdrSnapshot::iterate(int (*cb)(dl_phdr_info* info, size_t size, void* data), void* data) {
+  ScopedPhdrSnapshotReader reader;
+  const phdr_snapshot* snapshot = reader.get();
+  if (snapshot == nullptr) {
+    return 0;
+  }
+
+  int rv = 0;
+  for (const phdr_snapshot::library& library : snapshot->libraries) {
+    // The callback gets its own copy, it is allowed to scribble on it.
+    dl_phdr_info dl_info = library.info;
+    rv = cb(&dl_info, sizeof(dl_phdr_info), data);
+    if (rv != 0) {
+      break;
+    }
+  }
+  return rv;
+}
+
+#if defined(__arm__)
+_Unwind_Ptr PhdrSnapshot::find_exidx(_Unwind_Ptr pc, int* pcount) {
+  ScopedPhdrSnapshotReader reader;
+  const phdr_snapshot* snapshot = reader.get();
+
+  ElfW(Addr) addr = reinterpret_cast<ElfW(Addr)>(pc);
+  if (snapshot != nullptr) {
+    // The last library that starts at or below the address.
+    auto it = std::upper_bound(snapshot->by_address.begin(), snapshot->by_address.end(), addr,
+                               [](ElfW(Addr) a, const phdr_snapshot::library* library) {
+      return a < library->base;
+    });
+
+    if (it != snapshot->by_address.begin()) {
+      const phdr_snapshot::library* library = *--it;
+      if (addr - library->base < library->size) {
+        *pcount = library->exidx_count;
+        return library->exidx;
+      }
+    }
+  }
+
+  *pcount = 0;
+  return nullptr;
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINKER_PHDR_SNAPSHOT_H
+#define __LINKER_PHDR_SNAPSHOT_H
+
+#include <link.h>
+#include <stdint.h>
+
+#include "linker.h"
+#include "private/bionic_macros.h"
+
+// A read-only copy of what dl_iterate_phdr() reports about the loaded
+// libraries, so that unwinders can walk it without taking the dlfcn lock.
+//
+// The linker publishes a new snapshot (with the lock held) whenever solist
+// has changed. Readers only announce themselves in the counter of the
+// current epoch; a replaced snapshot is freed by a later publish once the
+// readers of the epoch it was replaced in are gone, even if other readers
+// keep coming.
+// Program headers and names are copied into the snapshot, but a callback
+// is free to read the library's own memory through them (PT_DYNAMIC,
+// PT_GNU_EH_FRAME, the exidx table), so libraries are only unmapped after
+// wait_for_readers(). A dl_iterate_phdr() callback must therefore not
+// dlclose() a library itself.
+class PhdrSnapshot {
+ public:
+  // Replaces the current snapshot with the contents of 'solist'.
+  // 'adds' and 'subs' are reported as dlpi_adds and dlpi_subs.
+  static void publish(const soinfo* solist, uint64_t adds, uint64_t subs);
+
+  // Returns true if the current snapshot was made with these counters.
+  static bool is_current(uint64_t adds, uint64_t subs);
+
+  // Waits until no reader can be using a snapshot replaced before this call,
+  // and frees those snapshots. Readers that arrive meanwhile don't hold it up.
+  static void wait_for_readers();
+
+  static int iterate(int (*cb)(dl_phdr_info* info, size_t size, void* data), void* data);
+
+#if defined(__arm__)
+  static _Unwind_Ptr find_exidx(_Unwind_Ptr pc, int* pcount);
+#endif
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(PhdrSnapshot);
+};
+
+#endif  // __LINKER_PHDR_SNAPSHOT_H
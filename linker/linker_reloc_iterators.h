@@ -18,6 +18,7 @@
 #define __LINKER_RELOC_ITERATORS_H
 
 #include "linker.h"
+#include "linker_relocs.h"
 
 #include <string.h>
 
@@ -26,6 +27,31 @@ const size_t RELOCATION_GROUPED_BY_OFFSET_DELTA_FLAG = 2;
 const size_t RELOCATION_GROUPED_BY_ADDEND_FLAG = 4;
 const size_t RELOCATION_GROUP_HAS_ADDEND_FLAG = 8;
 
+// Shorter runs of relative relocations are not worth looking ahead for.
+const size_t kMinRelativeRelocationRun = 4;
+
+// Adds load_bias to count consecutive words, the way R_GENERIC_RELATIVE
+// does when the addend is stored in place, a vector at a time.
+static inline void apply_relative_relocation_run(ElfW(Addr)* where, size_t count,
+                                                 ElfW(Addr) load_bias) {
+  typedef ElfW(Addr) addr_vector_t
+      __attribute__((vector_size(16), aligned(sizeof(ElfW(Addr))), may_alias));
+  const size_t lanes = sizeof(addr_vector_t) / sizeof(ElfW(Addr));
+
+  addr_vector_t bias = {};
+  bias += load_bias;
+
+  size_t i = 0;
+  for (; i + 2 * lanes <= count; i += 2 * lanes) {
+    addr_vector_t* v = reinterpret_cast<addr_vector_t*>(where + i);
+    v[0] += bias;
+    v[1] += bias;
+  }
+  for (; i < count; ++i) {
+    where[i] += load_bias;
+  }
+}
+
 class plain_reloc_iterator {
 #if defined(USE_RELA)
   typedef ElfW(Rela) rel_t;
@@ -43,6 +69,39 @@ class plain_reloc_iterator {
   rel_t* next() {
     return current_++;
   }
+
+#if !defined(__mips__)
+  // If the next relocations are a run of R_GENERIC_RELATIVE relocations of
+  // consecutive words, applies them and returns how many there were.
+  // Otherwise returns 0 and leaves the iterator where it was.
+  size_t apply_relative_run(ElfW(Addr) load_bias) {
+    rel_t* run_end = current_;
+    ElfW(Addr) offset = current_->r_offset;
+    while (run_end < end_ && run_end->r_info == ELFW(R_INFO)(0, R_GENERIC_RELATIVE) &&
+           run_end->r_offset == offset) {
+      ++run_end;
+      offset += sizeof(ElfW(Addr));
+    }
+
+    size_t count = run_end - current_;
+    if (count < kMinRelativeRelocationRun) {
+      return 0;
+    }
+
+#if defined(USE_RELA)
+    ElfW(Addr)* where = reinterpret_cast<ElfW(Addr)*>(load_bias + current_->r_offset);
+    for (size_t i = 0; i < count; ++i) {
+      where[i] = load_bias + current_[i].r_addend;
+    }
+#else
+    apply_relative_relocation_run(reinterpret_cast<ElfW(Addr)*>(load_bias + current_->r_offset),
+                                  count, load_bias);
+#endif
+    current_ = run_end;
+    return count;
+  }
+#endif
+
  private:
   rel_t* const begin_;
   rel_t* const end_;
@@ -106,6 +165,52 @@ class packed_reloc_iterator {
 
     return &reloc_;
   }
+
+#if !defined(__mips__)
+  // If the rest of the current group is a run of R_GENERIC_RELATIVE
+  // relocations of consecutive words, applies them and returns how many
+  // there were. Otherwise returns 0 and leaves the iterator where it was.
+  // The first relocation of each group always goes through next().
+  size_t apply_relative_run(ElfW(Addr) load_bias) {
+    if (relocation_group_index_ == group_size_ ||
+        !is_relocation_grouped_by_info() ||
+        reloc_.r_info != ELFW(R_INFO)(0, R_GENERIC_RELATIVE) ||
+        !is_relocation_grouped_by_offset_delta() ||
+        group_r_offset_delta_ != sizeof(ElfW(Addr))) {
+      return 0;
+    }
+
+    size_t count = group_size_ - relocation_group_index_;
+    if (count > relocation_count_ - relocation_index_) {
+      count = relocation_count_ - relocation_index_;
+    }
+    if (count < kMinRelativeRelocationRun) {
+      return 0;
+    }
+
+    ElfW(Addr)* where = reinterpret_cast<ElfW(Addr)*>(load_bias + reloc_.r_offset) + 1;
+#if defined(USE_RELA)
+    if (is_relocation_group_has_addend() && !is_relocation_grouped_by_addend()) {
+      for (size_t i = 0; i < count; ++i) {
+        reloc_.r_addend += decoder_.pop_front();
+        where[i] = load_bias + reloc_.r_addend;
+      }
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        where[i] = load_bias + reloc_.r_addend;
+      }
+    }
+#else
+    apply_relative_relocation_run(where, count, load_bias);
+#endif
+
+    reloc_.r_offset += count * sizeof(ElfW(Addr));
+    relocation_index_ += count;
+    relocation_group_index_ += count;
+    return count;
+  }
+#endif
+
  private:
   bool read_group_fields() {
     group_size_ = decoder_.pop_front();
@@ -119,18 +224,21 @@ class packed_reloc_iterator {
       reloc_.r_info = decoder_.pop_front();
     }
 
-    if (is_relocation_group_has_addend() &&
-        is_relocation_grouped_by_addend()) {
 #if !defined(USE_RELA)
-      // This platform does not support rela, and yet we have it encoded in android_rel section.
+    // This platform does not support rela, and yet we have it encoded in android_rel
+    // section. Any addend (grouped or per relocation) would desynchronize the stream.
+    if (is_relocation_group_has_addend()) {
       DL_ERR("unexpected r_addend in android.rel section");
       return false;
+    }
 #else
+    if (is_relocation_group_has_addend() &&
+        is_relocation_grouped_by_addend()) {
       reloc_.r_addend += decoder_.pop_front();
     } else if (!is_relocation_group_has_addend()) {
       reloc_.r_addend = 0;
-#endif
     }
+#endif
 
     relocation_group_index_ = 0;
     return true;
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker_soinfo_registry.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+struct file_key {
+  dev_t dev;
+  ino_t ino;
+  off64_t file_offset;
+
+  bool operator==(const file_key& that) const {
+    return dev == that.dev && ino == that.ino && file_offset == that.file_offset;
+  }
+};
+
+struct file_key_hash {
+  size_t operator()(const file_key& key) const {
+    size_t h = static_cast<size_t>(key.ino);
+    h = h * 31 + static_cast<size_t>(key.dev);
+    h = h * 31 + static_cast<size_t>(key.file_offset);
+    return h;
+  }
+};
+
+static std::unordered_map<std::string, std::vector<soinfo*>> g_soinfos_by_soname;
+static std::unordered_map<file_key, std::vector<soinfo*>, file_key_hash> g_soinfos_by_file;
+// Sorted by base address; the mappings never overlap.
+static std::vector<soinfo*> g_soinfos_by_address;
+
+static bool get_file_key(const soinfo* si, file_key* key) {
+  key->dev = si->get_st_dev();
+  key->ino = si->get_st_ino();
+  key->file_offset = si->get_file_offset();
+  return key->dev != 0 && key->ino != 0;
+}
+
+template<typename Map, typename Key>
+static void remove_from(Map* map, const Key& key, soinfo* si) {
+  auto it = map->find(key);
+  if (it == map->end()) {
+    return;
+  }
+
+  std::vector<soinfo*>& soinfos = it->second;
+  soinfos.erase(std::remove(soinfos.begin(), soinfos.end(), si), soinfos.end());
+  if (soinfos.empty()) {
+    map->erase(it);
+  }
+}
+
+static bool base_less(const soinfo* a, const soinfo* b) {
+  return a->base < b->base;
+}
+
+void SoinfoRegistry::add(soinfo* si) {
+  const char* soname = si->get_soname();
+  if (soname != nullptr) {
+    g_soinfos_by_soname[soname].push_back(si);
+  }
+
+  file_key key;
+  if (get_file_key(si, &key)) {
+    g_soinfos_by_file[key].push_back(si);
+  }
+
+  if (si->size != 0) {
+    auto it = std::upper_bound(g_soinfos_by_address.begin(), g_soinfos_by_address.end(), si,
+                               base_less);
+    g_soinfos_by_address.insert(it, si);
+  }
+}
+
+void SoinfoRegistry::remove(soinfo* si) {
+  const char* soname = si->get_soname();
+  if (soname != nullptr) {
+    remove_from(&g_soinfos_by_soname, std::string(soname), si);
+  }
+
+  file_key key;
+  if (get_file_key(si, &key)) {
+    remove_from(&g_soinfos_by_file, key, si);
+  }
+
+  if (si->size != 0) {
+    auto range = std::equal_range(g_soinfos_by_address.begin(), g_soinfos_by_address.end(), si,
+                                  base_less);
+    auto it = std::find(range.first, range.second, si);
+    if (it != range.second) {
+      g_soinfos_by_address.erase(it);
+    }
+  }
+}
+
+const std::vector<soinfo*>* SoinfoRegistry::find_by_soname(const char* soname) {
+  auto it = g_soinfos_by_soname.find(soname);
+  return it != g_soinfos_by_soname.end() ? &it->second : nullptr;
+}
+
+soinfo* SoinfoRegistry::find_by_file(dev_t dev, ino_t ino, off64_t file_offset) {
+  file_key key = { dev, ino, file_offset };
+  auto it = g_soinfos_by_file.find(key);
+  return it != g_soinfos_by_file.end() ? it->second.front() : nullptr;
+}
+
+soinfo* SoinfoRegistry::find_by_address(ElfW(Addr) address) {
+  // The last library that starts at or below the address.
+  auto it = std::upper_bound(g_soinfos_by_address.begin(), g_soinfos_by_address.end(), address,
+                             [](ElfW(Addr) a, const soinfo* si) {
+    return a < si->base;
+  });
+
+  if (it == g_soinfos_by_address.begin()) {
+    return nullptr;
+  }
+
+  soinfo* si = *--it;
+  return (address - si->base < si->size) ? si : nullptr;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINKER_SOINFO_REGISTRY_H
+#define __LINKER_SOINFO_REGISTRY_H
+
+#include <sys/types.h>
+
+#include <vector>
+
+#include "linker.h"
+#include "private/bionic_macros.h"
+
+// Indexes of the libraries in solist, so that finding a library by soname,
+// by file or by address does not have to walk the whole list. A library is
+// added once it is prelinked (its soname and mapping are known by then) and
+// removed when it is freed. Where several libraries share a key, they are
+// kept in the order they were added, which is their order in solist.
+class SoinfoRegistry {
+ public:
+  static void add(soinfo* si);
+  // It is fine to remove a library that was never added.
+  static void remove(soinfo* si);
+
+  // Returns the libraries with this soname, or nullptr if there are none.
+  static const std::vector<soinfo*>* find_by_soname(const char* soname);
+
+  // Returns the first library loaded from offset 'file_offset' of the
+  // file (dev, ino), or nullptr.
+  static soinfo* find_by_file(dev_t dev, ino_t ino, off64_t file_offset);
+
+  // Returns the library whose mapping contains 'address', or nullptr.
+  static soinfo* find_by_address(ElfW(Addr) address);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SoinfoRegistry);
+};
+
+#endif  // __LINKER_SOINFO_REGISTRY_H
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker_symbol_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "linker_debug.h"
+#include "private/ScopeGuard.h"
+
+static const char kSymbolCacheMagic[4] = { 'L', 'D', 'S', 'C' };
+static const uint32_t kSymbolCacheVersion = 1;
+
+// scope_index values with a special meaning.
+static const uint32_t kEntryNotRecorded = UINT32_MAX;
+static const uint32_t kEntryUndefined = UINT32_MAX - 1;
+
+struct symbol_cache_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t identity_count;
+  uint32_t entry_count;
+};
+
+static const char* g_symbol_cache_dir = nullptr;
+
+void SymbolResolutionCache::set_cache_dir(const char* cache_dir) {
+  g_symbol_cache_dir = (cache_dir != nullptr && *cache_dir != '\0') ? cache_dir : nullptr;
+}
+
+static uint64_t fnv1a_hash(const void* data, size_t size, uint64_t hash) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+bool SymbolResolutionCache::get_file_identity(const soinfo* si, file_identity* identity) {
+  memset(identity, 0, sizeof(*identity));
+
+  if (si->get_st_dev() != 0 && si->get_st_ino() != 0) {
+    identity->dev = si->get_st_dev();
+    identity->ino = si->get_st_ino();
+    identity->mtime = si->get_st_mtime();
+    identity->file_offset = si->get_file_offset();
+    return true;
+  }
+
+  // The main executable is mapped by the kernel and libdl.so is a part of
+  // the linker itself; neither of them has been fstat()ed by the linker.
+  const char* path = nullptr;
+  if (si->is_main_executable()) {
+    path = "/proc/self/exe";
+  } else if (si == get_libdl_info()) {
+    path = LINKER_PATH;
+  } else {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (TEMP_FAILURE_RETRY(stat(path, &file_stat)) != 0) {
+    return false;
+  }
+
+  identity->dev = file_stat.st_dev;
+  identity->ino = file_stat.st_ino;
+  identity->mtime = file_stat.st_mtime;
+  return true;
+}
+
+SymbolResolutionCache::SymbolResolutionCache(const soinfo* si_from,
+                                             const soinfo::soinfo_list_t& global_group,
+                                             const soinfo::soinfo_list_t& local_group)
+    : si_from_(si_from), enabled_(false), dirty_(false), key_(0) {
+  if (g_symbol_cache_dir == nullptr) {
+    return;
+  }
+
+  global_group.for_each([&](soinfo* si) {
+    scope_.push_back(si);
+  });
+  local_group.for_each([&](soinfo* si) {
+    scope_.push_back(si);
+  });
+
+  // The first identity is the library being relocated, the rest
+  // is the lookup scope in search order.
+  identities_.resize(scope_.size() + 1);
+  if (!get_file_identity(si_from, &identities_[0])) {
+    return;
+  }
+
+  for (size_t i = 0; i < scope_.size(); ++i) {
+    if (!get_file_identity(scope_[i], &identities_[i + 1])) {
+      TRACE("[ symbol cache disabled for \"%s\": cannot identify \"%s\" ]",
+            si_from->get_realpath(), scope_[i]->get_realpath());
+      return;
+    }
+  }
+
+  key_ = fnv1a_hash(&identities_[0], identities_.size() * sizeof(file_identity),
+                    0xcbf29ce484222325ULL);
+  enabled_ = true;
+
+  if (load()) {
+    TRACE("[ using symbol cache for \"%s\" (%zd entries) ]",
+          si_from->get_realpath(), entries_.size());
+  }
+}
+
+bool SymbolResolutionCache::make_path(char* buf, size_t buf_size, const char* suffix) const {
+  int n = __libc_format_buffer(buf, buf_size, "%s/%" PRIx64 ".symcache%s",
+                               g_symbol_cache_dir, key_, suffix);
+  return n > 0 && n < static_cast<int>(buf_size);
+}
+
+bool SymbolResolutionCache::load() {
+  char path[PATH_MAX];
+  if (!make_path(path, sizeof(path), "")) {
+    return false;
+  }
+
+  int fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+  if (fd == -1) {
+    return false;
+  }
+
+  auto guard = make_scope_guard([&]() {
+    close(fd);
+  });
+
+  symbol_cache_header header;
+  if (TEMP_FAILURE_RETRY(read(fd, &header, sizeof(header))) != sizeof(header) ||
+      memcmp(header.magic, kSymbolCacheMagic, sizeof(kSymbolCacheMagic)) != 0 ||
+      header.version != kSymbolCacheVersion ||
+      header.identity_count != identities_.size()) {
+    return false;
+  }
+
+  // The file name is only a hash of the identities; compare them all
+  // to rule out collisions.
+  std::vector<file_identity> identities(header.identity_count);
+  ssize_t identities_size = identities.size() * sizeof(file_identity);
+  if (TEMP_FAILURE_RETRY(read(fd, &identities[0], identities_size)) != identities_size ||
+      memcmp(&identities[0], &identities_[0], identities_size) != 0) {
+    return false;
+  }
+
+  std::vector<entry> entries(header.entry_count);
+  ssize_t entries_size = entries.size() * sizeof(entry);
+  if (entries_size != 0 &&
+      TEMP_FAILURE_RETRY(read(fd, &entries[0], entries_size)) != entries_size) {
+    return false;
+  }
+
+  std::vector<size_t> symbol_counts(scope_.size());
+  for (size_t i = 0; i < scope_.size(); ++i) {
+    symbol_counts[i] = scope_[i]->get_symbol_count();
+  }
+
+  for (const auto& e : entries) {
+    if (e.scope_index == kEntryNotRecorded || e.scope_index == kEntryUndefined) {
+      continue;
+    }
+    if (e.scope_index >= scope_.size() || e.symbol_index >= symbol_counts[e.scope_index]) {
+      return false;
+    }
+  }
+
+  entries_.swap(entries);
+  return true;
+}
+
+bool SymbolResolutionCache::lookup(ElfW(Word) sym, const char* sym_name,
+                                   const version_info* vi,
+                                   soinfo** si_found, const ElfW(Sym)** s) const {
+  if (!enabled_ || sym >= entries_.size()) {
+    return false;
+  }
+
+  const entry& e = entries_[sym];
+  if (e.scope_index == kEntryNotRecorded) {
+    return false;
+  }
+
+  if (e.scope_index == kEntryUndefined) {
+    // Only a weak reference may stay unresolved.
+    if (ELF_ST_BIND(si_from_->get_symbol(sym)->st_info) != STB_WEAK) {
+      TRACE("[ ignoring stale symbol cache entry for \"%s\" ]", sym_name);
+      return false;
+    }
+    *si_found = nullptr;
+    *s = nullptr;
+    return true;
+  }
+
+  // load() checked that the index is within the library's symbol table.
+  soinfo* si = scope_[e.scope_index];
+  const ElfW(Sym)* symbol = si->get_symbol(e.symbol_index);
+  if (symbol->st_shndx == SHN_UNDEF || strcmp(si->get_string(symbol->st_name), sym_name) != 0) {
+    TRACE("[ ignoring stale symbol cache entry for \"%s\" ]", sym_name);
+    return false;
+  }
+
+  // The same name can be defined once per version, so the name alone
+  // doesn't prove that this is the definition a lookup would pick.
+  if (!si->is_symbol_version_acceptable(e.symbol_index, vi)) {
+    TRACE("[ ignoring symbol cache entry for \"%s\" with the wrong version ]", sym_name);
+    return false;
+  }
+
+  *si_found = si;
+  *s = symbol;
+  return true;
+}
+
+void SymbolResolutionCache::record(ElfW(Word) sym, const soinfo* si_found,
+                                   uint32_t symbol_index) {
+  if (!enabled_) {
+    return;
+  }
+
+  uint32_t scope_index = kEntryUndefined;
+  if (si_found != nullptr) {
+    size_t i = 0;
+    while (i < scope_.size() && scope_[i] != si_found) {
+      ++i;
+    }
+
+    if (i == scope_.size()) {
+      // Found outside of the scope (this should not happen) - do not cache.
+      return;
+    }
+    scope_index = i;
+  }
+
+  if (sym >= entries_.size()) {
+    entries_.resize(sym + 1, entry { kEntryNotRecorded, 0 });
+  }
+
+  entries_[sym].scope_index = scope_index;
+  entries_[sym].symbol_index = symbol_index;
+  dirty_ = true;
+}
+
+void SymbolResolutionCache::save() {
+  if (!enabled_ || !dirty_) {
+    return;
+  }
+
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  char suffix[32];
+  __libc_format_buffer(suffix, sizeof(suffix), ".%d", getpid());
+  if (!make_path(path, sizeof(path), "") || !make_path(tmp_path, sizeof(tmp_path), suffix)) {
+    return;
+  }
+
+  // Write to a temporary file and rename it, so that concurrent processes
+  // never see a partially written cache.
+  // O_EXCL so that a file (or symlink) planted at the temporary path is
+  // never written through; a leftover from a crashed process with the same
+  // pid is removed first.
+  unlink(tmp_path);
+  int fd = TEMP_FAILURE_RETRY(open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600));
+  if (fd == -1) {
+    DEBUG("unable to create symbol cache \"%s\": %s", tmp_path, strerror(errno));
+    return;
+  }
+
+  symbol_cache_header header;
+  memcpy(header.magic, kSymbolCacheMagic, sizeof(kSymbolCacheMagic));
+  header.version = kSymbolCacheVersion;
+  header.identity_count = identities_.size();
+  header.entry_count = entries_.size();
+
+  ssize_t identities_size = identities_.size() * sizeof(file_identity);
+  ssize_t entries_size = entries_.size() * sizeof(entry);
+
+  bool written =
+      TEMP_FAILURE_RETRY(write(fd, &header, sizeof(header))) == sizeof(header) &&
+      TEMP_FAILURE_RETRY(write(fd, &identities_[0], identities_size)) == identities_size &&
+      (entries_size == 0 ||
+       TEMP_FAILURE_RETRY(write(fd, &entries_[0], entries_size)) == entries_size);
+  close(fd);
+
+  if (!written || rename(tmp_path, path) != 0) {
+    DEBUG("unable to write symbol cache \"%s\": %s", path, strerror(errno));
+    unlink(tmp_path);
+    return;
+  }
+
+  dirty_ = false;
+}
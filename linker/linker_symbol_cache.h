@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINKER_SYMBOL_CACHE_H
+#define __LINKER_SYMBOL_CACHE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "linker.h"
+#include "private/bionic_macros.h"
+
+// On-disk cache of symbol resolution results for a single library.
+//
+// The cache is keyed by the identity (st_dev, st_ino, mtime and file offset)
+// of the library being relocated and of every library in its lookup scope
+// (global group followed by local group). For every symbol index referenced
+// by a relocation it records the position of the defining library in the
+// scope and the index of the definition in that library's symbol table, so
+// that a warm start can resolve relocations without hashing or strcmp.
+//
+// The cache is opt-in: it is only used when LD_SYMBOL_CACHE_DIR points to a
+// writable directory (and the process is not AT_SECURE).
+class SymbolResolutionCache {
+ public:
+  SymbolResolutionCache(const soinfo* si_from,
+                        const soinfo::soinfo_list_t& global_group,
+                        const soinfo::soinfo_list_t& local_group);
+
+  // Returns true if the cache is usable for this scope. This is false when
+  // caching is disabled or when one of the libraries cannot be identified.
+  bool is_enabled() const {
+    return enabled_;
+  }
+
+  // Looks up a previously recorded resolution for the symbol index 'sym'
+  // of si_from, named sym_name. On success *si_found is the defining library
+  // and *s the definition, or both are nullptr for an unresolved weak
+  // reference. A recorded definition that isn't a defined symbol named
+  // sym_name with a version satisfying vi is ignored, so a bad cache can
+  // only cost a regular lookup.
+  bool lookup(ElfW(Word) sym, const char* sym_name, const version_info* vi,
+              soinfo** si_found, const ElfW(Sym)** s) const;
+
+  void record(ElfW(Word) sym, const soinfo* si_found, uint32_t symbol_index);
+
+  // Writes the cache back to disk if anything was recorded.
+  void save();
+
+  static void set_cache_dir(const char* cache_dir);
+
+ private:
+  struct file_identity {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime;
+    int64_t file_offset;
+  };
+
+  struct entry {
+    uint32_t scope_index;
+    uint32_t symbol_index;
+  };
+
+  bool load();
+  bool make_path(char* buf, size_t buf_size, const char* suffix) const;
+  static bool get_file_identity(const soinfo* si, file_identity* identity);
+
+  const soinfo* si_from_;
+  bool enabled_;
+  bool dirty_;
+  std::vector<soinfo*> scope_;
+  std::vector<file_identity> identities_;
+  std::vector<entry> entries_;
+  uint64_t key_;
+
+  DISALLOW_COPY_AND_ASSIGN(SymbolResolutionCache);
+};
+
+#endif  // __LINKER_SYMBOL_CACHE_H
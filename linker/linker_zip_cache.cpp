@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker_zip_cache.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "linker.h"
+#include "linker_debug.h"
+#include "ziparchive/zip_archive.h"
+
+// Apps rarely load libraries from more than a few zip files.
+static const size_t kMaxCachedArchives = 8;
+
+struct zip_archive_index {
+  struct entry {
+    uint32_t name_offset;
+    uint32_t name_length;
+    off64_t offset;
+    off64_t length;
+  };
+
+  dev_t dev;
+  ino_t ino;
+  time_t mtime;
+  off64_t size;
+
+  // All the names, without terminators, and the entries sorted by name.
+  std::string names;
+  std::vector<entry> entries;
+
+  bool build(int fd);
+  bool find(const char* entry_name, off64_t* entry_offset, off64_t* entry_length) const;
+};
+
+bool zip_archive_index::build(int fd) {
+  ZipArchiveHandle handle;
+  if (OpenArchiveFd(fd, "", &handle, false) != 0) {
+    // invalid zip-file (?)
+    return false;
+  }
+
+  void* cookie;
+  if (StartIteration(handle, &cookie, nullptr, nullptr) != 0) {
+    CloseArchive(handle);
+    return false;
+  }
+
+  ZipEntry zip_entry;
+  ZipEntryName zip_entry_name;
+  while (Next(cookie, &zip_entry, &zip_entry_name) == 0) {
+    // Libraries have to be stored and page aligned to be mapped directly.
+    if (zip_entry.method != kCompressStored || (zip_entry.offset % PAGE_SIZE) != 0) {
+      continue;
+    }
+
+    entry e;
+    e.name_offset = names.size();
+    e.name_length = zip_entry_name.name_length;
+    e.offset = zip_entry.offset;
+    e.length = zip_entry.uncompressed_length;
+    names.append(reinterpret_cast<const char*>(zip_entry_name.name), zip_entry_name.name_length);
+    entries.push_back(e);
+  }
+
+  EndIteration(cookie);
+  CloseArchive(handle);
+
+  const char* names_data = names.data();
+  std::sort(entries.begin(), entries.end(), [&](const entry& a, const entry& b) {
+    int cmp = memcmp(names_data + a.name_offset, names_data + b.name_offset,
+                     std::min(a.name_length, b.name_length));
+    return cmp < 0 || (cmp == 0 && a.name_length < b.name_length);
+  });
+
+  return true;
+}
+
+bool zip_archive_index::find(const char* entry_name,
+                             off64_t* entry_offset, off64_t* entry_length) const {
+  size_t entry_name_length = strlen(entry_name);
+  const char* names_data = names.data();
+
+  auto it = std::lower_bound(entries.begin(), entries.end(), entry_name,
+                             [&](const entry& e, const char* name) {
+    int cmp = memcmp(names_data + e.name_offset, name, std::min<size_t>(e.name_length, entry_name_length));
+    return cmp < 0 || (cmp == 0 && e.name_length < entry_name_length);
+  });
+
+  if (it == entries.end() || it->name_length != entry_name_length ||
+      memcmp(names_data + it->name_offset, entry_name, entry_name_length) != 0) {
+    return false;
+  }
+
+  *entry_offset = it->offset;
+  *entry_length = it->length;
+  return true;
+}
+
+// Most recently used first.
+static std::vector<zip_archive_index*> g_zip_archive_cache;
+
+bool ZipArchiveCache::find_entry(int fd, const char* entry_name,
+                                 off64_t* entry_offset, off64_t* entry_length) {
+  struct stat file_stat;
+  if (TEMP_FAILURE_RETRY(fstat(fd, &file_stat)) != 0) {
+    return false;
+  }
+
+  zip_archive_index* index = nullptr;
+  for (size_t i = 0; i < g_zip_archive_cache.size(); ++i) {
+    zip_archive_index* candidate = g_zip_archive_cache[i];
+    if (candidate->dev == file_stat.st_dev &&
+        candidate->ino == file_stat.st_ino &&
+        candidate->mtime == file_stat.st_mtime &&
+        candidate->size == file_stat.st_size) {
+      index = candidate;
+      g_zip_archive_cache.erase(g_zip_archive_cache.begin() + i);
+      break;
+    }
+  }
+
+  if (index == nullptr) {
+    index = new zip_archive_index();
+    index->dev = file_stat.st_dev;
+    index->ino = file_stat.st_ino;
+    index->mtime = file_stat.st_mtime;
+    index->size = file_stat.st_size;
+
+    if (!index->build(fd)) {
+      delete index;
+      return false;
+    }
+
+    TRACE("[ cached zip directory: %zd loadable entries ]", index->entries.size());
+
+    if (g_zip_archive_cache.size() == kMaxCachedArchives) {
+      delete g_zip_archive_cache.back();
+      g_zip_archive_cache.pop_back();
+    }
+  }
+
+  g_zip_archive_cache.insert(g_zip_archive_cache.begin(), index);
+  return index->find(entry_name, entry_offset, entry_length);
+}
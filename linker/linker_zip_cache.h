@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINKER_ZIP_CACHE_H
+#define __LINKER_ZIP_CACHE_H
+
+#include <sys/types.h>
+
+#include "private/bionic_macros.h"
+
+// Cache of the central directories of the zip files libraries are loaded
+// from ("foo.apk!/lib/x.so"), so that the directory of an apk is parsed once
+// rather than on every dlopen() of one of its libraries.
+//
+// Archives are identified by the st_dev, st_ino, st_mtime and st_size of the
+// file, and only the entries a library can be loaded from (stored, starting
+// at a page boundary) are kept, sorted by name.
+class ZipArchiveCache {
+ public:
+  // Looks up entry_name in the zip file open on fd. Returns false if the
+  // file is not a valid zip file, or if it has no such entry that a library
+  // can be loaded from; otherwise sets *entry_offset to the offset of the
+  // entry's data in the file and *entry_length to its size.
+  static bool find_entry(int fd, const char* entry_name,
+                         off64_t* entry_offset, off64_t* entry_length);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ZipArchiveCache);
+};
+
+#endif  // __LINKER_ZIP_CACHE_H
@@ -191,3 +191,49 @@ TEST(linker_memory, test_large) {
 }
 
 
+
+// Allocation churn like that of dlopen/dlclose: objects of all the small
+// sizes freed in a different order than they were allocated in.
+TEST(linker_memory, test_small_stress) {
+  LinkerMemoryAllocator allocator;
+
+  const size_t kLiveObjects = 2000;
+  const size_t kIterations = 200000;
+
+  uint8_t* objects[kLiveObjects];
+  size_t sizes[kLiveObjects];
+
+  uint32_t seed = 1;
+  auto next_random = [&seed]() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+  };
+
+  for (size_t i = 0; i < kLiveObjects; ++i) {
+    sizes[i] = 1 + next_random() % 1024;
+    objects[i] = reinterpret_cast<uint8_t*>(allocator.alloc(sizes[i]));
+    ASSERT_TRUE(objects[i] != nullptr);
+    memset(objects[i], static_cast<int>(i), sizes[i]);
+  }
+
+  for (size_t n = 0; n < kIterations; ++n) {
+    size_t i = next_random() % kLiveObjects;
+
+    for (size_t j = 0; j < sizes[i]; ++j) {
+      ASSERT_EQ(static_cast<uint8_t>(i), objects[i][j]);
+    }
+    allocator.free(objects[i]);
+
+    sizes[i] = 1 + next_random() % 1024;
+    objects[i] = reinterpret_cast<uint8_t*>(allocator.alloc(sizes[i]));
+    ASSERT_TRUE(objects[i] != nullptr);
+    for (size_t j = 0; j < sizes[i]; ++j) {
+      ASSERT_EQ(0, objects[i][j]);
+    }
+    memset(objects[i], static_cast<int>(i), sizes[i]);
+  }
+
+  for (size_t i = 0; i < kLiveObjects; ++i) {
+    allocator.free(objects[i]);
+  }
+}
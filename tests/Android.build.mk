@@ -92,14 +92,24 @@ LOCAL_LDLIBS := \
     $($(module)_ldlibs) \
     $($(module)_ldlibs_$(build_type)) \
 
-ifeq ($(LOCAL_FORCE_STATIC_EXECUTABLE),true)
+ifneq ($($(module)_cxx_stl),)
+LOCAL_CXX_STL := $($(module)_cxx_stl)
+else ifeq ($(LOCAL_FORCE_STATIC_EXECUTABLE),true)
 LOCAL_CXX_STL := libc++_static
 else
 LOCAL_CXX_STL := libc++
 endif
 
 ifeq ($(build_type),target)
+  ifneq ($($(module)_pack_relocations),)
+    LOCAL_PACK_MODULE_RELOCATIONS := $($(module)_pack_relocations)
+  endif
   include $(BUILD_$(build_target))
+  # Extra relocation_packer options (such as -r) for a packed module.
+  ifneq ($($(module)_pack_relocations_flags),)
+    $(intermediates)/PACKED/$(my_built_module_stem): RELOCATION_PACKER := \
+        $(RELOCATION_PACKER) $($(module)_pack_relocations_flags)
+  endif
 endif
 
 ifeq ($(build_type),host)
@@ -21,14 +21,19 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <link.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <android/dlext.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <string>
+
 #include <pagemap/pagemap.h>
 
 #include "TemporaryFile.h"
@@ -102,6 +107,183 @@ TEST_F(DlExtTest, ExtInfoNoFlags) {
   EXPECT_EQ(4, f());
 }
 
+TEST_F(DlExtTest, ExtInfoReadaheadSegments) {
+  android_dlextinfo extinfo;
+  extinfo.flags = ANDROID_DLEXT_READAHEAD_SEGMENTS;
+  handle_ = android_dlopen_ext(LIBNAME, RTLD_NOW, &extinfo);
+  ASSERT_DL_NOTNULL(handle_);
+  fn f = reinterpret_cast<fn>(dlsym(handle_, "getRandomNumber"));
+  ASSERT_DL_NOTNULL(f);
+  EXPECT_EQ(4, f());
+}
+
+TEST_F(DlExtTest, ExtInfoHugePageText) {
+  android_dlextinfo extinfo;
+  extinfo.flags = ANDROID_DLEXT_HUGE_PAGE_TEXT;
+  handle_ = android_dlopen_ext(LIBNAME, RTLD_NOW, &extinfo);
+  ASSERT_DL_NOTNULL(handle_);
+  fn f = reinterpret_cast<fn>(dlsym(handle_, "getRandomNumber"));
+  ASSERT_DL_NOTNULL(f);
+  EXPECT_EQ(4, f());
+}
+
+struct TextSegment {
+  const char* name;
+  ElfW(Addr) load_bias;
+  ElfW(Addr) start;
+  ElfW(Addr) file_end;
+};
+
+static int FindTextSegment(dl_phdr_info* info, size_t, void* data) {
+  TextSegment* text = reinterpret_cast<TextSegment*>(data);
+  if (info->dlpi_name == nullptr || strstr(info->dlpi_name, text->name) == nullptr) {
+    return 0;
+  }
+  for (size_t i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+    if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_X) != 0) {
+      text->load_bias = info->dlpi_addr;
+      text->start = info->dlpi_addr + phdr->p_vaddr;
+      text->file_end = text->start + phdr->p_filesz;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Returns the /proc/self/maps line of the mapping that contains addr.
+static std::string GetMapsLine(ElfW(Addr) addr) {
+  std::string line;
+  FILE* fp = fopen("/proc/self/maps", "re");
+  if (fp == nullptr) {
+    return line;
+  }
+  char buf[BUFSIZ];
+  while (fgets(buf, sizeof(buf), fp) != nullptr) {
+    uintptr_t start, end;
+    if (sscanf(buf, "%" SCNxPTR "-%" SCNxPTR, &start, &end) == 2 && start <= addr && addr < end) {
+      line = buf;
+      break;
+    }
+  }
+  fclose(fp);
+  return line;
+}
+
+static bool TransparentHugePagesEnabled() {
+  char buf[128] = {};
+  FILE* fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "re");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool enabled = fgets(buf, sizeof(buf), fp) != nullptr && strstr(buf, "[never]") == nullptr;
+  fclose(fp);
+  return enabled;
+}
+
+TEST_F(DlExtTest, ExtInfoHugePageTextLargeLibrary) {
+  const size_t kHugePageSize = 2 * 1024 * 1024;
+
+  android_dlextinfo extinfo;
+  extinfo.flags = ANDROID_DLEXT_HUGE_PAGE_TEXT;
+  handle_ = android_dlopen_ext("libdlext_test_huge_text.so", RTLD_NOW, &extinfo);
+  ASSERT_DL_NOTNULL(handle_);
+  fn f = reinterpret_cast<fn>(dlsym(handle_, "getRandomNumber"));
+  ASSERT_DL_NOTNULL(f);
+  EXPECT_EQ(4, f());
+
+  TextSegment text = { "libdlext_test_huge_text.so", 0, 0, 0 };
+  ASSERT_EQ(1, dl_iterate_phdr(FindTextSegment, &text));
+
+  // The library is loaded at a huge page boundary...
+  ASSERT_EQ(0U, text.load_bias % kHugePageSize);
+
+  // ...and has at least one huge page worth of text.
+  ElfW(Addr) huge_start = (text.start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  ElfW(Addr) huge_end = text.file_end & ~(kHugePageSize - 1);
+  ASSERT_LT(huge_start, huge_end);
+
+  // Unless transparent huge pages are disabled, that text has been moved to
+  // anonymous memory, which /proc/self/maps no longer attributes to the file.
+  std::string huge_text = GetMapsLine(huge_start);
+  ASSERT_NE("", huge_text);
+  ASSERT_TRUE(strstr(huge_text.c_str(), " r-xp ") != nullptr) << huge_text;
+  if (TransparentHugePagesEnabled()) {
+    ASSERT_TRUE(strstr(huge_text.c_str(), "libdlext_test_huge_text.so") == nullptr) << huge_text;
+  } else {
+    ASSERT_TRUE(strstr(huge_text.c_str(), "libdlext_test_huge_text.so") != nullptr) << huge_text;
+  }
+
+  // The unaligned start of the text is still mapped from the file.
+  if (text.start < huge_start) {
+    std::string file_text = GetMapsLine(text.start);
+    ASSERT_TRUE(strstr(file_text.c_str(), "libdlext_test_huge_text.so") != nullptr) << file_text;
+  }
+}
+
+struct DataSegment {
+  const char* name;
+  ElfW(Addr) start;
+  ElfW(Addr) file_end;
+};
+
+static int FindDataSegment(dl_phdr_info* info, size_t, void* data) {
+  DataSegment* segment = reinterpret_cast<DataSegment*>(data);
+  if (info->dlpi_name == nullptr || strstr(info->dlpi_name, segment->name) == nullptr) {
+    return 0;
+  }
+  for (size_t i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+    if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_W) != 0) {
+      segment->start = info->dlpi_addr + phdr->p_vaddr;
+      segment->file_end = segment->start + phdr->p_filesz;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Returns the Private_Dirty total, in kB, of the mappings that overlap
+// [start, end).
+static size_t GetPrivateDirtyKb(ElfW(Addr) start, ElfW(Addr) end) {
+  size_t total = 0;
+  FILE* fp = fopen("/proc/self/smaps", "re");
+  if (fp == nullptr) {
+    return total;
+  }
+  bool in_range = false;
+  char buf[BUFSIZ];
+  while (fgets(buf, sizeof(buf), fp) != nullptr) {
+    uintptr_t map_start, map_end;
+    size_t kb;
+    if (sscanf(buf, "%" SCNxPTR "-%" SCNxPTR " ", &map_start, &map_end) == 2) {
+      in_range = map_start < end && start < map_end;
+    } else if (in_range && sscanf(buf, "Private_Dirty: %zu kB", &kb) == 1) {
+      total += kb;
+    }
+  }
+  fclose(fp);
+  return total;
+}
+
+TEST_F(DlExtTest, ExtInfoReadaheadSegmentsLeavesDataClean) {
+  android_dlextinfo extinfo;
+  extinfo.flags = ANDROID_DLEXT_READAHEAD_SEGMENTS;
+  handle_ = android_dlopen_ext("libdlext_test_big_data.so", RTLD_NOW, &extinfo);
+  ASSERT_DL_NOTNULL(handle_);
+  fn f = reinterpret_cast<fn>(dlsym(handle_, "getRandomNumber"));
+  ASSERT_DL_NOTNULL(f);
+  EXPECT_EQ(4, f());
+
+  DataSegment data = { "libdlext_test_big_data.so", 0, 0 };
+  ASSERT_EQ(1, dl_iterate_phdr(FindDataSegment, &data));
+  ASSERT_GE(data.file_end - data.start, 1024U * 1024U);
+
+  // Relocation dirties a few pages, but the data that nothing writes to
+  // must not have been faulted in as private copies.
+  EXPECT_LT(GetPrivateDirtyKb(data.start, data.file_end), 256U);
+}
+
 TEST_F(DlExtTest, ExtInfoUseFd) {
   const std::string lib_path = std::string(getenv("ANDROID_DATA")) + LIBPATH;
 
@@ -177,6 +359,35 @@ TEST_F(DlExtTest, ExtInfoUseOffsetWihtoutFd) {
   ASSERT_STREQ("dlopen failed: invalid extended flag combination (ANDROID_DLEXT_USE_LIBRARY_FD_OFFSET without ANDROID_DLEXT_USE_LIBRARY_FD): 0x20", dlerror());
 }
 
+TEST_F(DlExtTest, ExtInfoUseSharedRelroWithoutReservedAddress) {
+  android_dlextinfo extinfo;
+  extinfo.flags = ANDROID_DLEXT_USE_SHARED_RELRO;
+
+  handle_ = android_dlopen_ext(LIBNAME, RTLD_NOW, &extinfo);
+  ASSERT_TRUE(handle_ == nullptr);
+  ASSERT_STREQ("dlopen failed: invalid extended flag combination (ANDROID_DLEXT_USE_SHARED_RELRO requires ANDROID_DLEXT_RESERVED_ADDRESS and excludes ANDROID_DLEXT_WRITE_RELRO and ANDROID_DLEXT_USE_RELRO): 0x100", dlerror());
+}
+
+TEST(dlext, android_dlsym_many) {
+  void* handle = dlopen(LIBNAME, RTLD_NOW);
+  ASSERT_DL_NOTNULL(handle);
+
+  // malloc comes from a dependency of the library.
+  const char* symbols[] = { "getRandomNumber", "this_symbol_does_not_exist", "malloc" };
+  void* addrs[3];
+  ASSERT_EQ(2U, android_dlsym_many(handle, symbols, addrs, 3));
+
+  ASSERT_EQ(dlsym(handle, "getRandomNumber"), addrs[0]);
+  ASSERT_TRUE(addrs[1] == nullptr);
+  ASSERT_EQ(dlsym(handle, "malloc"), addrs[2]);
+  ASSERT_EQ(4, reinterpret_cast<int (*)()>(addrs[0])());
+
+  ASSERT_EQ(0U, android_dlsym_many(handle, symbols + 1, addrs, 1));
+  ASSERT_STREQ("undefined symbol: this_symbol_does_not_exist", dlerror());
+
+  dlclose(handle);
+}
+
 TEST(dlext, android_dlopen_ext_force_load_smoke) {
   // 1. Open actual file
   void* handle = dlopen("libdlext_test.so", RTLD_NOW);
@@ -250,6 +461,174 @@ TEST(dlfcn, dlopen_from_zip_ld_library_path) {
   dlclose(handle);
 }
 
+static void copy_file(const std::string& from, const std::string& to) {
+  int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  ASSERT_NOERROR(in);
+  int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+  ASSERT_NOERROR(out);
+  char buf[4096];
+  ssize_t n;
+  while ((n = TEMP_FAILURE_RETRY(read(in, buf, sizeof(buf)))) > 0) {
+    ASSERT_EQ(n, TEMP_FAILURE_RETRY(write(out, buf, n)));
+  }
+  ASSERT_EQ(0, n);
+  close(out);
+  close(in);
+}
+
+// The zip files made by zipalign have no comment, so the end of central
+// directory record is the last 22 bytes, starting with its signature.
+static const uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+
+// Overwrites the signature of the end of central directory record of the
+// zip file at path, then sets the file's times to times.
+static void set_zip_signature(const std::string& path, uint32_t signature,
+                              const timespec times[2]) {
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  ASSERT_NOERROR(fd);
+  struct stat sb;
+  ASSERT_NOERROR(fstat(fd, &sb));
+  ASSERT_EQ(4, TEMP_FAILURE_RETRY(pwrite(fd, &signature, 4, sb.st_size - 22)));
+  ASSERT_NOERROR(futimens(fd, times));
+  close(fd);
+}
+
+TEST(dlfcn, dlopen_from_zip_cached_directory) {
+  TemporaryDir dir;
+  const std::string zip_path = std::string(dir.dirname) + "/libdlext_test_fd_zipaligned.zip";
+  copy_file(std::string(getenv("ANDROID_DATA")) + LIBZIPPATH, zip_path);
+
+  void* handle = dlopen((zip_path + "!/libdir/libdlext_test_fd.so").c_str(), RTLD_NOW);
+  ASSERT_DL_NOTNULL(handle);
+
+  // Break the zip file without changing its size or times. The second
+  // library is looked up in the directory cached by the first dlopen(), so
+  // this goes unnoticed.
+  struct stat sb;
+  ASSERT_NOERROR(stat(zip_path.c_str(), &sb));
+  const timespec times[2] = { sb.st_atim, sb.st_mtim };
+  set_zip_signature(zip_path, 0, times);
+
+  void* handle2 = dlopen((zip_path + "!/libdir/libtest_simple.so").c_str(), RTLD_NOW);
+  ASSERT_DL_NOTNULL(handle2);
+  ASSERT_TRUE(dlsym(handle2, "dlopen_testlib_simple_func") != nullptr) << dlerror();
+
+  dlclose(handle2);
+  dlclose(handle);
+  ASSERT_NOERROR(unlink(zip_path.c_str()));
+}
+
+TEST(dlfcn, dlopen_from_zip_replaced_in_place) {
+  TemporaryDir dir;
+  const std::string zip_path = std::string(dir.dirname) + "/libdlext_test_fd_zipaligned.zip";
+  const std::string lib_path = zip_path + "!/libdir/libdlext_test_fd.so";
+  copy_file(std::string(getenv("ANDROID_DATA")) + LIBZIPPATH, zip_path);
+
+  void* handle = dlopen(lib_path.c_str(), RTLD_NOW);
+  ASSERT_DL_NOTNULL(handle);
+  dlclose(handle);
+
+  // Rewriting the file changes its mtime, so the cached directory is
+  // dropped and the broken file is read again...
+  struct stat sb;
+  ASSERT_NOERROR(stat(zip_path.c_str(), &sb));
+  timespec times[2] = { sb.st_atim, sb.st_mtim };
+  times[1].tv_sec += 10;
+  set_zip_signature(zip_path, 0, times);
+  handle = dlopen(lib_path.c_str(), RTLD_NOW);
+  ASSERT_TRUE(handle == nullptr);
+
+  // ...and so is the fixed one.
+  times[1].tv_sec += 10;
+  set_zip_signature(zip_path, kEndOfCentralDirectorySignature, times);
+  handle = dlopen(lib_path.c_str(), RTLD_NOW);
+  ASSERT_DL_NOTNULL(handle);
+  dlclose(handle);
+
+  ASSERT_NOERROR(unlink(zip_path.c_str()));
+}
+
+// Returns the path libdlext_test_fd.so is loaded from, by name.
+static std::string dlopen_test_fd_path() {
+  void* handle = dlopen("libdlext_test_fd.so", RTLD_NOW);
+  if (handle == nullptr) {
+    return dlerror();
+  }
+  Dl_info info;
+  std::string path;
+  if (dladdr(dlsym(handle, "getRandomNumber"), &info) != 0) {
+    path = info.dli_fname;
+  }
+  dlclose(handle);
+  return path;
+}
+
+TEST(dlfcn, dlopen_ld_library_path_search_order) {
+  const std::string lib_path = std::string(getenv("ANDROID_DATA")) + LIBPATH;
+
+  typedef void (*fn_t)(const char*);
+  fn_t android_update_LD_LIBRARY_PATH =
+      reinterpret_cast<fn_t>(dlsym(RTLD_DEFAULT, "android_update_LD_LIBRARY_PATH"));
+  ASSERT_TRUE(android_update_LD_LIBRARY_PATH != nullptr) << dlerror();
+
+  TemporaryDir first;
+  TemporaryDir second;
+  const std::string first_lib = std::string(first.dirname) + "/libdlext_test_fd.so";
+  const std::string second_lib = std::string(second.dirname) + "/libdlext_test_fd.so";
+
+  // Make the first directory look old, so its listing is trusted for as
+  // long as its mtime doesn't change.
+  timeval old_times[2];
+  gettimeofday(&old_times[0], nullptr);
+  old_times[0].tv_sec -= 3600;
+  old_times[1] = old_times[0];
+  ASSERT_NOERROR(utimes(first.dirname, old_times));
+
+  android_update_LD_LIBRARY_PATH((std::string(first.dirname) + ":" + second.dirname).c_str());
+
+  copy_file(lib_path, second_lib);
+  ASSERT_EQ(second_lib, dlopen_test_fd_path());
+
+  // A library installed since the first directory was listed still wins.
+  copy_file(lib_path, first_lib);
+  ASSERT_EQ(first_lib, dlopen_test_fd_path());
+
+  // And one removed since is no longer looked for there.
+  ASSERT_NOERROR(unlink(first_lib.c_str()));
+  ASSERT_EQ(second_lib, dlopen_test_fd_path());
+
+  ASSERT_NOERROR(unlink(second_lib.c_str()));
+}
+
+TEST(dlfcn, dlopen_ld_library_path_update) {
+  const std::string lib_path = std::string(getenv("ANDROID_DATA")) + LIBPATH;
+
+  typedef void (*fn_t)(const char*);
+  fn_t android_update_LD_LIBRARY_PATH =
+      reinterpret_cast<fn_t>(dlsym(RTLD_DEFAULT, "android_update_LD_LIBRARY_PATH"));
+  ASSERT_TRUE(android_update_LD_LIBRARY_PATH != nullptr) << dlerror();
+
+  TemporaryDir first;
+  TemporaryDir second;
+  const std::string first_lib = std::string(first.dirname) + "/libdlext_test_fd.so";
+  const std::string second_lib = std::string(second.dirname) + "/libdlext_test_fd.so";
+  copy_file(lib_path, first_lib);
+  copy_file(lib_path, second_lib);
+
+  android_update_LD_LIBRARY_PATH(first.dirname);
+  ASSERT_EQ(first_lib, dlopen_test_fd_path());
+
+  // The directories searched are the new ones only.
+  android_update_LD_LIBRARY_PATH(second.dirname);
+  ASSERT_EQ(second_lib, dlopen_test_fd_path());
+
+  android_update_LD_LIBRARY_PATH((std::string(first.dirname) + ":" + second.dirname).c_str());
+  ASSERT_EQ(first_lib, dlopen_test_fd_path());
+
+  ASSERT_NOERROR(unlink(first_lib.c_str()));
+  ASSERT_NOERROR(unlink(second_lib.c_str()));
+}
+
 
 TEST_F(DlExtTest, Reserved) {
   void* start = mmap(nullptr, LIBSIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
@@ -405,6 +784,98 @@ TEST_F(DlExtRelroSharingTest, RelroFileEmpty) {
   ASSERT_NO_FATAL_FAILURE(TryUsingRelro(LIBNAME));
 }
 
+static const char* const kSharedRelroDir = "/data/misc/shared_relro";
+
+// Returns the name the linker gives the shared RELRO file of the library
+// file lib_stat (at file offset 0), as of the given mtime, loaded with the
+// given load bias.
+static std::string SharedRelroPath(const struct stat& lib_stat, time_t mtime,
+                                   ElfW(Addr) load_bias) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%" PRIx64 "_%" PRIx64 "_%" PRIx64 "_0_%" PRIx64 ".relro",
+           kSharedRelroDir, static_cast<uint64_t>(lib_stat.st_dev),
+           static_cast<uint64_t>(lib_stat.st_ino), static_cast<uint64_t>(mtime),
+           static_cast<uint64_t>(load_bias));
+  return path;
+}
+
+static bool IsFileMapped(const std::string& path) {
+  FILE* fp = fopen("/proc/self/maps", "re");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool mapped = false;
+  char buf[BUFSIZ];
+  while (!mapped && fgets(buf, sizeof(buf), fp) != nullptr) {
+    mapped = (strstr(buf, path.c_str()) != nullptr);
+  }
+  fclose(fp);
+  return mapped;
+}
+
+TEST_F(DlExtRelroSharingTest, SharedRelroStore) {
+  extinfo_.flags |= ANDROID_DLEXT_USE_SHARED_RELRO;
+
+  // Without a writable store nothing is shared, but loading still works.
+  bool store_writable = (access(kSharedRelroDir, W_OK) == 0);
+
+  // Find out which file the library is, and plant a file for an older
+  // version of it that publishing the current version has to remove.
+  struct stat lib_stat;
+  std::string stale_path;
+  if (store_writable) {
+    void* handle = dlopen(LIBNAME, RTLD_NOW);
+    ASSERT_DL_NOTNULL(handle);
+    Dl_info info;
+    ASSERT_NE(0, dladdr(dlsym(handle, "getRandomNumber"), &info));
+    ASSERT_NOERROR(stat(info.dli_fname, &lib_stat));
+    ASSERT_DL_ZERO(dlclose(handle));
+
+    stale_path = SharedRelroPath(lib_stat, lib_stat.st_mtime - 1, 0);
+    int fd = open(stale_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    ASSERT_NOERROR(fd);
+    close(fd);
+  }
+
+  // The child publishes the RELRO and the parent then maps it.
+  pid_t pid = fork();
+  if (pid == 0) {
+    void* handle = android_dlopen_ext(LIBNAME, RTLD_NOW, &extinfo_);
+    if (handle == nullptr) {
+      fprintf(stderr, "in child: %s\n", dlerror());
+      exit(1);
+    }
+    exit(0);
+  }
+
+  ASSERT_NOERROR(pid);
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  ASSERT_NO_FATAL_FAILURE(TryUsingRelro(LIBNAME));
+
+  if (!store_writable) {
+    GTEST_LOG_(INFO) << kSharedRelroDir << " isn't writable, nothing was shared.\n";
+    return;
+  }
+
+  TextSegment text = { LIBNAME, 0, 0, 0 };
+  ASSERT_EQ(1, dl_iterate_phdr(FindTextSegment, &text));
+  std::string store_path = SharedRelroPath(lib_stat, lib_stat.st_mtime, text.load_bias);
+
+  bool stale_removed = (access(stale_path.c_str(), F_OK) != 0);
+  bool published = (access(store_path.c_str(), F_OK) == 0);
+  bool mapped = IsFileMapped(store_path);
+  unlink(stale_path.c_str());
+  unlink(store_path.c_str());
+
+  ASSERT_TRUE(published) << store_path;
+  ASSERT_TRUE(mapped) << store_path;
+  ASSERT_TRUE(stale_removed) << stale_path;
+}
+
 TEST_F(DlExtRelroSharingTest, VerifyMemorySaving) {
   if (geteuid() != 0) {
     GTEST_LOG_(INFO) << "This test must be run as root.\n";
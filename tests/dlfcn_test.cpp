@@ -16,15 +16,27 @@
 
 #include <gtest/gtest.h>
 
+#include <dirent.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <limits.h>
+#include <link.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "private/ScopeGuard.h"
+#include "TemporaryFile.h"
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "utils.h"
 
@@ -284,6 +296,230 @@ TEST(dlfcn, dlopen_check_relocation_dt_needed_order) {
   ASSERT_EQ(1, fn());
 }
 
+#if defined(__BIONIC__)
+// Run by dlfcn.symbol_cache_corrupted, with LD_SYMBOL_CACHE_DIR set.
+TEST(dlfcn, DISABLED_symbol_cache_child) {
+  void* handle = dlopen("libtest_relo_check_dt_needed_order.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  typedef int (*fn_t) (void);
+  fn_t fn = reinterpret_cast<fn_t>(dlsym(handle, "relo_test_get_answer"));
+  ASSERT_TRUE(fn != nullptr) << dlerror();
+  ASSERT_EQ(1, fn());
+  dlclose(handle);
+}
+
+// Also sets LD_LOAD_PROFILE to load_profile if it's not null; the report
+// goes to load_profile + "." + the pid returned in *child_pid.
+static void run_symbol_cache_child(const char* cache_dir, const char* load_profile = nullptr,
+                                   pid_t* child_pid = nullptr) {
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    setenv("LD_SYMBOL_CACHE_DIR", cache_dir, 1);
+    if (load_profile != nullptr) {
+      setenv("LD_LOAD_PROFILE", load_profile, 1);
+    }
+    execl("/proc/self/exe", "/proc/self/exe", "--no-isolate", "--gtest_also_run_disabled_tests",
+          "--gtest_filter=dlfcn.DISABLED_symbol_cache_child", nullptr);
+    _exit(1);
+  }
+
+  if (child_pid != nullptr) {
+    *child_pid = pid;
+  }
+
+  int status;
+  ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+// Reads the numbers reported for a library, matched by file name, from a
+// LD_LOAD_PROFILE report. The columns are linker_load_profile.cpp's:
+// open_us load_us prelink_us link_us constructors_us relocations lookups
+// cached_lookups found_in not_found_in.
+static bool read_load_profile(const std::string& path, const char* library,
+                              std::vector<uint64_t>* columns) {
+  FILE* fp = fopen(path.c_str(), "re");
+  if (fp == nullptr) {
+    return false;
+  }
+
+  std::string suffix = std::string("/") + library;
+  bool found = false;
+  char line[PATH_MAX + 256];
+  while (!found && fgets(line, sizeof(line), fp) != nullptr) {
+    char* save_ptr;
+    char* realpath = strtok_r(line, " \n", &save_ptr);
+    if (realpath == nullptr || realpath[0] == '#') {
+      continue;
+    }
+    std::string name = realpath;
+    if (name.size() < suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+      continue;
+    }
+    columns->clear();
+    for (char* column; (column = strtok_r(nullptr, " \n", &save_ptr)) != nullptr; ) {
+      columns->push_back(strtoull(column, nullptr, 10));
+    }
+    found = true;
+  }
+
+  fclose(fp);
+  return found;
+}
+
+// Calls fn with the path of every symbol cache file in cache_dir, and
+// returns how many there were.
+template<typename F>
+static size_t for_each_symbol_cache(const char* cache_dir, F fn) {
+  DIR* dir = opendir(cache_dir);
+  if (dir == nullptr) {
+    return 0;
+  }
+  size_t count = 0;
+  dirent* e;
+  while ((e = readdir(dir)) != nullptr) {
+    std::string name = e->d_name;
+    if (name.size() > 9 && name.compare(name.size() - 9, 9, ".symcache") == 0) {
+      fn((std::string(cache_dir) + "/" + name).c_str());
+      ++count;
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+// Sets the symbol index of every recorded definition in a cache file. The
+// layout is linker_symbol_cache.cpp's: a 16 byte header with the number of
+// identities at offset 8, 32 bytes per identity, then pairs of 32-bit
+// (scope index, symbol index), where scope indexes of 0xfffffffe and up are
+// special.
+static void set_symbol_cache_indexes(const char* path, uint32_t symbol_index) {
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  ASSERT_NE(-1, fd) << path;
+  uint32_t identity_count;
+  ASSERT_EQ(4, pread(fd, &identity_count, 4, 8));
+  off_t offset = 16 + 32 * identity_count;
+  uint32_t entry[2];
+  while (pread(fd, entry, sizeof(entry), offset) == sizeof(entry)) {
+    if (entry[0] < 0xfffffffe) {
+      entry[1] = symbol_index;
+      ASSERT_EQ(static_cast<ssize_t>(sizeof(entry)), pwrite(fd, entry, sizeof(entry), offset));
+    }
+    offset += sizeof(entry);
+  }
+  close(fd);
+}
+
+TEST(dlfcn, symbol_cache_corrupted) {
+  TemporaryDir cache_dir;
+  auto guard = make_scope_guard([&]() {
+    for_each_symbol_cache(cache_dir.dirname, [](const char* path) { unlink(path); });
+  });
+
+  // A cold start writes the caches.
+  run_symbol_cache_child(cache_dir.dirname);
+  ASSERT_NE(0U, for_each_symbol_cache(cache_dir.dirname, [](const char*) {}));
+
+  // Indexes beyond the symbol tables get the whole cache ignored.
+  for_each_symbol_cache(cache_dir.dirname, [](const char* path) {
+    set_symbol_cache_indexes(path, 0x7fffffff);
+  });
+  run_symbol_cache_child(cache_dir.dirname);
+
+  // Indexes of other symbols get those entries looked up again.
+  for_each_symbol_cache(cache_dir.dirname, [](const char* path) {
+    set_symbol_cache_indexes(path, 1);
+  });
+  run_symbol_cache_child(cache_dir.dirname);
+}
+
+TEST(dlfcn, symbol_cache_warm_start) {
+  TemporaryDir cache_dir;
+  std::string load_profile = std::string(cache_dir.dirname) + "/load_profile";
+  std::vector<std::string> reports;
+  auto guard = make_scope_guard([&]() {
+    for_each_symbol_cache(cache_dir.dirname, [](const char* path) { unlink(path); });
+    for (const auto& report : reports) {
+      unlink(report.c_str());
+    }
+  });
+
+  const size_t kRelocations = 5;
+  const size_t kLookups = 6;
+  const size_t kCachedLookups = 7;
+
+  // A cold start looks every symbol up and writes the caches...
+  pid_t pid;
+  run_symbol_cache_child(cache_dir.dirname, load_profile.c_str(), &pid);
+  reports.push_back(load_profile + "." + std::to_string(pid));
+  std::vector<uint64_t> cold;
+  ASSERT_TRUE(read_load_profile(reports.back(), "libtest_relo_check_dt_needed_order.so", &cold));
+  ASSERT_LT(kCachedLookups, cold.size());
+  ASSERT_NE(0U, cold[kRelocations]);
+  ASSERT_NE(0U, cold[kLookups]);
+  ASSERT_EQ(0U, cold[kCachedLookups]);
+
+  // ...which serve the lookups of the next start.
+  run_symbol_cache_child(cache_dir.dirname, load_profile.c_str(), &pid);
+  reports.push_back(load_profile + "." + std::to_string(pid));
+  std::vector<uint64_t> warm;
+  ASSERT_TRUE(read_load_profile(reports.back(), "libtest_relo_check_dt_needed_order.so", &warm));
+  ASSERT_LT(kCachedLookups, warm.size());
+  ASSERT_NE(0U, warm[kCachedLookups]);
+  ASSERT_LT(warm[kLookups], cold[kLookups]);
+}
+
+// Run by dlfcn.load_profile, with LD_LOAD_PROFILE set.
+TEST(dlfcn, DISABLED_load_profile_child) {
+  void* handle = dlopen("libtest_relo_check_dt_needed_order.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  dlclose(handle);
+}
+
+TEST(dlfcn, load_profile) {
+  TemporaryDir dir;
+  std::string load_profile = std::string(dir.dirname) + "/load_profile";
+
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    setenv("LD_LOAD_PROFILE", load_profile.c_str(), 1);
+    execl("/proc/self/exe", "/proc/self/exe", "--no-isolate", "--gtest_also_run_disabled_tests",
+          "--gtest_filter=dlfcn.DISABLED_load_profile_child", nullptr);
+    _exit(1);
+  }
+
+  std::string report = load_profile + "." + std::to_string(pid);
+  auto guard = make_scope_guard([&]() {
+    unlink(report.c_str());
+  });
+
+  int status;
+  ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  // Libraries loaded at startup and by dlopen() are both in the report.
+  std::vector<uint64_t> columns;
+  ASSERT_TRUE(read_load_profile(report, "libc.so", &columns));
+  ASSERT_TRUE(read_load_profile(report, "libtest_relo_check_dt_needed_order.so", &columns));
+  ASSERT_LT(6U, columns.size());
+
+  // A single phase of a small library can take less than a microsecond,
+  // but not all of them.
+  uint64_t total_us = 0;
+  for (size_t i = 0; i < 5; ++i) {
+    total_us += columns[i];
+  }
+  ASSERT_NE(0U, total_us);
+  ASSERT_NE(0U, columns[5]);  // relocations
+  ASSERT_NE(0U, columns[6]);  // lookups
+}
+#endif
+
 TEST(dlfcn, dlopen_check_order_dlsym) {
   // Here is how the test library and its dt_needed
   // libraries are arranged
@@ -524,6 +760,31 @@ TEST(dlfcn, check_unload_after_reloc) {
   ASSERT_TRUE(handle == nullptr);
 }
 
+TEST(dlfcn, check_unload_of_external_group) {
+  // libdlext_test.so is loaded in its own group first, so that
+  // libtest_with_dependency.so only holds a reference to it.
+  void* handle_dependency = dlopen("libdlext_test.so", RTLD_NOW | RTLD_LOCAL);
+  ASSERT_TRUE(handle_dependency != nullptr) << dlerror();
+
+  void* handle = dlopen("libtest_with_dependency.so", RTLD_NOW | RTLD_LOCAL);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+
+  ASSERT_EQ(0, dlclose(handle_dependency));
+
+  handle_dependency = dlopen("libdlext_test.so", RTLD_NOW | RTLD_NOLOAD);
+  ASSERT_TRUE(handle_dependency != nullptr) << dlerror();
+  ASSERT_EQ(0, dlclose(handle_dependency));
+
+  // Dropping the last reference to libtest_with_dependency.so
+  // unloads both groups.
+  ASSERT_EQ(0, dlclose(handle));
+
+  handle = dlopen("libtest_with_dependency.so", RTLD_NOW | RTLD_NOLOAD);
+  ASSERT_TRUE(handle == nullptr);
+  handle_dependency = dlopen("libdlext_test.so", RTLD_NOW | RTLD_NOLOAD);
+  ASSERT_TRUE(handle_dependency == nullptr);
+}
+
 extern "C" int check_order_reloc_root_get_answer_impl() {
   return 42;
 }
@@ -716,6 +977,76 @@ TEST(dlfcn, dlsym_df_1_global) {
   ASSERT_EQ(0, dlclose(handle));
 }
 
+#if defined(__BIONIC__)
+struct packed_relocs_info {
+  const char* name;
+  bool packed;
+  // The packed relocations start with relative relocations in a bitmap.
+  bool bitmap;
+};
+
+static int find_packed_reloc_tags(dl_phdr_info* info, size_t, void* data) {
+  packed_relocs_info* packed_info = reinterpret_cast<packed_relocs_info*>(data);
+  if (info->dlpi_name == nullptr || strstr(info->dlpi_name, packed_info->name) == nullptr) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < info->dlpi_phnum; ++i) {
+    if (info->dlpi_phdr[i].p_type != PT_DYNAMIC) {
+      continue;
+    }
+    const ElfW(Dyn)* d = reinterpret_cast<const ElfW(Dyn)*>(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+    for (; d->d_tag != DT_NULL; ++d) {
+      if (d->d_tag == DT_ANDROID_REL || d->d_tag == DT_ANDROID_RELA) {
+        packed_info->packed = true;
+        const char* packed = reinterpret_cast<const char*>(info->dlpi_addr + d->d_un.d_ptr);
+        packed_info->bitmap = (memcmp(packed, "APR1", 4) == 0);
+      }
+    }
+  }
+  return 1;
+}
+#endif
+
+TEST(dlfcn, dlopen_packed_relocations) {
+  void* handle = dlopen("libtest_packed_relocs.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  bool (*check)();
+  check = reinterpret_cast<bool (*)()>(dlsym(handle, "dlopen_testlib_packed_relocs_check"));
+  ASSERT_TRUE(check != nullptr) << dlerror();
+  ASSERT_TRUE(check());
+#if defined(__BIONIC__)
+  // The target build packs this library on every arch: android.rel where the
+  // relocations are REL (arm, x86, mips) and android.rela elsewhere.
+  packed_relocs_info info = { "libtest_packed_relocs.so", false, false };
+  dl_iterate_phdr(find_packed_reloc_tags, &info);
+  ASSERT_TRUE(info.packed);
+  ASSERT_FALSE(info.bitmap);
+#endif
+  ASSERT_EQ(0, dlclose(handle));
+}
+
+TEST(dlfcn, dlopen_bitmap_packed_relocations) {
+  void* handle = dlopen("libtest_relr_packed_relocs.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  bool (*check)();
+  check = reinterpret_cast<bool (*)()>(dlsym(handle, "dlopen_testlib_packed_relocs_check"));
+  ASSERT_TRUE(check != nullptr) << dlerror();
+  ASSERT_TRUE(check());
+#if defined(__BIONIC__)
+  // Packed with relocation_packer -r, which can't use the bitmap on mips.
+  packed_relocs_info info = { "libtest_relr_packed_relocs.so", false, false };
+  dl_iterate_phdr(find_packed_reloc_tags, &info);
+  ASSERT_TRUE(info.packed);
+#if defined(__mips__)
+  ASSERT_FALSE(info.bitmap);
+#else
+  ASSERT_TRUE(info.bitmap);
+#endif
+#endif
+  ASSERT_EQ(0, dlclose(handle));
+}
+
 TEST(dlfcn, dlopen_failure) {
   void* self = dlopen("/does/not/exist", RTLD_NOW);
   ASSERT_TRUE(self == nullptr);
@@ -747,6 +1078,153 @@ TEST(dlfcn, dlerror_concurrent) {
   ASSERT_SUBSTR("/main/thread", main_thread_error);
 }
 
+static int GetAddsAndSubs(dl_phdr_info* info, size_t size, void* data) {
+  if (size < offsetof(dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs)) {
+    return -1;
+  }
+  unsigned long long* counts = reinterpret_cast<unsigned long long*>(data);
+  counts[0] = info->dlpi_adds;
+  counts[1] = info->dlpi_subs;
+  return 1;
+}
+
+TEST(dlfcn, dl_iterate_phdr_adds_subs) {
+  unsigned long long before[2];
+  ASSERT_EQ(1, dl_iterate_phdr(GetAddsAndSubs, before));
+
+  void* handle = dlopen("libtest_simple.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+
+  unsigned long long loaded[2];
+  ASSERT_EQ(1, dl_iterate_phdr(GetAddsAndSubs, loaded));
+  ASSERT_GT(loaded[0], before[0]);
+
+  ASSERT_EQ(0, dlclose(handle));
+
+  unsigned long long unloaded[2];
+  ASSERT_EQ(1, dl_iterate_phdr(GetAddsAndSubs, unloaded));
+  ASSERT_GT(unloaded[1], loaded[1]);
+}
+
+// Reads everything the callback is given, and the library's own memory
+// through it, as an unwinder would.
+static int ReadAllPhdrs(dl_phdr_info* info, size_t, void* data) {
+  size_t* count = reinterpret_cast<size_t*>(data);
+  for (size_t i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type == PT_LOAD) {
+      ++*count;
+    } else if (phdr.p_type == PT_DYNAMIC) {
+      const ElfW(Dyn)* dynamic =
+          reinterpret_cast<const ElfW(Dyn)*>(info->dlpi_addr + phdr.p_vaddr);
+      for (const ElfW(Dyn)* d = dynamic; d->d_tag != DT_NULL; ++d) {
+        ++*count;
+      }
+    } else if (phdr.p_type == PT_GNU_EH_FRAME) {
+      // The version byte of .eh_frame_hdr.
+      *count += *reinterpret_cast<const uint8_t*>(info->dlpi_addr + phdr.p_vaddr);
+    }
+  }
+  if (info->dlpi_name != nullptr) {
+    *count += strlen(info->dlpi_name);
+  }
+  return 0;
+}
+
+static void* ConcurrentDlopenDlcloseFn(void*) {
+  for (size_t i = 0; i < 200; ++i) {
+    void* handle = dlopen("libtest_simple.so", RTLD_NOW);
+    if (handle == nullptr) {
+      return reinterpret_cast<void*>(strdup(dlerror()));
+    }
+    dlclose(handle);
+  }
+  return nullptr;
+}
+
+TEST(dlfcn, dl_iterate_phdr_concurrent_dlopen) {
+  // The callbacks read the dynamic sections of the libraries that the other
+  // thread is unloading: they must not be unmapped under the callback.
+  pthread_t t;
+  ASSERT_EQ(0, pthread_create(&t, nullptr, ConcurrentDlopenDlcloseFn, nullptr));
+
+  for (size_t i = 0; i < 2000; ++i) {
+    size_t count = 0;
+    ASSERT_EQ(0, dl_iterate_phdr(ReadAllPhdrs, &count));
+    ASSERT_NE(0U, count);
+  }
+
+  void* result;
+  ASSERT_EQ(0, pthread_join(t, &result));
+  ASSERT_TRUE(result == nullptr) << reinterpret_cast<char*>(result);
+}
+
+// Total size of the linker's own heap.
+static size_t GetLinkerAllocSize() {
+  FILE* fp = fopen("/proc/self/maps", "re");
+  if (fp == nullptr) {
+    return 0;
+  }
+
+  size_t total = 0;
+  char line[BUFSIZ];
+  while (fgets(line, sizeof(line), fp) != nullptr) {
+    uintptr_t start, end;
+    if (strstr(line, "[anon:linker_alloc") != nullptr &&
+        sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &start, &end) == 2) {
+      total += end - start;
+    }
+  }
+  fclose(fp);
+  return total;
+}
+
+// Takes its time over every library, so that readers overlap.
+static int SlowPhdrReader(dl_phdr_info*, size_t, void*) {
+  usleep(100);
+  return 0;
+}
+
+static void* OverlappingPhdrReaderFn(void* arg) {
+  std::atomic<bool>* done = reinterpret_cast<std::atomic<bool>*>(arg);
+  while (!*done) {
+    dl_iterate_phdr(SlowPhdrReader, nullptr);
+  }
+  return nullptr;
+}
+
+TEST(dlfcn, dl_iterate_phdr_overlapping_readers) {
+  // Two readers that are never gone at the same time must not keep every
+  // snapshot replaced by dlopen and dlclose alive.
+  std::atomic<bool> done(false);
+  pthread_t readers[2];
+  for (pthread_t& reader : readers) {
+    ASSERT_EQ(0, pthread_create(&reader, nullptr, OverlappingPhdrReaderFn, &done));
+  }
+  auto guard = make_scope_guard([&]() {
+    done = true;
+    for (pthread_t& reader : readers) {
+      pthread_join(reader, nullptr);
+    }
+  });
+
+  void* handle = dlopen("libtest_simple.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  ASSERT_EQ(0, dlclose(handle));
+  size_t before = GetLinkerAllocSize();
+
+  for (size_t i = 0; i < 500; ++i) {
+    handle = dlopen("libtest_simple.so", RTLD_NOW);
+    ASSERT_TRUE(handle != nullptr) << dlerror();
+    ASSERT_EQ(0, dlclose(handle));
+  }
+  size_t after = GetLinkerAllocSize();
+
+  // A thousand snapshots of the program headers alone would take
+  // several megabytes.
+  ASSERT_LT(after, before + 1024 * 1024);
+}
+
 TEST(dlfcn, dlsym_failures) {
   dlerror(); // Clear any pending errors.
   void* self = dlopen(nullptr, RTLD_NOW);
@@ -979,6 +1457,27 @@ TEST(dlfcn, dlopen_undefined_weak_func) {
   dlclose(handle);
 }
 
+// mips does not support lazy binding.
+#if !defined(__mips__)
+TEST(dlfcn, dlopen_lazy_binding) {
+  void* handle = dlopen("libtest_dlopen_lazy_binding.so", RTLD_LAZY);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  typedef pid_t (*fn_t)();
+  fn_t fn = reinterpret_cast<fn_t>(dlsym(handle, "lazy_binding_getpid"));
+  ASSERT_TRUE(fn != nullptr) << dlerror();
+  // The first call goes through the resolver, the second one does not.
+  ASSERT_EQ(getpid(), fn());
+  ASSERT_EQ(getpid(), fn());
+  dlclose(handle);
+}
+#endif
+
+TEST(dlfcn, dlopen_lazy_binding_RTLD_NOW) {
+  void* handle = dlopen("libtest_dlopen_lazy_binding.so", RTLD_NOW);
+  ASSERT_TRUE(handle == nullptr);
+  ASSERT_SUBSTR("lazy_binding_undefined_func", dlerror());
+}
+
 TEST(dlfcn, dlopen_symlink) {
   void* handle1 = dlopen("libdlext_test.so", RTLD_NOW);
   void* handle2 = dlopen("libdlext_test_v2.so", RTLD_NOW);
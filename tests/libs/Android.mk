@@ -108,6 +108,58 @@ build_type := target
 build_target := SHARED_LIBRARY
 include $(TEST_PATH)/Android.build.mk
 
+# -----------------------------------------------------------------------------
+# Library used by dlext tests - more than 2MB of text
+# -----------------------------------------------------------------------------
+libdlext_test_huge_text_src_files := \
+    dlext_test_huge_text.cpp \
+
+module := libdlext_test_huge_text
+module_tag := optional
+build_type := target
+build_target := SHARED_LIBRARY
+include $(TEST_PATH)/Android.build.mk
+
+# -----------------------------------------------------------------------------
+# Library used by dlext tests - 1MB of data that is never written to
+# -----------------------------------------------------------------------------
+libdlext_test_big_data_src_files := \
+    dlext_test_big_data.cpp \
+
+module := libdlext_test_big_data
+module_tag := optional
+build_type := target
+build_target := SHARED_LIBRARY
+include $(TEST_PATH)/Android.build.mk
+
+# -----------------------------------------------------------------------------
+# Malloc backends used by malloc tests
+# -----------------------------------------------------------------------------
+libtest_malloc_backend_src_files := \
+    malloc_backend.cpp \
+
+libtest_malloc_backend_c_includes := bionic/libc
+libtest_malloc_backend_cxx_stl := none
+
+module := libtest_malloc_backend
+module_tag := optional
+build_type := target
+build_target := SHARED_LIBRARY
+include $(TEST_PATH)/Android.build.mk
+
+# Rejected as a backend: it depends on more than libc, libdl and libm.
+libtest_malloc_backend_with_dependency_src_files := \
+    malloc_backend.cpp \
+
+libtest_malloc_backend_with_dependency_c_includes := bionic/libc
+libtest_malloc_backend_with_dependency_shared_libraries := libtest_simple
+
+module := libtest_malloc_backend_with_dependency
+module_tag := optional
+build_type := target
+build_target := SHARED_LIBRARY
+include $(TEST_PATH)/Android.build.mk
+
 # -----------------------------------------------------------------------------
 # Library used by dlext tests - different name non-default location
 # -----------------------------------------------------------------------------
@@ -152,6 +204,17 @@ libtest_simple_src_files := \
 module := libtest_simple
 include $(LOCAL_PATH)/Android.build.testlib.mk
 
+# -----------------------------------------------------------------------------
+# Library with packed relocations (DT_ANDROID_REL or DT_ANDROID_RELA)
+# -----------------------------------------------------------------------------
+libtest_packed_relocs_src_files := \
+    dlopen_testlib_packed_relocs.cpp
+
+libtest_packed_relocs_pack_relocations := true
+
+module := libtest_packed_relocs
+include $(LOCAL_PATH)/Android.build.testlib.mk
+
 # -----------------------------------------------------------------------------
 # Library used by dlfcn nodelete tests
 # -----------------------------------------------------------------------------
@@ -426,6 +489,18 @@ libtest_dlopen_weak_undefined_func_src_files := \
 module := libtest_dlopen_weak_undefined_func
 include $(LOCAL_PATH)/Android.build.testlib.mk
 
+# -----------------------------------------------------------------------------
+# Library with an undefined function, linked for lazy binding
+# -----------------------------------------------------------------------------
+libtest_dlopen_lazy_binding_src_files := \
+    dlopen_testlib_lazy_binding.cpp
+
+libtest_dlopen_lazy_binding_ldflags := -Wl,-z,lazy
+libtest_dlopen_lazy_binding_allow_undefined_symbols := true
+
+module := libtest_dlopen_lazy_binding
+include $(LOCAL_PATH)/Android.build.testlib.mk
+
 # -----------------------------------------------------------------------------
 # Library with constructor that calls dlopen() b/7941716
 # -----------------------------------------------------------------------------
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// 1MiB of initialized data with no relocations in it, which loading the
+// library should never need to write to.
+extern "C" {
+char big_data[1024 * 1024] = { 1 };
+}
+
+extern "C" int getRandomNumber() {
+  return 4;  // chosen by fair dice roll.
+             // guaranteed to be random.
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// 4MiB of text, so that at least one 2MiB aligned part of the text segment
+// is left for ANDROID_DLEXT_HUGE_PAGE_TEXT to move onto a huge page. It's
+// never executed.
+__asm__(".pushsection .text\n"
+        ".globl huge_text_padding\n"
+        "huge_text_padding:\n"
+        ".fill 4 * 1024 * 1024, 1, 0\n"
+        ".popsection\n");
+
+extern "C" const char huge_text_padding[];
+
+extern "C" const void* getHugeText() {
+  return huge_text_padding;
+}
+
+extern "C" int getRandomNumber() {
+  return 4;  // chosen by fair dice roll.
+             // guaranteed to be random.
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+// Not defined anywhere: only loadable with lazy binding.
+extern "C" int lazy_binding_undefined_func();
+
+extern "C" int lazy_binding_call_undefined_func() {
+  return lazy_binding_undefined_func();
+}
+
+extern "C" pid_t lazy_binding_getpid() {
+  return getpid();
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+// Enough relative relocations (and a few symbolic ones) for the relocation
+// packer to find the library worth packing.
+static int g_packed_relocs_values[256];
+
+#define VALUE_PTR_1(n) &g_packed_relocs_values[n]
+#define VALUE_PTR_4(n) VALUE_PTR_1(n), VALUE_PTR_1(n + 1), VALUE_PTR_1(n + 2), VALUE_PTR_1(n + 3)
+#define VALUE_PTR_16(n) VALUE_PTR_4(n), VALUE_PTR_4(n + 4), VALUE_PTR_4(n + 8), VALUE_PTR_4(n + 12)
+#define VALUE_PTR_64(n) VALUE_PTR_16(n), VALUE_PTR_16(n + 16), VALUE_PTR_16(n + 32), VALUE_PTR_16(n + 48)
+
+static int* g_packed_relocs_value_ptrs[] = {
+  VALUE_PTR_64(0), VALUE_PTR_64(64), VALUE_PTR_64(128), VALUE_PTR_64(192),
+};
+
+// Pointers into the middle of an object need a non-zero addend on RELA.
+static int* g_packed_relocs_offset_ptrs[] = {
+  VALUE_PTR_4(1), VALUE_PTR_4(17), VALUE_PTR_4(101), VALUE_PTR_4(255 - 3),
+};
+
+static size_t (*g_packed_relocs_strlen)(const char*) = strlen;
+static void* (*g_packed_relocs_malloc)(size_t) = malloc;
+static void (*g_packed_relocs_free)(void*) = free;
+
+extern "C" bool dlopen_testlib_packed_relocs_check() {
+  for (size_t i = 0; i < 256; ++i) {
+    if (g_packed_relocs_value_ptrs[i] != &g_packed_relocs_values[i]) {
+      return false;
+    }
+  }
+
+  static const int offsets[] = { 1, 17, 101, 252 };
+  for (size_t i = 0; i < 16; ++i) {
+    if (g_packed_relocs_offset_ptrs[i] != &g_packed_relocs_values[offsets[i / 4] + i % 4]) {
+      return false;
+    }
+  }
+
+  void* p = g_packed_relocs_malloc(4);
+  g_packed_relocs_free(p);
+  return p != nullptr && g_packed_relocs_strlen("packed") == 6;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A malloc backend for LIBC_MALLOC_BACKEND: every allocation gets its own
+// mapping. It must not depend on anything but libc, so no C++ runtime.
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "private/bionic_config.h"
+
+extern "C" {
+// How many allocations went through this backend.
+size_t malloc_backend_allocations = 0;
+}
+
+namespace {
+
+// Just before every allocation.
+struct Header {
+  void* map_base;
+  size_t map_size;
+  size_t size;
+  size_t padding;
+};
+
+Header* GetHeader(void* ptr) {
+  return reinterpret_cast<Header*>(ptr) - 1;
+}
+
+void* Allocate(size_t alignment, size_t size) {
+  if (alignment < sizeof(Header)) {
+    alignment = sizeof(Header);
+  }
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  if (size > SIZE_MAX - alignment - sizeof(Header) - page_size) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  size_t map_size = (sizeof(Header) + alignment + size + page_size - 1) & ~(page_size - 1);
+  void* map_base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map_base == MAP_FAILED) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+
+  uintptr_t ptr = reinterpret_cast<uintptr_t>(map_base) + sizeof(Header);
+  ptr = (ptr + alignment - 1) & ~(alignment - 1);
+  Header* header = GetHeader(reinterpret_cast<void*>(ptr));
+  header->map_base = map_base;
+  header->map_size = map_size;
+  header->size = size;
+  __atomic_fetch_add(&malloc_backend_allocations, 1, __ATOMIC_RELAXED);
+  return reinterpret_cast<void*>(ptr);
+}
+
+void* BackendMalloc(size_t size) {
+  return Allocate(sizeof(Header), size);
+}
+
+void* BackendCalloc(size_t n, size_t size) {
+  if (size != 0 && n > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  // Fresh anonymous mappings are already zeroed.
+  return Allocate(sizeof(Header), n * size);
+}
+
+void BackendFree(void* ptr) {
+  if (ptr != nullptr) {
+    Header* header = GetHeader(ptr);
+    munmap(header->map_base, header->map_size);
+  }
+}
+
+struct mallinfo BackendMallinfo() {
+  struct mallinfo info;
+  memset(&info, 0, sizeof(info));
+  return info;
+}
+
+size_t BackendMallocUsableSize(const void* ptr) {
+  return GetHeader(const_cast<void*>(ptr))->size;
+}
+
+void* BackendMemalign(size_t alignment, size_t size) {
+  // memalign rounds up alignments that aren't powers of two.
+  size_t power_of_two = 1;
+  while (power_of_two < alignment) {
+    power_of_two <<= 1;
+  }
+  return Allocate(power_of_two, size);
+}
+
+int BackendPosixMemalign(void** memptr, size_t alignment, size_t size) {
+  if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  void* ptr = Allocate(alignment, size);
+  if (ptr == nullptr) {
+    return ENOMEM;
+  }
+  *memptr = ptr;
+  return 0;
+}
+
+void* BackendRealloc(void* ptr, size_t size) {
+  if (ptr == nullptr) {
+    return BackendMalloc(size);
+  }
+  if (size == 0) {
+    BackendFree(ptr);
+    return nullptr;
+  }
+  void* new_ptr = BackendMalloc(size);
+  if (new_ptr != nullptr) {
+    size_t old_size = GetHeader(ptr)->size;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    BackendFree(ptr);
+  }
+  return new_ptr;
+}
+
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+void* BackendValloc(size_t size) {
+  return Allocate(sysconf(_SC_PAGESIZE), size);
+}
+
+void* BackendPvalloc(size_t size) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  return Allocate(page_size, (size + page_size - 1) & ~(page_size - 1));
+}
+#endif
+
+}  // namespace
+
+extern "C" {
+
+// Laid out like libc's MallocDebug.
+struct {
+  void* (*calloc)(size_t, size_t);
+  void (*free)(void*);
+  struct mallinfo (*mallinfo)();
+  void* (*malloc)(size_t);
+  size_t (*malloc_usable_size)(const void*);
+  void* (*memalign)(size_t, size_t);
+  int (*posix_memalign)(void**, size_t, size_t);
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  void* (*pvalloc)(size_t);
+#endif
+  void* (*realloc)(void*, size_t);
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  void* (*valloc)(size_t);
+#endif
+} malloc_backend_dispatch = {
+  BackendCalloc,
+  BackendFree,
+  BackendMallinfo,
+  BackendMalloc,
+  BackendMallocUsableSize,
+  BackendMemalign,
+  BackendPosixMemalign,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  BackendPvalloc,
+#endif
+  BackendRealloc,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  BackendValloc,
+#endif
+};
+
+}  // extern "C"
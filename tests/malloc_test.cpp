@@ -16,15 +16,24 @@
 
 #include <gtest/gtest.h>
 
+#include <dlfcn.h>
 #include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
+#include <pthread.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <map>
+#include <string>
+
 #include <tinyxml2.h>
 
 #include "private/bionic_config.h"
+#include "TemporaryFile.h"
 
 TEST(malloc, malloc_std) {
   // Simple malloc test.
@@ -340,12 +349,35 @@ TEST(malloc, malloc_info) {
   auto root = doc.FirstChildElement();
   ASSERT_NE(nullptr, root);
   ASSERT_STREQ("malloc", root->Name());
+#if defined(USE_DLMALLOC)
+  ASSERT_STREQ("dlmalloc-1", root->Attribute("version"));
+#else
   ASSERT_STREQ("jemalloc-1", root->Attribute("version"));
+#endif
 
   auto arena = root->FirstChildElement();
   for (; arena != nullptr; arena = arena->NextSiblingElement()) {
     int val;
 
+    if (strcmp(arena->Name(), "total") == 0) {
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("allocated")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("free")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("mapped")->QueryIntText(&val));
+      continue;
+    }
+
+    if (strcmp(arena->Name(), "thread-cache") == 0) {
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("threads")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS,
+                arena->FirstChildElement("cached-blocks")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS,
+                arena->FirstChildElement("cached-bytes")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("hits")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("misses")->QueryIntText(&val));
+      ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->FirstChildElement("released")->QueryIntText(&val));
+      continue;
+    }
+
     ASSERT_STREQ("heap", arena->Name());
     ASSERT_EQ(tinyxml2::XML_SUCCESS, arena->QueryIntAttribute("nr", &val));
     ASSERT_EQ(tinyxml2::XML_SUCCESS,
@@ -372,3 +404,496 @@ TEST(malloc, malloc_info) {
   }
 #endif
 }
+
+#if defined(__BIONIC__) && defined(USE_DLMALLOC)
+static size_t g_cached_blocks_before;
+static size_t g_cached_blocks_after;
+
+static void* CacheSmallBlocks(void*) {
+  void* blocks[16];
+  g_cached_blocks_before = mallinfo().smblks;
+  for (size_t i = 0; i < 16; ++i) {
+    blocks[i] = malloc(32);
+  }
+  for (size_t i = 0; i < 16; ++i) {
+    free(blocks[i]);
+  }
+  g_cached_blocks_after = mallinfo().smblks;
+  return nullptr;
+}
+#endif
+
+TEST(malloc, dlmalloc_thread_cache) {
+#if defined(__BIONIC__) && defined(USE_DLMALLOC)
+  pthread_t t;
+  ASSERT_EQ(0, pthread_create(&t, nullptr, CacheSmallBlocks, nullptr));
+  ASSERT_EQ(0, pthread_join(t, nullptr));
+
+  // The freed blocks stay in the thread's cache until it exits.
+  ASSERT_EQ(g_cached_blocks_before + 16, g_cached_blocks_after);
+  ASSERT_LE(mallinfo().smblks + 16, g_cached_blocks_after);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing without dlmalloc.\n";
+#endif
+}
+
+#if defined(__BIONIC__) && defined(USE_DLMALLOC)
+extern "C" int dlmalloc_trim(size_t);
+
+// A thread that caches 16 blocks, then waits to be told to do one more
+// allocation (writing the number of cached blocks after it) or to exit.
+struct IdleCacheThread {
+  int go[2];
+  int done[2];
+  pthread_t thread;
+
+  static void* Run(void* arg) {
+    IdleCacheThread* self = reinterpret_cast<IdleCacheThread*>(arg);
+    CacheSmallBlocks(nullptr);
+    size_t cached = g_cached_blocks_after;
+    write(self->done[1], &cached, sizeof(cached));
+
+    char command;
+    while (read(self->go[0], &command, 1) == 1 && command == 'a') {
+      free(malloc(32));
+      cached = mallinfo().smblks;
+      write(self->done[1], &cached, sizeof(cached));
+    }
+    return nullptr;
+  }
+
+  void Start() {
+    ASSERT_EQ(0, pipe(go));
+    ASSERT_EQ(0, pipe(done));
+    ASSERT_EQ(0, pthread_create(&thread, nullptr, Run, this));
+    size_t cached;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(cached)), read(done[0], &cached, sizeof(cached)));
+  }
+
+  size_t Allocate() {
+    size_t cached = 0;
+    write(go[1], "a", 1);
+    read(done[0], &cached, sizeof(cached));
+    return cached;
+  }
+
+  void Stop() {
+    write(go[1], "x", 1);
+    pthread_join(thread, nullptr);
+    close(go[0]);
+    close(go[1]);
+    close(done[0]);
+    close(done[1]);
+  }
+};
+#endif
+
+TEST(malloc, dlmalloc_thread_cache_trim) {
+#if defined(__BIONIC__) && defined(USE_DLMALLOC)
+  IdleCacheThread idle;
+  ASSERT_NO_FATAL_FAILURE(idle.Start());
+  size_t cached = mallinfo().smblks;
+
+  // An idle thread can't drain its cache, but does so on its next call.
+  dlmalloc_trim(0);
+  ASSERT_LE(16U, mallinfo().smblks);
+  ASSERT_GE(cached - 16 + 1, idle.Allocate());
+
+  idle.Stop();
+#else
+  GTEST_LOG_(INFO) << "This test does nothing without dlmalloc.\n";
+#endif
+}
+
+TEST(malloc, dlmalloc_thread_cache_fork) {
+#if defined(__BIONIC__) && defined(USE_DLMALLOC)
+  IdleCacheThread idle;
+  ASSERT_NO_FATAL_FAILURE(idle.Start());
+  size_t cached = mallinfo().smblks;
+
+  // The child doesn't have the thread, nor the blocks it cached.
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    _exit((mallinfo().smblks + 16 <= cached) ? 0 : 1);
+  }
+
+  int status;
+  ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  idle.Stop();
+#else
+  GTEST_LOG_(INFO) << "This test does nothing without dlmalloc.\n";
+#endif
+}
+
+// Run by malloc.backend_from_environment, with LIBC_MALLOC_BACKEND=dlmalloc.
+TEST(malloc, DISABLED_dlmalloc_backend) {
+  free(malloc(32));
+
+  char* buf;
+  size_t bufsize;
+  FILE* memstream = open_memstream(&buf, &bufsize);
+  ASSERT_NE(nullptr, memstream);
+  ASSERT_EQ(0, malloc_info(0, memstream));
+  ASSERT_EQ(0, fclose(memstream));
+
+  // dlmalloc's totals and thread cache show up there, jemalloc's arenas don't.
+  ASSERT_TRUE(strstr(buf, "<malloc version=\"dlmalloc-1\">") != nullptr) << buf;
+  ASSERT_TRUE(strstr(buf, "<total>") != nullptr) << buf;
+  ASSERT_TRUE(strstr(buf, "<thread-cache>") != nullptr) << buf;
+  ASSERT_TRUE(strstr(buf, "<heap") == nullptr) << buf;
+  free(buf);
+}
+
+#if defined(__BIONIC__)
+// Runs |test| in a child with the environment variable |name| set to |value|.
+static void RunWithEnv(const char* name, const char* value, const char* test) {
+  std::string filter = std::string("--gtest_filter=malloc.") + test;
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    setenv(name, value, 1);
+    execl("/proc/self/exe", "/proc/self/exe", "--no-isolate", "--gtest_also_run_disabled_tests",
+          filter.c_str(), nullptr);
+    _exit(1);
+  }
+
+  int status;
+  ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+// The allocator can't be changed, nor debugged, in static executables.
+static bool HasDynamicLibc() {
+  void* libc = dlopen("libc.so", RTLD_NOW | RTLD_NOLOAD);
+  if (libc == nullptr) {
+    GTEST_LOG_(INFO) << "This test does nothing in static executables.\n";
+    return false;
+  }
+  dlclose(libc);
+  return true;
+}
+#endif
+
+TEST(malloc, backend_from_environment) {
+#if defined(__BIONIC__)
+  if (HasDynamicLibc()) {
+    RunWithEnv("LIBC_MALLOC_BACKEND", "dlmalloc", "DISABLED_dlmalloc_backend");
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+// Run by malloc.shared_object_backend, with LIBC_MALLOC_BACKEND set to
+// libtest_malloc_backend.so.
+TEST(malloc, DISABLED_shared_object_backend) {
+  void* handle = dlopen("libtest_malloc_backend.so", RTLD_NOW | RTLD_NOLOAD);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  size_t* allocations = reinterpret_cast<size_t*>(dlsym(handle, "malloc_backend_allocations"));
+  ASSERT_TRUE(allocations != nullptr) << dlerror();
+
+  // Everything allocated before the test started, by gtest included, came
+  // from there too.
+  size_t allocations_before = *allocations;
+  ASSERT_NE(0U, allocations_before);
+  char* p = reinterpret_cast<char*>(malloc(100));
+  ASSERT_TRUE(p != nullptr);
+  ASSERT_EQ(allocations_before + 1, *allocations);
+  ASSERT_EQ(100U, malloc_usable_size(p));
+  memset(p, 'x', 100);
+
+  p = reinterpret_cast<char*>(realloc(p, 5000));
+  ASSERT_TRUE(p != nullptr);
+  ASSERT_EQ(5000U, malloc_usable_size(p));
+  ASSERT_EQ('x', p[99]);
+  free(p);
+
+  void* aligned = memalign(4096, 10);
+  ASSERT_TRUE(aligned != nullptr);
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(aligned) % 4096);
+  free(aligned);
+
+  ASSERT_EQ(allocations_before + 3, *allocations);
+
+  // Only the backend's mallinfo() totals are reported.
+  char* buf;
+  size_t bufsize;
+  FILE* memstream = open_memstream(&buf, &bufsize);
+  ASSERT_NE(nullptr, memstream);
+  ASSERT_EQ(0, malloc_info(0, memstream));
+  ASSERT_EQ(0, fclose(memstream));
+  ASSERT_TRUE(strstr(buf, "<malloc version=\"malloc-1\"><total>") != nullptr) << buf;
+  ASSERT_TRUE(strstr(buf, "<heap") == nullptr) << buf;
+  ASSERT_TRUE(strstr(buf, "<thread-cache>") == nullptr) << buf;
+  free(buf);
+
+  dlclose(handle);
+}
+
+TEST(malloc, shared_object_backend) {
+#if defined(__BIONIC__)
+  if (HasDynamicLibc()) {
+    RunWithEnv("LIBC_MALLOC_BACKEND", "libtest_malloc_backend.so",
+               "DISABLED_shared_object_backend");
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+// Run by malloc.shared_object_backend_with_dependency, with
+// LIBC_MALLOC_BACKEND set to libtest_malloc_backend_with_dependency.so.
+TEST(malloc, DISABLED_shared_object_backend_with_dependency) {
+  free(malloc(32));
+
+  // Rejected and unloaded, or at least never allocated from.
+  void* handle = dlopen("libtest_malloc_backend_with_dependency.so", RTLD_NOW);
+  ASSERT_TRUE(handle != nullptr) << dlerror();
+  size_t* allocations = reinterpret_cast<size_t*>(dlsym(handle, "malloc_backend_allocations"));
+  ASSERT_TRUE(allocations != nullptr) << dlerror();
+  ASSERT_EQ(0U, *allocations);
+  dlclose(handle);
+}
+
+TEST(malloc, shared_object_backend_with_dependency) {
+#if defined(__BIONIC__)
+  if (HasDynamicLibc()) {
+    RunWithEnv("LIBC_MALLOC_BACKEND", "libtest_malloc_backend_with_dependency.so",
+               "DISABLED_shared_object_backend_with_dependency");
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+#if defined(__BIONIC__)
+extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overall_size, size_t* info_size,
+                                     size_t* total_memory, size_t* backtrace_size);
+extern "C" void free_malloc_leak_info(uint8_t* info);
+
+static constexpr size_t kLeakThreads = 4;
+static constexpr size_t kLeakSizesPerThread = 100;
+static constexpr size_t kLeakFirstSize = 12345;
+
+struct LeakThreadArg {
+  size_t first_size;
+  // One block of each size, and a second one of the first size.
+  void* blocks[kLeakSizesPerThread + 1];
+};
+
+// Every block comes from the same call site, so that a thread's records only
+// differ by size and all land in the same stripe of the leak table.
+static void* AllocateLeakBlocks(void* data) {
+  LeakThreadArg* arg = reinterpret_cast<LeakThreadArg*>(data);
+  for (size_t i = 0; i <= kLeakSizesPerThread; ++i) {
+    arg->blocks[i] = malloc(arg->first_size + (i % kLeakSizesPerThread));
+  }
+  return nullptr;
+}
+
+// Adds up the allocations of each size in get_malloc_leak_info()'s records,
+// checking that they are sorted by total size, then by allocations.
+static void GetLeakAllocations(std::map<size_t, size_t>* allocations, size_t* total_memory) {
+  uint8_t* info;
+  size_t overall_size, info_size, backtrace_size;
+  get_malloc_leak_info(&info, &overall_size, &info_size, total_memory, &backtrace_size);
+  ASSERT_TRUE(info != nullptr);
+  ASSERT_EQ(2 * sizeof(size_t) + backtrace_size * sizeof(uintptr_t), info_size);
+  ASSERT_EQ(0U, overall_size % info_size);
+
+  allocations->clear();
+  size_t previous_total = SIZE_MAX;
+  size_t previous_count = SIZE_MAX;
+  for (size_t offset = 0; offset < overall_size; offset += info_size) {
+    const size_t* record = reinterpret_cast<const size_t*>(info + offset);
+    // Without the zygote child flag.
+    size_t size = record[0] & ~(static_cast<size_t>(1) << 31);
+    size_t count = record[1];
+    ASSERT_NE(0U, count);
+    ASSERT_TRUE(size * count < previous_total ||
+                (size * count == previous_total && count <= previous_count))
+        << "record " << offset / info_size << " is out of order";
+    previous_total = size * count;
+    previous_count = count;
+    (*allocations)[size] += count;
+  }
+  free_malloc_leak_info(info);
+}
+#endif
+
+// Run by malloc.leak_info, with LIBC_DEBUG_MALLOC=1.
+TEST(malloc, DISABLED_leak_info) {
+#if defined(__BIONIC__)
+  LeakThreadArg args[kLeakThreads];
+  pthread_t threads[kLeakThreads];
+  for (size_t i = 0; i < kLeakThreads; ++i) {
+    args[i].first_size = kLeakFirstSize + i * kLeakSizesPerThread;
+    ASSERT_EQ(0, pthread_create(&threads[i], nullptr, AllocateLeakBlocks, &args[i]));
+  }
+  for (size_t i = 0; i < kLeakThreads; ++i) {
+    ASSERT_EQ(0, pthread_join(threads[i], nullptr));
+  }
+
+  // Each thread's stripe held more than HASHTABLE_MIN_BUCKETS entries, so it
+  // was resized along the way; nothing may have been lost.
+  const size_t last_size = kLeakFirstSize + kLeakThreads * kLeakSizesPerThread;
+  std::map<size_t, size_t> allocations;
+  size_t total_before;
+  ASSERT_NO_FATAL_FAILURE(GetLeakAllocations(&allocations, &total_before));
+  for (size_t size = kLeakFirstSize; size < last_size; ++size) {
+    size_t expected = ((size - kLeakFirstSize) % kLeakSizesPerThread == 0) ? 2 : 1;
+    ASSERT_EQ(expected, allocations[size]) << size;
+  }
+
+  // Free the second block of every first size, and every odd size.
+  size_t freed_bytes = 0;
+  for (size_t i = 0; i < kLeakThreads; ++i) {
+    for (size_t j = 0; j <= kLeakSizesPerThread; ++j) {
+      size_t size = args[i].first_size + (j % kLeakSizesPerThread);
+      if (j == kLeakSizesPerThread || size % 2 == 1) {
+        free(args[i].blocks[j]);
+        args[i].blocks[j] = nullptr;
+        freed_bytes += size;
+      }
+    }
+  }
+
+  size_t total_after;
+  ASSERT_NO_FATAL_FAILURE(GetLeakAllocations(&allocations, &total_after));
+  for (size_t size = kLeakFirstSize; size < last_size; ++size) {
+    ASSERT_EQ((size % 2 == 1) ? 0U : 1U, allocations[size]) << size;
+  }
+  ASSERT_LE(total_after + freed_bytes / 2, total_before);
+
+  for (size_t i = 0; i < kLeakThreads; ++i) {
+    for (size_t j = 0; j <= kLeakSizesPerThread; ++j) {
+      free(args[i].blocks[j]);
+    }
+  }
+  ASSERT_NO_FATAL_FAILURE(GetLeakAllocations(&allocations, &total_after));
+  for (size_t size = kLeakFirstSize; size < last_size; ++size) {
+    ASSERT_EQ(0U, allocations[size]) << size;
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+TEST(malloc, leak_info) {
+#if defined(__BIONIC__)
+  if (HasDynamicLibc()) {
+    RunWithEnv("LIBC_DEBUG_MALLOC", "1", "DISABLED_leak_info");
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+#if defined(__BIONIC__)
+extern "C" int write_malloc_sample_profile(int fd);
+#endif
+
+TEST(malloc, write_malloc_sample_profile_not_sampling) {
+#if defined(__BIONIC__)
+  // The profile only exists with libc.debug.malloc set to 50.
+  errno = 0;
+  ASSERT_EQ(-1, write_malloc_sample_profile(STDOUT_FILENO));
+  ASSERT_EQ(ENOTSUP, errno);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+// Run by malloc.sample_profile, with LIBC_DEBUG_MALLOC=50.
+TEST(malloc, DISABLED_sample_profile) {
+#if defined(__BIONIC__)
+  // At the default interval of 512KiB, an allocation of 3MiB is sampled with
+  // a probability of 1 - e^-6, so some of each of these sets are.
+  static constexpr size_t kKeptSize = 3 * 1024 * 1024;
+  static constexpr size_t kFreedSize = 4 * 1024 * 1024;
+  static constexpr size_t kBlockCount = 32;
+  void* kept[kBlockCount];
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    kept[i] = malloc(kKeptSize + i);
+    ASSERT_TRUE(kept[i] != nullptr);
+  }
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    free(malloc(kFreedSize + i));
+  }
+  // Many more samples than the history holds; the live ones must stay.
+  for (size_t i = 0; i < 8192; ++i) {
+    free(malloc(kKeptSize * 2));
+  }
+
+  TemporaryFile tf;
+  ASSERT_EQ(0, write_malloc_sample_profile(tf.fd));
+  ASSERT_EQ(0, lseek(tf.fd, 0, SEEK_SET));
+  std::string profile;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(tf.fd, buf, sizeof(buf))) > 0) {
+    profile.append(buf, n);
+  }
+
+  ASSERT_EQ(0U, profile.find("heap profile: ")) << profile;
+  ASSERT_NE(std::string::npos, profile.find(" @ heap_v2/")) << profile;
+
+  size_t kept_live = 0;
+  size_t freed_live = 0;
+  for (size_t line = profile.find('\n'); line != std::string::npos;
+       line = profile.find('\n', line + 1)) {
+    size_t live_count, live_bytes;
+    if (sscanf(profile.c_str() + line + 1, "%zu: %zu [", &live_count, &live_bytes) != 2 ||
+        live_count == 0) {
+      continue;
+    }
+    if (live_bytes >= kKeptSize && live_bytes < kKeptSize + kBlockCount) {
+      kept_live++;
+    } else if (live_bytes >= kFreedSize) {
+      // One of the freed blocks, or of the ones allocated after them.
+      freed_live++;
+    }
+  }
+  ASSERT_NE(0U, kept_live) << profile;
+  ASSERT_EQ(0U, freed_live) << profile;
+
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    free(kept[i]);
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
+
+TEST(malloc, sample_profile) {
+#if defined(__BIONIC__)
+  // The debug levels aren't available in static executables.
+  void* libc = dlopen("libc.so", RTLD_NOW | RTLD_NOLOAD);
+  if (libc == nullptr) {
+    GTEST_LOG_(INFO) << "This test does nothing in static executables.\n";
+    return;
+  }
+  dlclose(libc);
+
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    setenv("LIBC_DEBUG_MALLOC", "50", 1);
+    execl("/proc/self/exe", "/proc/self/exe", "--no-isolate", "--gtest_also_run_disabled_tests",
+          "--gtest_filter=malloc.DISABLED_sample_profile", nullptr);
+    _exit(1);
+  }
+
+  int status;
+  ASSERT_EQ(pid, TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+#else
+  GTEST_LOG_(INFO) << "This test does nothing for glibc.\n";
+#endif
+}
@@ -24,14 +24,16 @@ include $(CLEAR_VARS)
 LOCAL_CPP_EXTENSION := .cc
 
 LOCAL_SRC_FILES := \
+  src/batch.cc \
   src/debug.cc \
   src/delta_encoder.cc \
   src/elf_file.cc \
   src/packer.cc \
+  src/relr_encoder.cc \
   src/sleb128.cc \
 
 LOCAL_STATIC_LIBRARIES := libelf
-LOCAL_C_INCLUDES := external/elfutils/src/libelf
+LOCAL_C_INCLUDES := external/elfutils/src/libelf libnativehelper/include
 LOCAL_MODULE := lib_relocation_packer
 
 LOCAL_CPPFLAGS := $(common_cppflags)
@@ -49,11 +51,12 @@ LOCAL_STATIC_LIBRARIES := lib_relocation_packer libelf
 
 # Statically linking libc++ to make it work from prebuilts
 LOCAL_CXX_STL := libc++_static
-LOCAL_C_INCLUDES := external/elfutils/src/libelf libnativehelper/include
+LOCAL_C_INCLUDES := external/elfutils/src/libelf
 
 LOCAL_MODULE := relocation_packer
 
 LOCAL_CPPFLAGS := $(common_cppflags)
+LOCAL_LDLIBS := -lpthread
 
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 
@@ -64,16 +67,19 @@ include $(CLEAR_VARS)
 LOCAL_CPP_EXTENSION := .cc
 
 LOCAL_SRC_FILES := \
+  src/batch_unittest.cc \
   src/debug_unittest.cc \
   src/delta_encoder_unittest.cc \
   src/elf_file_unittest.cc \
   src/sleb128_unittest.cc \
   src/packer_unittest.cc \
+  src/relr_encoder_unittest.cc \
 
 LOCAL_STATIC_LIBRARIES := lib_relocation_packer libelf
 LOCAL_C_INCLUDES := external/elfutils/src/libelf
 
 LOCAL_CPPFLAGS := $(common_cppflags)
+LOCAL_LDLIBS := -lpthread
 
 LOCAL_MODULE := relocation_packer_unit_tests
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batch.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "debug.h"
+#include "elf_file.h"
+#include "elf_traits.h"
+
+#include "nativehelper/ScopedFd.h"
+
+namespace relocation_packer {
+
+template <typename ELF>
+static bool ProcessElfFile(int fd, const Options& options, FileResult* result) {
+  ElfFile<ELF> elf_file(fd);
+  elf_file.SetPadding(options.is_padding);
+  elf_file.SetRelr(options.is_relr);
+  elf_file.SetGroupingSearch(options.grouping_search);
+
+  if (options.is_unpacking) {
+    return elf_file.UnpackRelocations();
+  }
+
+  const bool status = elf_file.PackRelocations();
+  const auto& stats = elf_file.GetPackStats();
+  result->relocation_count = stats.relocation_count;
+  result->unpacked_bytes = stats.unpacked_bytes;
+  result->packed_bytes = stats.packed_bytes;
+  result->decode_ns = stats.decode_ns;
+  return status;
+}
+
+bool ProcessFile(const Options& options, FileResult* result) {
+  const char* file = result->path.c_str();
+  ScopedFd fd(open(file, O_RDWR));
+  if (fd.get() == -1) {
+    LOG(ERROR) << file << ": " << strerror(errno);
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd.get(), &file_stat) == 0) {
+    result->size_before = file_stat.st_size;
+  }
+
+  // We need to detect elf class in order to create
+  // correct implementation
+  uint8_t e_ident[EI_NIDENT];
+  if (TEMP_FAILURE_RETRY(read(fd.get(), e_ident, EI_NIDENT) != EI_NIDENT)) {
+    LOG(ERROR) << file << ": failed to read elf header:" << strerror(errno);
+    return false;
+  }
+
+  if (TEMP_FAILURE_RETRY(lseek(fd.get(), 0, SEEK_SET)) != 0) {
+    LOG(ERROR) << file << ": lseek to 0 failed:" << strerror(errno);
+    return false;
+  }
+
+  bool status = false;
+
+  if (e_ident[EI_CLASS] == ELFCLASS32) {
+    status = ProcessElfFile<ELF32_traits>(fd.get(), options, result);
+  } else if (e_ident[EI_CLASS] == ELFCLASS64) {
+    status = ProcessElfFile<ELF64_traits>(fd.get(), options, result);
+  } else {
+    LOG(ERROR) << file << ": unknown ELFCLASS: " << e_ident[EI_CLASS];
+    return false;
+  }
+
+  if (!status) {
+    LOG(ERROR) << file << ": failed to pack/unpack file";
+    return false;
+  }
+
+  if (fstat(fd.get(), &file_stat) == 0) {
+    result->size_after = file_stat.st_size;
+  }
+  return true;
+}
+
+bool CollectFiles(const char* path, std::vector<std::string>* files) {
+  struct stat path_stat;
+  if (stat(path, &path_stat) != 0) {
+    LOG(ERROR) << path << ": " << strerror(errno);
+    return false;
+  }
+
+  if (!S_ISDIR(path_stat.st_mode)) {
+    files->push_back(path);
+    return true;
+  }
+
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    LOG(ERROR) << path << ": " << strerror(errno);
+    return false;
+  }
+
+  std::vector<std::string> found;
+  dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const size_t length = strlen(entry->d_name);
+    if (length <= 3 || strcmp(entry->d_name + length - 3, ".so") != 0) {
+      continue;
+    }
+
+    std::string file = std::string(path) + "/" + entry->d_name;
+    struct stat file_stat;
+    if (lstat(file.c_str(), &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+      found.push_back(file);
+    }
+  }
+  closedir(dir);
+
+  std::sort(found.begin(), found.end());
+  files->insert(files->end(), found.begin(), found.end());
+  return true;
+}
+
+bool ProcessFiles(const Options& options, const std::vector<std::string>& files,
+                  size_t jobs, std::vector<FileResult>* results) {
+  // The files are already processed in parallel; a thread per grouping
+  // strategy on top of that would only oversubscribe the cpus.
+  Options file_options = options;
+  if (file_options.grouping_search == GROUPING_SEARCH_THREADED) {
+    file_options.grouping_search = GROUPING_SEARCH;
+  }
+
+  results->assign(files.size(), FileResult());
+  std::atomic<size_t> next_file(0);
+  auto worker = [&]() {
+    for (size_t i = next_file++; i < files.size(); i = next_file++) {
+      FileResult& result = (*results)[i];
+      result.path = files[i];
+      result.status = ProcessFile(file_options, &result);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(jobs, files.size()); ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& result : *results) {
+    if (!result.status) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PrintReport(FILE* out, const std::vector<FileResult>& results, bool is_unpacking) {
+  if (is_unpacking) {
+    fprintf(out, "%-48s %12s %12s\n", "# file", "size", "unpacked");
+  } else {
+    fprintf(out, "%-48s %12s %12s %10s %12s %12s %10s\n", "# file", "size", "packed",
+            "relocs", "relocs_size", "packed_size", "decode_us");
+  }
+
+  off_t total_before = 0;
+  off_t total_after = 0;
+  for (const auto& result : results) {
+    if (!result.status) {
+      fprintf(out, "%-48s failed\n", result.path.c_str());
+      continue;
+    }
+
+    total_before += result.size_before;
+    total_after += result.size_after;
+    if (is_unpacking) {
+      fprintf(out, "%-48s %12jd %12jd\n", result.path.c_str(),
+              static_cast<intmax_t>(result.size_before), static_cast<intmax_t>(result.size_after));
+    } else {
+      fprintf(out, "%-48s %12jd %12jd %10zu %12zu %12zu %10.1f\n", result.path.c_str(),
+              static_cast<intmax_t>(result.size_before), static_cast<intmax_t>(result.size_after),
+              result.relocation_count, result.unpacked_bytes, result.packed_bytes,
+              result.decode_ns / 1000.0);
+    }
+  }
+
+  fprintf(out, "%-48s %12jd %12jd\n", "# total",
+          static_cast<intmax_t>(total_before), static_cast<intmax_t>(total_after));
+}
+
+}  // namespace relocation_packer
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Packing or unpacking files one by one or in a batch.
+//
+// CollectFiles() expands the command line arguments, ProcessFiles() packs
+// or unpacks the files with a number of worker threads, and PrintReport()
+// says what happened to each of them.
+
+#ifndef TOOLS_RELOCATION_PACKER_SRC_BATCH_H_
+#define TOOLS_RELOCATION_PACKER_SRC_BATCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#include "packer.h"
+
+namespace relocation_packer {
+
+struct Options {
+  bool is_unpacking;
+  bool is_padding;
+  bool is_relr;
+  GroupingSearch grouping_search;
+};
+
+// What happened to one file, for the batch report.
+struct FileResult {
+  std::string path;
+  bool status;
+  off_t size_before;
+  off_t size_after;
+  size_t relocation_count;
+  size_t unpacked_bytes;
+  size_t packed_bytes;
+  uint64_t decode_ns;
+};
+
+// Pack or unpack the file at result->path, and fill in the rest of |result|.
+// Returns true on success.
+bool ProcessFile(const Options& options, FileResult* result);
+
+// Append |path| to |files| if it is a file, or the regular *.so files
+// directly inside it, sorted, if it is a directory.  Returns false if |path|
+// cannot be read.
+bool CollectFiles(const char* path, std::vector<std::string>* files);
+
+// Process |files| with up to |jobs| threads.  |results| is resized to match
+// |files|.  Returns true if every file was processed successfully.
+bool ProcessFiles(const Options& options, const std::vector<std::string>& files,
+                  size_t jobs, std::vector<FileResult>* results);
+
+// Print a line per file, and the totals, to |out|.
+void PrintReport(FILE* out, const std::vector<FileResult>& results, bool is_unpacking);
+
+}  // namespace relocation_packer
+
+#endif  // TOOLS_RELOCATION_PACKER_SRC_BATCH_H_
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batch.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "libelf.h"
+
+namespace {
+
+std::string GetDataFilePath(const char* name) {
+  const char* bindir = getenv("bindir");
+  if (bindir) {
+    return std::string(bindir) + "/" + name;
+  }
+
+  char path[PATH_MAX];
+  memset(path, 0, sizeof(path));
+  if (readlink("/proc/self/exe", path, sizeof(path) - 1) == -1) {
+    return name;
+  }
+
+  std::string data_dir(path);
+  data_dir.erase(data_dir.rfind('/'));
+  return data_dir + "/" + name;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+  std::ofstream out(path.c_str(), std::ios::binary);
+  out << contents;
+}
+
+// A directory that is removed, with everything directly in it, at the end
+// of the test.
+class ScopedTempDir {
+ public:
+  ScopedTempDir() {
+    char path[] = "/tmp/relocation_packer_test_XXXXXX";
+    path_ = mkdtemp(path) != NULL ? path : "";
+  }
+
+  ~ScopedTempDir() {
+    DIR* dir = opendir(path_.c_str());
+    if (dir == NULL) {
+      return;
+    }
+    dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+        const std::string file = path_ + "/" + entry->d_name;
+        if (unlink(file.c_str()) != 0) {
+          rmdir(file.c_str());
+        }
+      }
+    }
+    closedir(dir);
+    rmdir(path_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+}  // namespace
+
+namespace relocation_packer {
+
+TEST(Batch, CollectFiles) {
+  ScopedTempDir dir;
+  ASSERT_FALSE(dir.path().empty());
+
+  WriteFile(dir.path() + "/libb.so", "b");
+  WriteFile(dir.path() + "/liba.so", "a");
+  WriteFile(dir.path() + "/notes.txt", "not a library");
+  WriteFile(dir.path() + "/.so", "no name");
+  ASSERT_EQ(0, mkdir((dir.path() + "/libdir.so").c_str(), 0700));
+  ASSERT_EQ(0, symlink("liba.so", (dir.path() + "/liblink.so").c_str()));
+
+  // Only the regular *.so files directly in a directory, sorted; files
+  // named on the command line as they are.
+  std::vector<std::string> files;
+  const std::string notes = dir.path() + "/notes.txt";
+  ASSERT_TRUE(CollectFiles(notes.c_str(), &files));
+  ASSERT_TRUE(CollectFiles(dir.path().c_str(), &files));
+
+  ASSERT_EQ(3U, files.size());
+  EXPECT_EQ(notes, files[0]);
+  EXPECT_EQ(dir.path() + "/liba.so", files[1]);
+  EXPECT_EQ(dir.path() + "/libb.so", files[2]);
+
+  EXPECT_FALSE(CollectFiles((dir.path() + "/missing.so").c_str(), &files));
+  EXPECT_EQ(3U, files.size());
+}
+
+TEST(Batch, ProcessFilesAndReport) {
+  ASSERT_NE(static_cast<uint32_t>(EV_NONE), elf_version(EV_CURRENT));
+
+  ScopedTempDir dir;
+  ASSERT_FALSE(dir.path().empty());
+
+  const std::string arm32 = ReadFile(GetDataFilePath("elf_file_unittest_relocs_arm32.so"));
+  const std::string arm64 = ReadFile(GetDataFilePath("elf_file_unittest_relocs_arm64.so"));
+  ASSERT_FALSE(arm32.empty());
+  ASSERT_FALSE(arm64.empty());
+  WriteFile(dir.path() + "/arm32.so", arm32);
+  WriteFile(dir.path() + "/arm64.so", arm64);
+  WriteFile(dir.path() + "/broken.so", "not an elf file");
+
+  std::vector<std::string> files;
+  ASSERT_TRUE(CollectFiles(dir.path().c_str(), &files));
+  ASSERT_EQ(3U, files.size());
+
+  Options options = { false, false, false, GROUPING_DEFAULT };
+  std::vector<FileResult> results;
+  EXPECT_FALSE(ProcessFiles(options, files, 3, &results));
+  ASSERT_EQ(3U, results.size());
+
+  // Packed as by a run on each file alone.
+  EXPECT_EQ(ReadFile(GetDataFilePath("elf_file_unittest_relocs_arm32_packed.so")),
+            ReadFile(files[0]));
+  EXPECT_EQ(ReadFile(GetDataFilePath("elf_file_unittest_relocs_arm64_packed.so")),
+            ReadFile(files[1]));
+
+  for (size_t i = 0; i < 2; ++i) {
+    EXPECT_EQ(files[i], results[i].path);
+    EXPECT_TRUE(results[i].status);
+    EXPECT_LT(results[i].size_after, results[i].size_before);
+    EXPECT_NE(0U, results[i].relocation_count);
+    EXPECT_NE(0U, results[i].packed_bytes);
+    EXPECT_LT(results[i].packed_bytes, results[i].unpacked_bytes);
+  }
+  EXPECT_EQ(static_cast<off_t>(arm32.size()), results[0].size_before);
+  EXPECT_EQ(static_cast<off_t>(arm64.size()), results[1].size_before);
+  EXPECT_EQ(files[2], results[2].path);
+  EXPECT_FALSE(results[2].status);
+
+  FILE* report = tmpfile();
+  ASSERT_TRUE(report != NULL);
+  PrintReport(report, results, false);
+  rewind(report);
+
+  std::vector<std::string> lines;
+  char line[1024];
+  while (fgets(line, sizeof(line), report) != NULL) {
+    lines.push_back(line);
+  }
+  fclose(report);
+
+  ASSERT_EQ(5U, lines.size());
+  EXPECT_EQ(0U, lines[0].find("# file"));
+  for (size_t i = 0; i < 2; ++i) {
+    char path[PATH_MAX];
+    intmax_t before, after;
+    size_t count, unpacked_bytes, packed_bytes;
+    double decode_us;
+    ASSERT_EQ(7, sscanf(lines[i + 1].c_str(), "%s %jd %jd %zu %zu %zu %lf", path, &before,
+                        &after, &count, &unpacked_bytes, &packed_bytes, &decode_us));
+    EXPECT_EQ(files[i], path);
+    EXPECT_EQ(results[i].size_before, before);
+    EXPECT_EQ(results[i].size_after, after);
+    EXPECT_EQ(results[i].relocation_count, count);
+    EXPECT_EQ(results[i].unpacked_bytes, unpacked_bytes);
+    EXPECT_EQ(results[i].packed_bytes, packed_bytes);
+  }
+  EXPECT_EQ(0U, lines[3].find(files[2]));
+  EXPECT_NE(std::string::npos, lines[3].find(" failed"));
+
+  intmax_t total_before, total_after;
+  ASSERT_EQ(2, sscanf(lines[4].c_str(), "# total %jd %jd", &total_before, &total_after));
+  EXPECT_EQ(results[0].size_before + results[1].size_before, total_before);
+  EXPECT_EQ(results[0].size_after + results[1].size_after, total_after);
+
+  // And back.
+  files.pop_back();
+  options.is_unpacking = true;
+  EXPECT_TRUE(ProcessFiles(options, files, 2, &results));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ(arm32, ReadFile(files[0]));
+  EXPECT_EQ(arm64, ReadFile(files[1]));
+}
+
+}  // namespace relocation_packer
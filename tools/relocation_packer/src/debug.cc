@@ -6,10 +6,14 @@
 
 #include <stdlib.h>
 #include <iostream>
+#include <mutex>
 #include <string>
 
 namespace relocation_packer {
 
+// Serializes writes to the logging streams.
+static std::mutex g_stream_mutex;
+
 // Construct a new message logger.  Prints if level is less than or equal to
 // the level set with SetVerbose() and predicate is true.
 Logger::Logger(Severity severity, int level, bool predicate) {
@@ -21,8 +25,8 @@ Logger::Logger(Severity severity, int level, bool predicate) {
 // On destruction, flush and print the strings accumulated.  Abort if FATAL.
 Logger::~Logger() {
   if (predicate_) {
-    if (level_ <= max_level_) {
-      std::ostream* log = severity_ == INFO ? info_stream_ : error_stream_;
+    std::ostream* log = severity_ == INFO ? info_stream_ : error_stream_;
+    if (level_ <= max_level_ && log != NULL) {
       std::string tag;
       switch (severity_) {
         case INFO: tag = "INFO"; break;
@@ -31,6 +35,7 @@ Logger::~Logger() {
         case FATAL: tag = "FATAL"; break;
       }
       stream_.flush();
+      std::lock_guard<std::mutex> lock(g_stream_mutex);
       *log << tag << ": " << stream_.str() << std::endl;
     }
     if (severity_ == FATAL)
@@ -17,7 +17,9 @@
 //
 // CHECK(predicate) logs a FATAL error if predicate is false.
 // NOTREACHED() always aborts.
-// Log streams can be changed with SetStreams().  Logging is not thread-safe.
+// Log streams can be changed with SetStreams().  Messages are written to
+// them under a lock, so logging from several threads is safe, but changing
+// the verbosity or the streams is not.
 //
 
 #ifndef TOOLS_RELOCATION_PACKER_SRC_DEBUG_H_
@@ -50,7 +52,8 @@ class Logger {
   // this level are printed, others are discarded.  Static, not thread-safe.
   static void SetVerbose(int level) { max_level_ = level; }
 
-  // Set info and error logging streams.  Static, not thread-safe.
+  // Set info and error logging streams.  A NULL stream discards messages
+  // (FATAL still aborts).  Static, not thread-safe.
   static void SetStreams(std::ostream* info_stream,
                          std::ostream* error_stream) {
     info_stream_ = info_stream;
@@ -4,7 +4,11 @@
 
 #include "debug.h"
 
+#include <stdio.h>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 
 namespace relocation_packer {
@@ -98,6 +102,52 @@ TEST(Debug, VlogIf) {
   Logger::Reset();
 }
 
+TEST(Debug, NullStream) {
+  Logger::Reset();
+  std::ostringstream error;
+  Logger::SetStreams(NULL, &error);
+
+  LOG(INFO) << "INFO log message, SHOULD NOT PRINT";
+  LOG(ERROR) << "ERROR log message";
+
+  EXPECT_EQ("ERROR: ERROR log message\n", error.str());
+  Logger::Reset();
+}
+
+TEST(Debug, LogFromThreads) {
+  Logger::Reset();
+  std::ostringstream info;
+  std::ostringstream error;
+  Logger::SetStreams(&info, &error);
+
+  // Messages from several threads are never interleaved.
+  const int kThreads = 4;
+  const int kMessages = 1000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([i]() {
+      for (int j = 0; j < kMessages; ++j) {
+        LOG(INFO) << "thread " << i << " message " << j;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::istringstream lines(info.str());
+  std::string line;
+  int count = 0;
+  while (std::getline(lines, line)) {
+    int thread, message;
+    EXPECT_EQ(2, sscanf(line.c_str(), "INFO: thread %d message %d", &thread, &message)) << line;
+    ++count;
+  }
+  EXPECT_EQ(kThreads * kMessages, count);
+  EXPECT_EQ("", error.str());
+  Logger::Reset();
+}
+
 TEST(DebugDeathTest, Fatal) {
   ::testing::FLAGS_gtest_death_test_style = "threadsafe";
   Logger::Reset();
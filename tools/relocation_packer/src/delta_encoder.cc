@@ -34,7 +34,8 @@ namespace relocation_packer {
 // Encode relocations into a delta encoded (packed) representation.
 template <typename ELF>
 void RelocationDeltaCodec<ELF>::Encode(const std::vector<ElfRela>& relocations,
-                                       std::vector<ElfAddr>* packed) {
+                                       std::vector<ElfAddr>* packed,
+                                       uint32_t no_addend_weight) {
   if (relocations.size() == 0)
     return;
 
@@ -61,8 +62,8 @@ void RelocationDeltaCodec<ELF>::Encode(const std::vector<ElfRela>& relocations,
 
     ElfAddr group_size = 0;
 
-    DetectGroup(relocations, group_start, previous_offset, &group_size, &group_flags,
-        &group_offset_delta, &group_info, &group_addend);
+    DetectGroup(relocations, group_start, previous_offset, no_addend_weight, &group_size,
+        &group_flags, &group_offset_delta, &group_info, &group_addend);
 
     // write the group header
     packed->push_back(group_size);
@@ -222,13 +223,13 @@ void RelocationDeltaCodec<ELF>::DetectGroupFields(const ElfRela& reloc_one,
 
 // This function is used to detect if there is better group available
 // during RelocationDeltaCodec<ELF>::DetectGroup processing.
-// Current implementation prefers having groups without addend (== zero addend)
+// By default it prefers having groups without addend (== zero addend)
 // to any other groups field with the ratio 3:1. This is because addend tends
 // to be more unevenly distributed than other fields.
-static uint32_t group_weight(uint64_t flags) {
+static uint32_t group_weight(uint64_t flags, uint32_t no_addend_weight) {
   uint32_t weight = 0;
   if (!is_relocation_group_has_addend(flags)) {
-    weight += 3;
+    weight += no_addend_weight;
   } else if (is_relocation_grouped_by_addend(flags)) {
     weight += 1;
   }
@@ -247,6 +248,7 @@ static uint32_t group_weight(uint64_t flags) {
 template <typename ELF>
 void RelocationDeltaCodec<ELF>::DetectGroup(const std::vector<ElfRela>& relocations,
                                           size_t group_starts_with, ElfAddr previous_offset,
+                                          uint32_t no_addend_weight,
                                           ElfAddr* group_size, ElfAddr* group_flags,
                                           ElfAddr* group_offset_delta, ElfAddr* group_info,
                                           ElfAddr* group_addend) {
@@ -278,7 +280,8 @@ void RelocationDeltaCodec<ELF>::DetectGroup(const std::vector<ElfRela>& relocati
     DetectGroupFields(relocations[i], relocations[i+1], offset_delta, &candidate_flags,
         nullptr, nullptr, nullptr);
 
-    if (group_weight(*group_flags) < group_weight(candidate_flags)) {
+    if (group_weight(*group_flags, no_addend_weight) <
+        group_weight(candidate_flags, no_addend_weight)) {
       break;
     }
     cnt++;
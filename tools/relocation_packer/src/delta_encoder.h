@@ -86,6 +86,7 @@
 #ifndef TOOLS_RELOCATION_PACKER_SRC_DELTA_ENCODER_H_
 #define TOOLS_RELOCATION_PACKER_SRC_DELTA_ENCODER_H_
 
+#include <stdint.h>
 #include <vector>
 
 #include "elf.h"
@@ -102,11 +103,17 @@ class RelocationDeltaCodec {
   typedef typename ELF::Addr ElfAddr;
   typedef typename ELF::Rela ElfRela;
 
+  // Default weight of groups without addend relative to the other grouped
+  // fields when deciding where a group ends.
+  static const uint32_t kDefaultNoAddendWeight = 3;
+
   // Encode relocations with addends into a more compact form.
   // |relocations| is a vector of relative relocation with addend structs.
   // |packed| is the vector of packed words into which relocations are packed.
+  // |no_addend_weight| is the grouping strategy, see kDefaultNoAddendWeight.
   static void Encode(const std::vector<ElfRela>& relocations,
-                     std::vector<ElfAddr>* packed);
+                     std::vector<ElfAddr>* packed,
+                     uint32_t no_addend_weight = kDefaultNoAddendWeight);
 
   // Decode relative relocations with addends from their more compact form.
   // |packed| is the vector of packed relocations.
@@ -117,6 +124,7 @@ class RelocationDeltaCodec {
  private:
   static void DetectGroup(const std::vector<ElfRela>& relocations,
                           size_t group_starts_with, ElfAddr previous_offset,
+                          uint32_t no_addend_weight,
                           ElfAddr* group_size, ElfAddr* group_flags,
                           ElfAddr* group_offset_delta, ElfAddr* group_info,
                           ElfAddr* group_addend);
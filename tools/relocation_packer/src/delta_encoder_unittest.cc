@@ -216,6 +216,54 @@ TEST(Delta, Decode64) {
   decode<ELF64_traits>();
 }
 
+template <typename ELF>
+static void encode_no_addend_weight() {
+  std::vector<typename ELF::Rela> relocations;
+  std::vector<typename ELF::Addr> packed;
+  std::vector<typename ELF::Addr> packed_default;
+
+  // The second pair is grouped by addend, offset delta and info; the next
+  // relocation breaks all of these but has no addend.  A lighter weight of
+  // groups without addend keeps it in the pair's group, the default does not.
+  AddRelocation(0x1008, 0x101U, 0, &relocations);
+  AddRelocation(0x1010, 0x403U, 0x10, &relocations);
+  AddRelocation(0x1018, 0x101U, 0, &relocations);
+  AddRelocation(0x1028, 0x403U, 0, &relocations);
+  AddRelocation(0x1030, 0x101U, 0x20, &relocations);
+
+  RelocationDeltaCodec<ELF> codec;
+  codec.Encode(relocations, &packed_default);
+  codec.Encode(relocations, &packed, RelocationDeltaCodec<ELF>::kDefaultNoAddendWeight);
+  EXPECT_EQ(packed_default, packed);
+  EXPECT_EQ(20U, packed_default.size());
+
+  packed.clear();
+  codec.Encode(relocations, &packed, 1);
+  EXPECT_EQ(19U, packed.size());
+
+  // Every weight decodes to the same relocations.
+  for (uint32_t weight = 1; weight <= 6; ++weight) {
+    packed.clear();
+    codec.Encode(relocations, &packed, weight);
+
+    std::vector<typename ELF::Rela> decoded;
+    codec.Decode(packed, &decoded);
+    ASSERT_EQ(relocations.size(), decoded.size()) << "weight " << weight;
+    for (size_t i = 0; i < relocations.size(); ++i) {
+      EXPECT_TRUE(CheckRelocation(relocations[i].r_offset, relocations[i].r_info,
+                                  relocations[i].r_addend, decoded[i])) << "weight " << weight;
+    }
+  }
+}
+
+TEST(Delta, EncodeNoAddendWeight32) {
+  encode_no_addend_weight<ELF32_traits>();
+}
+
+TEST(Delta, EncodeNoAddendWeight64) {
+  encode_no_addend_weight<ELF64_traits>();
+}
+
 // TODO (dimitry): add more tests (fix by 19 January 2038 03:14:07 UTC)
 // TODO (dimtiry): 1. Incorrect packed array for decode
 // TODO (dimtiry): 2. Try to catch situation where it is likely to get series of groups with size 1
@@ -14,6 +14,7 @@
 
 #include <stdlib.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <algorithm>
 #include <string>
@@ -68,6 +69,13 @@ static void RewriteSectionData(Elf_Scn* section,
   data->d_buf = area;
 }
 
+// CLOCK_MONOTONIC in nanoseconds.
+static uint64_t NowNs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
 // Verbose ELF header logging.
 template <typename Ehdr>
 static void VerboseLogElfHeader(const Ehdr* elf_header) {
@@ -599,6 +607,80 @@ static void ReplaceDynamicEntry(typename ELF::Sword tag,
   VLOG(1) << "dynamic[" << slot << "] overwritten with " << dyn.d_tag;
 }
 
+// Return the relative relocation type for the target, or 0 if bitmap
+// encoding of relative relocations is not supported for it.
+template <typename ELF>
+static typename ELF::Word GetRelativeRelocationType(Elf* elf) {
+  switch (ELF::getehdr(elf)->e_machine) {
+    case EM_ARM:
+      return R_ARM_RELATIVE;
+    case EM_AARCH64:
+      return R_AARCH64_RELATIVE;
+    case EM_386:
+      return R_386_RELATIVE;
+    case EM_X86_64:
+      return R_X86_64_RELATIVE;
+    default:
+      return 0;
+  }
+}
+
+template <typename ELF>
+uint8_t* ElfFile<ELF>::FindWordAtAddress(typename ELF::Addr address) {
+  Elf_Scn* section = NULL;
+  while ((section = elf_nextscn(elf_, section)) != NULL) {
+    auto section_header = ELF::getshdr(section);
+    if ((section_header->sh_flags & SHF_ALLOC) == 0 ||
+        section_header->sh_type == SHT_NOBITS ||
+        address < section_header->sh_addr ||
+        address + sizeof(typename ELF::Addr) > section_header->sh_addr + section_header->sh_size) {
+      continue;
+    }
+
+    Elf_Data* data = GetSectionData(section);
+    elf_flagdata(data, ELF_C_SET, ELF_F_DIRTY);
+    return reinterpret_cast<uint8_t*>(data->d_buf) + (address - section_header->sh_addr);
+  }
+
+  return NULL;
+}
+
+template <typename ELF>
+void ElfFile<ELF>::SplitRelativeRelocations(
+    std::vector<typename ELF::Rela>* relocations,
+    std::vector<typename ELF::Rela>* relative_relocations) {
+  const typename ELF::Word relative_type = GetRelativeRelocationType<ELF>(elf_);
+  std::vector<typename ELF::Rela> other_relocations;
+
+  for (const auto& relocation : *relocations) {
+    if (ELF::elf_r_type(relocation.r_info) == relative_type &&
+        ELF::elf_r_sym(relocation.r_info) == 0 &&
+        relocation.r_offset % sizeof(typename ELF::Addr) == 0 &&
+        FindWordAtAddress(relocation.r_offset) != NULL) {
+      relative_relocations->push_back(relocation);
+    } else {
+      other_relocations.push_back(relocation);
+    }
+  }
+
+  std::stable_sort(relative_relocations->begin(), relative_relocations->end(),
+                   [](const typename ELF::Rela& a, const typename ELF::Rela& b) {
+    return a.r_offset < b.r_offset;
+  });
+
+  // The bitmap can only apply each address once.
+  for (size_t i = 1; i < relative_relocations->size(); ) {
+    if (relative_relocations->at(i).r_offset == relative_relocations->at(i - 1).r_offset) {
+      other_relocations.push_back(relative_relocations->at(i));
+      relative_relocations->erase(relative_relocations->begin() + i);
+    } else {
+      ++i;
+    }
+  }
+
+  relocations->swap(other_relocations);
+}
+
 // Remove relative entries from dynamic relocations and write as packed
 // data into android packed relocations.
 template <typename ELF>
@@ -657,11 +739,32 @@ bool ElfFile<ELF>::PackTypedRelocations(std::vector<typename ELF::Rela>* relocat
   const size_t initial_bytes = relocations->size() * rel_size;
 
   VLOG(1) << "Unpacked                   : " << initial_bytes << " bytes";
+  pack_stats_.relocation_count = relocations->size();
+  pack_stats_.unpacked_bytes = initial_bytes;
+
   std::vector<uint8_t> packed;
   RelocationPacker<ELF> packer;
 
+  std::vector<Rela> relative_relocations;
+  std::vector<typename ELF::Addr> relative_offsets;
+  std::vector<Rela> other_relocations(*relocations);
+  const bool use_relr = is_relr_relocations_ && GetRelativeRelocationType<ELF>(elf_) != 0;
+  if (is_relr_relocations_ && !use_relr) {
+    LOG(INFO) << "Bitmap encoding is not supported for this target";
+  }
+
   // Pack relocations: dry run to estimate memory savings.
-  packer.PackRelocations(*relocations, &packed);
+  if (use_relr) {
+    SplitRelativeRelocations(&other_relocations, &relative_relocations);
+    for (const auto& relocation : relative_relocations) {
+      relative_offsets.push_back(relocation.r_offset);
+    }
+    VLOG(1) << "Relative (bitmap encoded)  : " << relative_offsets.size() << " relocations";
+    packer.PackRelocationsWithRelr(relative_offsets, other_relocations, &packed,
+                                   grouping_search_);
+  } else {
+    packer.PackRelocations(*relocations, &packed, grouping_search_);
+  }
   const size_t packed_bytes_estimate = packed.size() * sizeof(packed[0]);
   VLOG(1) << "Packed         (no padding): " << packed_bytes_estimate << " bytes";
 
@@ -704,17 +807,40 @@ bool ElfFile<ELF>::PackTypedRelocations(std::vector<typename ELF::Rela>* relocat
 
   // Run a loopback self-test as a check that packing is lossless.
   std::vector<Rela> unpacked;
-  packer.UnpackRelocations(packed, &unpacked);
-  CHECK(unpacked.size() == relocations->size());
-  CHECK(!memcmp(&unpacked[0],
-                &relocations->at(0),
-                unpacked.size() * sizeof(unpacked[0])));
+  const uint64_t decode_start_ns = NowNs();
+  if (use_relr) {
+    std::vector<typename ELF::Addr> unpacked_offsets;
+    packer.UnpackRelocationsWithRelr(packed, &unpacked_offsets, &unpacked);
+    pack_stats_.decode_ns = NowNs() - decode_start_ns;
+    CHECK(unpacked_offsets == relative_offsets);
+    CHECK(unpacked.size() == other_relocations.size());
+    CHECK(unpacked.empty() || !memcmp(&unpacked[0],
+                                      &other_relocations[0],
+                                      unpacked.size() * sizeof(unpacked[0])));
+
+    // The bitmap only has addresses, the value relocated is the one stored
+    // at the address.  For REL it already is the addend.
+    if (relocations_type_ == RELA) {
+      for (const auto& relocation : relative_relocations) {
+        typename ELF::Addr addend = relocation.r_addend;
+        memcpy(FindWordAtAddress(relocation.r_offset), &addend, sizeof(addend));
+      }
+    }
+  } else {
+    packer.UnpackRelocations(packed, &unpacked);
+    pack_stats_.decode_ns = NowNs() - decode_start_ns;
+    CHECK(unpacked.size() == relocations->size());
+    CHECK(!memcmp(&unpacked[0],
+                  &relocations->at(0),
+                  unpacked.size() * sizeof(unpacked[0])));
+  }
 
   // Rewrite the current dynamic relocations section with packed one then shrink it to size.
   const size_t bytes = packed.size() * sizeof(packed[0]);
   ResizeSection(elf_, relocations_section_, bytes,
       relocations_type_ == REL ? SHT_ANDROID_REL : SHT_ANDROID_RELA, relocations_type_);
   RewriteSectionData(relocations_section_, packed_data, bytes);
+  pack_stats_.packed_bytes = bytes;
 
   // TODO (dimitry): fix string table and replace .rel.dyn/plt with .android.rel.dyn/plt
 
@@ -772,8 +898,8 @@ bool ElfFile<ELF>::UnpackRelocations() {
       packed.size() > 3 &&
       packed[0] == 'A' &&
       packed[1] == 'P' &&
-      packed[2] == 'S' &&
-      packed[3] == '2') {
+      ((packed[2] == 'S' && packed[3] == '2') ||
+       RelocationPacker<ELF>::IsRelrPacked(packed))) {
     LOG(INFO) << "Relocations   : " << (relocations_type_ == REL ? "REL" : "RELA");
   } else {
     LOG(ERROR) << "Packed relocations not found (not packed?)";
@@ -791,7 +917,33 @@ bool ElfFile<ELF>::UnpackTypedRelocations(const std::vector<uint8_t>& packed) {
   LOG(INFO) << "Packed           : " << packed_bytes << " bytes";
   std::vector<typename ELF::Rela> unpacked_relocations;
   RelocationPacker<ELF> packer;
-  packer.UnpackRelocations(packed, &unpacked_relocations);
+  if (packer.IsRelrPacked(packed)) {
+    const typename ELF::Word relative_type = GetRelativeRelocationType<ELF>(elf_);
+    CHECK(relative_type != 0);
+
+    std::vector<typename ELF::Addr> relative_offsets;
+    std::vector<typename ELF::Rela> other_relocations;
+    packer.UnpackRelocationsWithRelr(packed, &relative_offsets, &other_relocations);
+
+    for (auto offset : relative_offsets) {
+      typename ELF::Rela relocation;
+      relocation.r_offset = offset;
+      relocation.r_info = ELF::elf_r_info(0, relative_type);
+      relocation.r_addend = 0;
+      if (relocations_type_ == RELA) {
+        const uint8_t* word = FindWordAtAddress(offset);
+        CHECK(word != NULL);
+        typename ELF::Addr addend;
+        memcpy(&addend, word, sizeof(addend));
+        relocation.r_addend = addend;
+      }
+      unpacked_relocations.push_back(relocation);
+    }
+    unpacked_relocations.insert(unpacked_relocations.end(),
+                                other_relocations.begin(), other_relocations.end());
+  } else {
+    packer.UnpackRelocations(packed, &unpacked_relocations);
+  }
 
   const size_t relocation_entry_size =
       relocations_type_ == REL ? sizeof(typename ELF::Rel) : sizeof(typename ELF::Rela);
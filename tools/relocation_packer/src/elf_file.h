@@ -18,6 +18,7 @@
 #ifndef TOOLS_RELOCATION_PACKER_SRC_ELF_FILE_H_
 #define TOOLS_RELOCATION_PACKER_SRC_ELF_FILE_H_
 
+#include <stdint.h>
 #include <string.h>
 #include <vector>
 
@@ -34,9 +35,10 @@ template <typename ELF>
 class ElfFile {
  public:
   explicit ElfFile(int fd)
-      : fd_(fd), is_padding_relocations_(false), elf_(NULL),
+      : fd_(fd), is_padding_relocations_(false), is_relr_relocations_(false),
+        grouping_search_(GROUPING_DEFAULT), elf_(NULL),
         relocations_section_(NULL), dynamic_section_(NULL),
-        relocations_type_(NONE), has_android_relocations_(false) {}
+        relocations_type_(NONE), has_android_relocations_(false), pack_stats_() {}
   ~ElfFile() {}
 
   // Set padding mode.  When padding, PackRelocations() will not shrink
@@ -45,11 +47,33 @@ class ElfFile {
   // |flag| is true to pad .rel.dyn or .rela.dyn, false to shrink it.
   inline void SetPadding(bool flag) { is_padding_relocations_ = flag; }
 
+  // Set relr mode.  When set, PackRelocations() encodes relative relocations
+  // as a bitmap of the addresses to relocate, storing RELA addends in place,
+  // and packs only the remaining relocations one by one.
+  // |flag| is true to use the bitmap encoding.
+  inline void SetRelr(bool flag) { is_relr_relocations_ = flag; }
+
+  // Set how hard PackRelocations() looks for a smaller encoding, see
+  // GroupingSearch.  The default is to use the default strategy only.
+  inline void SetGroupingSearch(GroupingSearch search) { grouping_search_ = search; }
+
   // Transfer relative relocations from .rel.dyn or .rela.dyn to a packed
   // representation in .android.rel.dyn or .android.rela.dyn.  Returns true
   // on success.
   bool PackRelocations();
 
+  // What PackRelocations() did: the size of the relocations before and after
+  // packing (packed_bytes is zero if they were left as they were), and how
+  // long decoding the packed relocations took in the loopback self-test, as
+  // an estimate of what they cost the linker.
+  struct PackStats {
+    size_t relocation_count;
+    size_t unpacked_bytes;
+    size_t packed_bytes;
+    uint64_t decode_ns;
+  };
+  const PackStats& GetPackStats() const { return pack_stats_; }
+
   // Transfer relative relocations from a packed representation in
   // .android.rel.dyn or .android.rela.dyn to .rel.dyn or .rela.dyn.  Returns
   // true on success.
@@ -73,6 +97,16 @@ class ElfFile {
   // ELF::Rel or ELF::Rela.
   bool UnpackTypedRelocations(const std::vector<uint8_t>& packed);
 
+  // Move relative relocations that can be bitmap encoded out of
+  // |relocations| into |relative_relocations|, sorted by address.
+  void SplitRelativeRelocations(std::vector<typename ELF::Rela>* relocations,
+                                std::vector<typename ELF::Rela>* relative_relocations);
+
+  // Find the file data backing the word at |address|, and flag it as dirty
+  // as the caller may rewrite it.  Returns NULL if the address is not in an
+  // allocated section with file contents.
+  uint8_t* FindWordAtAddress(typename ELF::Addr address);
+
   // Write ELF file changes.
   void Flush();
 
@@ -102,6 +136,12 @@ class ElfFile {
   // debugging, allows packing to be checked without affecting load addresses.
   bool is_padding_relocations_;
 
+  // If set, bitmap encode relative relocations.
+  bool is_relr_relocations_;
+
+  // How hard to look for a smaller encoding.
+  GroupingSearch grouping_search_;
+
   // Libelf handle, assigned by Load().
   Elf* elf_;
 
@@ -114,6 +154,9 @@ class ElfFile {
 
   // Elf-file has android relocations section
   bool has_android_relocations_;
+
+  // Filled in by PackRelocations().
+  PackStats pack_stats_;
 };
 
 }  // namespace relocation_packer
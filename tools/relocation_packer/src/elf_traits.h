@@ -39,6 +39,7 @@ struct ELF32_traits {
   static inline Word elf_r_type(Word info) { return ELF32_R_TYPE(info); }
   static inline int elf_st_type(uint8_t info) { return ELF32_ST_TYPE(info); }
   static inline Word elf_r_sym(Word info) { return ELF32_R_SYM(info); }
+  static inline Word elf_r_info(Word sym, Word type) { return ELF32_R_INFO(sym, type); }
 };
 
 struct ELF64_traits {
@@ -63,6 +64,7 @@ struct ELF64_traits {
   static inline Xword elf_r_type(Xword info) { return ELF64_R_TYPE(info); }
   static inline int elf_st_type(uint8_t info) { return ELF64_ST_TYPE(info); }
   static inline Word elf_r_sym(Xword info) { return ELF64_R_SYM(info); }
+  static inline Xword elf_r_info(Word sym, Xword type) { return ELF64_R_INFO(sym, type); }
 };
 
 #endif  // TOOLS_RELOCATION_PACKER_SRC_ELF_TRAITS_H_
@@ -7,26 +7,31 @@
 // Invoke with -v to trace actions taken when packing or unpacking.
 // Invoke with -p to pad removed relocations with R_*_NONE.  Suppresses
 // shrinking of .rel.dyn.
+// Invoke with -r to bitmap encode relative relocations.  Only linkers that
+// understand the bitmap encoding can load the result.
+// Invoke with -s to also try the other grouping strategies of the delta
+// encoder and keep the smallest result.  Slower.
+// Invoke with several files or a directory to process all of them (the
+// *.so files in the directory) in parallel, -j at a time, and print a
+// per-file report of sizes and estimated decode time.
 // See PrintUsage() below for full usage details.
 //
 // NOTE: Breaks with libelf 0.152, which is buggy.  libelf 0.158 works.
 
-#include <errno.h>
-#include <fcntl.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/types.h>
-#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "batch.h"
 #include "debug.h"
-#include "elf_file.h"
-#include "elf_traits.h"
 #include "libelf.h"
 
-#include "nativehelper/ScopedFd.h"
-
 static void PrintUsage(const char* argv0) {
   std::string temporary = argv0;
   const size_t last_slash = temporary.find_last_of("/");
@@ -36,39 +41,61 @@ static void PrintUsage(const char* argv0) {
   const char* basename = temporary.c_str();
 
   printf(
-      "Usage: %s [-u] [-v] [-p] file\n\n"
+      "Usage: %s [-u] [-v] [-p] [-r] [-s] [-j jobs] file|directory...\n\n"
       "Pack or unpack relative relocations in a shared library.\n\n"
       "  -u, --unpack   unpack previously packed relative relocations\n"
       "  -v, --verbose  trace object file modifications (for debugging)\n"
-      "  -p, --pad      do not shrink relocations, but pad (for debugging)\n\n",
+      "  -p, --pad      do not shrink relocations, but pad (for debugging)\n"
+      "  -r, --relr     bitmap encode relative relocations (needs a linker\n"
+      "                 that supports it)\n"
+      "  -s, --search   try several grouping strategies and keep the smallest\n"
+      "                 result (slower)\n"
+      "  -j, --jobs     number of files to process in parallel (default:\n"
+      "                 number of cpus)\n\n",
       basename);
 
   printf(
+      "With several files, or a directory (all the *.so files in it), the\n"
+      "files are processed in parallel and a report is printed.\n\n"
       "Debug sections are not handled, so packing should not be used on\n"
       "shared libraries compiled for debugging or otherwise unstripped.\n");
 }
 
 int main(int argc, char* argv[]) {
-  bool is_unpacking = false;
+  relocation_packer::Options options = { false, false, false, relocation_packer::GROUPING_DEFAULT };
   bool is_verbose = false;
-  bool is_padding = false;
+  size_t jobs = std::max(1U, std::thread::hardware_concurrency());
 
-  static const option options[] = {
+  static const option long_options[] = {
     {"unpack", 0, 0, 'u'}, {"verbose", 0, 0, 'v'}, {"pad", 0, 0, 'p'},
-    {"help", 0, 0, 'h'}, {NULL, 0, 0, 0}
+    {"relr", 0, 0, 'r'}, {"search", 0, 0, 's'}, {"jobs", 1, 0, 'j'}, {"help", 0, 0, 'h'},
+    {NULL, 0, 0, 0}
   };
   bool has_options = true;
   while (has_options) {
-    int c = getopt_long(argc, argv, "uvph", options, NULL);
+    int c = getopt_long(argc, argv, "uvprsj:h", long_options, NULL);
     switch (c) {
       case 'u':
-        is_unpacking = true;
+        options.is_unpacking = true;
         break;
       case 'v':
         is_verbose = true;
         break;
       case 'p':
-        is_padding = true;
+        options.is_padding = true;
+        break;
+      case 'r':
+        options.is_relr = true;
+        break;
+      case 's':
+        options.grouping_search = relocation_packer::GROUPING_SEARCH_THREADED;
+        break;
+      case 'j':
+        jobs = strtoul(optarg, NULL, 10);
+        if (jobs == 0) {
+          LOG(INFO) << "Try '" << argv[0] << " --help' for more information.";
+          return 1;
+        }
         break;
       case 'h':
         PrintUsage(argv[0]);
@@ -84,7 +111,7 @@ int main(int argc, char* argv[]) {
         return 1;
     }
   }
-  if (optind != argc - 1) {
+  if (optind == argc) {
     LOG(INFO) << "Try '" << argv[0] << " --help' for more information.";
     return 1;
   }
@@ -93,58 +120,37 @@ int main(int argc, char* argv[]) {
     LOG(WARNING) << "Elf Library is out of date!";
   }
 
-  const char* file = argv[argc - 1];
-  ScopedFd fd(open(file, O_RDWR));
-  if (fd.get() == -1) {
-    LOG(ERROR) << file << ": " << strerror(errno);
-    return 1;
-  }
-
   if (is_verbose)
     relocation_packer::Logger::SetVerbose(1);
 
-  // We need to detect elf class in order to create
-  // correct implementation
-  uint8_t e_ident[EI_NIDENT];
-  if (TEMP_FAILURE_RETRY(read(fd.get(), e_ident, EI_NIDENT) != EI_NIDENT)) {
-    LOG(ERROR) << file << ": failed to read elf header:" << strerror(errno);
-    return 1;
-  }
-
-  if (TEMP_FAILURE_RETRY(lseek(fd.get(), 0, SEEK_SET)) != 0) {
-    LOG(ERROR) << file << ": lseek to 0 failed:" << strerror(errno);
-    return 1;
+  // A single file is processed as it always was.
+  struct stat path_stat;
+  if (optind == argc - 1 && (stat(argv[optind], &path_stat) != 0 || !S_ISDIR(path_stat.st_mode))) {
+    relocation_packer::FileResult result = relocation_packer::FileResult();
+    result.path = argv[optind];
+    return relocation_packer::ProcessFile(options, &result) ? 0 : 1;
   }
 
-  bool status = false;
-
-  if (e_ident[EI_CLASS] == ELFCLASS32) {
-    relocation_packer::ElfFile<ELF32_traits> elf_file(fd.get());
-    elf_file.SetPadding(is_padding);
-
-    if (is_unpacking) {
-      status = elf_file.UnpackRelocations();
-    } else {
-      status = elf_file.PackRelocations();
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; ++i) {
+    if (!relocation_packer::CollectFiles(argv[i], &files)) {
+      return 1;
     }
-  } else if (e_ident[EI_CLASS] == ELFCLASS64) {
-    relocation_packer::ElfFile<ELF64_traits> elf_file(fd.get());
-    elf_file.SetPadding(is_padding);
-
-    if (is_unpacking) {
-      status = elf_file.UnpackRelocations();
-    } else {
-      status = elf_file.PackRelocations();
-    }
-  } else {
-    LOG(ERROR) << file << ": unknown ELFCLASS: " << e_ident[EI_CLASS];
-    return 1;
   }
 
-  if (!status) {
-    LOG(ERROR) << file << ": failed to pack/unpack file";
-    return 1;
+  // The per-file progress messages are not useful once interleaved, the
+  // report says what happened to each file.  Errors are still printed.
+  if (!is_verbose) {
+    relocation_packer::Logger::SetStreams(NULL, &std::cerr);
   }
 
-  return 0;
+  std::vector<relocation_packer::FileResult> results;
+  const bool status = relocation_packer::ProcessFiles(options, files, jobs, &results);
+
+  relocation_packer::Logger::Reset();
+  if (is_verbose)
+    relocation_packer::Logger::SetVerbose(1);
+
+  relocation_packer::PrintReport(stdout, results, options.is_unpacking);
+  return status ? 0 : 1;
 }
@@ -4,23 +4,36 @@
 
 #include "packer.h"
 
+#include <string.h>
+
+#include <thread>
 #include <vector>
 
 #include "debug.h"
 #include "delta_encoder.h"
 #include "elf_traits.h"
+#include "relr_encoder.h"
 #include "sleb128.h"
 
 namespace relocation_packer {
 
-// Pack relocations into a group encoded packed representation.
+// Grouping strategies, as weights of groups without addend (see
+// RelocationDeltaCodec::kDefaultNoAddendWeight).  The default comes first,
+// so it wins ties.
+static const uint32_t kNoAddendWeights[] = { 3, 1, 2, 4, 6 };
+
+// Fewer relocations than this are not worth starting threads for.
+static const size_t kMinRelocationsForThreads = 4096;
+
+// Pack relocations using one grouping strategy.
 template <typename ELF>
-void RelocationPacker<ELF>::PackRelocations(const std::vector<typename ELF::Rela>& relocations,
-                                            std::vector<uint8_t>* packed) {
+static void PackRelocationsWithWeight(const std::vector<typename ELF::Rela>& relocations,
+                                      uint32_t no_addend_weight,
+                                      std::vector<uint8_t>* packed) {
   // Run-length encode.
   std::vector<typename ELF::Addr> packed_words;
   RelocationDeltaCodec<ELF> codec;
-  codec.Encode(relocations, &packed_words);
+  codec.Encode(relocations, &packed_words, no_addend_weight);
 
   // If insufficient data do nothing.
   if (packed_words.empty())
@@ -40,6 +53,50 @@ void RelocationPacker<ELF>::PackRelocations(const std::vector<typename ELF::Rela
   packed->insert(packed->end(), sleb128_packed.begin(), sleb128_packed.end());
 }
 
+// Pack relocations into a group encoded packed representation.  When
+// searching, try the other grouping strategies too and keep the smallest
+// result.
+template <typename ELF>
+void RelocationPacker<ELF>::PackRelocations(const std::vector<typename ELF::Rela>& relocations,
+                                            std::vector<uint8_t>* packed,
+                                            GroupingSearch search) {
+  if (search == GROUPING_DEFAULT) {
+    PackRelocationsWithWeight<ELF>(relocations, kNoAddendWeights[0], packed);
+    return;
+  }
+
+  const size_t strategy_count = sizeof(kNoAddendWeights) / sizeof(kNoAddendWeights[0]);
+  std::vector<std::vector<uint8_t>> candidates(strategy_count);
+
+  if (search == GROUPING_SEARCH || relocations.size() < kMinRelocationsForThreads) {
+    for (size_t i = 0; i < strategy_count; ++i) {
+      PackRelocationsWithWeight<ELF>(relocations, kNoAddendWeights[i], &candidates[i]);
+    }
+  } else {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < strategy_count; ++i) {
+      threads.emplace_back([&relocations, &candidates, i]() {
+        PackRelocationsWithWeight<ELF>(relocations, kNoAddendWeights[i], &candidates[i]);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  size_t best = 0;
+  for (size_t i = 1; i < strategy_count; ++i) {
+    if (candidates[i].size() < candidates[best].size()) {
+      best = i;
+    }
+  }
+
+  VLOG(1) << "Grouping strategy          : no addend weight " << kNoAddendWeights[best]
+          << ", " << candidates[best].size() << " bytes (default "
+          << candidates[0].size() << " bytes)";
+  packed->insert(packed->end(), candidates[best].begin(), candidates[best].end());
+}
+
 // Unpack relative relocations from a run-length encoded packed
 // representation.
 template <typename ELF>
@@ -61,6 +118,75 @@ void RelocationPacker<ELF>::UnpackRelocations(
   codec.Decode(packed_words, relocations);
 }
 
+// The bitmap packed section starts with a header word holding 'APR1' (padded
+// with zeros to the word size, so that the words that follow are aligned),
+// then the number of bitmap words and the words themselves.  Anything after
+// that is an 'APS2' stream with the remaining relocations.
+template <typename ELF>
+void RelocationPacker<ELF>::PackRelocationsWithRelr(
+    const std::vector<typename ELF::Addr>& relative_offsets,
+    const std::vector<typename ELF::Rela>& relocations,
+    std::vector<uint8_t>* packed,
+    GroupingSearch search) {
+  typedef typename ELF::Addr ElfAddr;
+
+  std::vector<ElfAddr> words;
+  RelrEncoder<ELF>::Encode(relative_offsets, &words);
+  words.insert(words.begin(), static_cast<ElfAddr>(words.size()));
+
+  packed->push_back('A');
+  packed->push_back('P');
+  packed->push_back('R');
+  packed->push_back('1');
+  packed->resize(sizeof(ElfAddr), 0);
+
+  const uint8_t* words_bytes = reinterpret_cast<const uint8_t*>(&words[0]);
+  packed->insert(packed->end(), words_bytes, words_bytes + words.size() * sizeof(ElfAddr));
+
+  if (!relocations.empty()) {
+    std::vector<uint8_t> rest;
+    PackRelocations(relocations, &rest, search);
+    CHECK(!rest.empty());
+    packed->insert(packed->end(), rest.begin(), rest.end());
+  }
+}
+
+template <typename ELF>
+bool RelocationPacker<ELF>::IsRelrPacked(const std::vector<uint8_t>& packed) {
+  return packed.size() >= 2 * sizeof(typename ELF::Addr) &&
+      packed[0] == 'A' &&
+      packed[1] == 'P' &&
+      packed[2] == 'R' &&
+      packed[3] == '1';
+}
+
+template <typename ELF>
+void RelocationPacker<ELF>::UnpackRelocationsWithRelr(
+    const std::vector<uint8_t>& packed,
+    std::vector<typename ELF::Addr>* relative_offsets,
+    std::vector<typename ELF::Rela>* relocations) {
+  typedef typename ELF::Addr ElfAddr;
+
+  CHECK(IsRelrPacked(packed));
+
+  ElfAddr count;
+  memcpy(&count, &packed[sizeof(ElfAddr)], sizeof(count));
+  const size_t words_end = (2 + count) * sizeof(ElfAddr);
+  CHECK(words_end <= packed.size());
+
+  std::vector<ElfAddr> words(count);
+  if (count != 0) {
+    memcpy(&words[0], &packed[2 * sizeof(ElfAddr)], count * sizeof(ElfAddr));
+  }
+  RelrEncoder<ELF>::Decode(words, relative_offsets);
+
+  // Whatever is not an 'APS2' stream is padding.
+  if (words_end < packed.size() && packed[words_end] == 'A') {
+    std::vector<uint8_t> rest(packed.begin() + words_end, packed.end());
+    UnpackRelocations(rest, relocations);
+  }
+}
+
 template class RelocationPacker<ELF32_traits>;
 template class RelocationPacker<ELF64_traits>;
 
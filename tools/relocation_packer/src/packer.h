@@ -14,6 +14,18 @@
 
 namespace relocation_packer {
 
+// How PackRelocations() chooses the delta encoder's grouping strategy.
+enum GroupingSearch {
+  // Use the default strategy only.
+  GROUPING_DEFAULT,
+  // Also try the other strategies, one after the other, and keep the
+  // smallest result.  The default strategy wins ties.
+  GROUPING_SEARCH,
+  // As GROUPING_SEARCH, but try them in parallel, one thread each, when
+  // there are enough relocations to be worth it.
+  GROUPING_SEARCH_THREADED,
+};
+
 // A RelocationPacker packs vectors of relocations into more
 // compact forms, and unpacks them to reproduce the pre-packed data.
 template <typename ELF>
@@ -22,14 +34,38 @@ class RelocationPacker {
   // Pack relocations into a more compact form.
   // |relocations| is a vector of relocation structs.
   // |packed| is the vector of packed bytes into which relocations are packed.
+  // |search| is how hard to look for a smaller encoding.
   static void PackRelocations(const std::vector<typename ELF::Rela>& relocations,
-                              std::vector<uint8_t>* packed);
+                              std::vector<uint8_t>* packed,
+                              GroupingSearch search = GROUPING_DEFAULT);
 
   // Unpack relocations from their more compact form.
   // |packed| is the vector of packed relocations.
   // |relocations| is a vector of unpacked relocation structs.
   static void UnpackRelocations(const std::vector<uint8_t>& packed,
                                 std::vector<typename ELF::Rela>* relocations);
+
+  // Pack relative relocations as a bitmap, followed by the rest of the
+  // relocations packed as by PackRelocations().
+  // |relative_offsets| is a sorted vector of the relative relocation addresses.
+  // |relocations| is a vector of the other relocation structs.
+  // |packed| is the vector of packed bytes into which relocations are packed.
+  // |search| is passed on to PackRelocations().
+  static void PackRelocationsWithRelr(const std::vector<typename ELF::Addr>& relative_offsets,
+                                      const std::vector<typename ELF::Rela>& relocations,
+                                      std::vector<uint8_t>* packed,
+                                      GroupingSearch search = GROUPING_DEFAULT);
+
+  // Unpack relocations packed by PackRelocationsWithRelr().
+  // |packed| is the vector of packed relocations.
+  // |relative_offsets| is a vector of the relative relocation addresses.
+  // |relocations| is a vector of the other unpacked relocation structs.
+  static void UnpackRelocationsWithRelr(const std::vector<uint8_t>& packed,
+                                        std::vector<typename ELF::Addr>* relative_offsets,
+                                        std::vector<typename ELF::Rela>* relocations);
+
+  // True if |packed| was produced by PackRelocationsWithRelr().
+  static bool IsRelrPacked(const std::vector<uint8_t>& packed);
 };
 
 }  // namespace relocation_packer
@@ -297,4 +297,111 @@ TEST(Packer, UnpackWithAddend) {
   DoUnpackWithAddend<ELF64_traits>();
 }
 
+template <typename ELF>
+static void DoPackWithRelr() {
+  typedef typename ELF::Addr ElfAddr;
+  const ElfAddr word = sizeof(ElfAddr);
+
+  std::vector<ElfAddr> relative_offsets;
+  for (ElfAddr i = 0; i < 16; ++i) {
+    relative_offsets.push_back(0xd1ce0000 + i * word);
+  }
+
+  std::vector<typename ELF::Rela> relocations;
+  AddRelocation<ELF>(0xd1ce1000, 0x0101, 0, &relocations);
+  AddRelocation<ELF>(0xd1ce1000 + word, 0x0201, 0, &relocations);
+
+  std::vector<uint8_t> packed;
+  RelocationPacker<ELF> packer;
+  packer.PackRelocationsWithRelr(relative_offsets, relocations, &packed);
+
+  EXPECT_TRUE(packer.IsRelrPacked(packed));
+  // Header, count, one address and one bitmap, then 'APS2' for the rest.
+  ASSERT_LT(4 * word + 4, packed.size());
+  EXPECT_EQ('A', packed[4 * word]);
+  EXPECT_EQ('2', packed[4 * word + 3]);
+
+  // Padding after the packed data is ignored.
+  packed.resize(packed.size() + 3 * word, 0);
+
+  std::vector<ElfAddr> unpacked_offsets;
+  std::vector<typename ELF::Rela> unpacked;
+  packer.UnpackRelocationsWithRelr(packed, &unpacked_offsets, &unpacked);
+
+  EXPECT_EQ(relative_offsets, unpacked_offsets);
+  ASSERT_EQ(2U, unpacked.size());
+  EXPECT_TRUE(CheckRelocation<ELF>(0xd1ce1000, 0x0101, 0, unpacked[0]));
+  EXPECT_TRUE(CheckRelocation<ELF>(0xd1ce1000 + word, 0x0201, 0, unpacked[1]));
+
+  // Only relative relocations.
+  packed.clear();
+  packer.PackRelocationsWithRelr(relative_offsets, std::vector<typename ELF::Rela>(), &packed);
+  EXPECT_EQ(4 * word, packed.size());
+
+  unpacked_offsets.clear();
+  unpacked.clear();
+  packer.UnpackRelocationsWithRelr(packed, &unpacked_offsets, &unpacked);
+  EXPECT_EQ(relative_offsets, unpacked_offsets);
+  EXPECT_EQ(0U, unpacked.size());
+}
+
+TEST(Packer, PackWithRelr) {
+  DoPackWithRelr<ELF32_traits>();
+  DoPackWithRelr<ELF64_traits>();
+}
+
+template <typename ELF>
+static void DoPackGroupingSearch() {
+  std::vector<typename ELF::Rela> relocations;
+
+  // A pattern that a lighter weight of groups without addend packs smaller
+  // (see Delta.EncodeNoAddendWeight), repeated so that there are enough
+  // relocations for the threaded search to start threads.
+  for (typename ELF::Addr base = 0xd1ce0000; relocations.size() < 5000; base += 0x40) {
+    AddRelocation<ELF>(base + 0x08, 0x0101, 0, &relocations);
+    AddRelocation<ELF>(base + 0x10, 0x0403, 0x10, &relocations);
+    AddRelocation<ELF>(base + 0x18, 0x0101, 0, &relocations);
+    AddRelocation<ELF>(base + 0x28, 0x0403, 0, &relocations);
+    AddRelocation<ELF>(base + 0x30, 0x0101, 0x20, &relocations);
+  }
+
+  RelocationPacker<ELF> packer;
+
+  std::vector<uint8_t> packed_default;
+  std::vector<uint8_t> packed;
+  packer.PackRelocations(relocations, &packed_default);
+  packer.PackRelocations(relocations, &packed, GROUPING_DEFAULT);
+  EXPECT_EQ(packed_default, packed);
+
+  std::vector<uint8_t> packed_search;
+  packer.PackRelocations(relocations, &packed_search, GROUPING_SEARCH);
+  EXPECT_LT(packed_search.size(), packed_default.size());
+
+  std::vector<uint8_t> packed_threaded;
+  packer.PackRelocations(relocations, &packed_threaded, GROUPING_SEARCH_THREADED);
+  EXPECT_EQ(packed_search, packed_threaded);
+
+  std::vector<typename ELF::Rela> unpacked;
+  packer.UnpackRelocations(packed_search, &unpacked);
+  ASSERT_EQ(relocations.size(), unpacked.size());
+  for (size_t i = 0; i < relocations.size(); ++i) {
+    EXPECT_TRUE(CheckRelocation<ELF>(relocations[i].r_offset, relocations[i].r_info,
+                                     relocations[i].r_addend, unpacked[i]));
+  }
+
+  // With few relocations the search tries the strategies one by one, and
+  // still never does worse than the default.
+  relocations.resize(5);
+  packed_default.clear();
+  packed_threaded.clear();
+  packer.PackRelocations(relocations, &packed_default);
+  packer.PackRelocations(relocations, &packed_threaded, GROUPING_SEARCH_THREADED);
+  EXPECT_LE(packed_threaded.size(), packed_default.size());
+}
+
+TEST(Packer, PackGroupingSearch) {
+  DoPackGroupingSearch<ELF32_traits>();
+  DoPackGroupingSearch<ELF64_traits>();
+}
+
 }  // namespace relocation_packer
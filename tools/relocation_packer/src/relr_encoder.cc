@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "relr_encoder.h"
+
+#include <vector>
+
+#include "debug.h"
+#include "elf_traits.h"
+
+namespace relocation_packer {
+
+template <typename ELF>
+void RelrEncoder<ELF>::Encode(const std::vector<ElfAddr>& offsets,
+                              std::vector<ElfAddr>* encoded) {
+  const ElfAddr word_size = sizeof(ElfAddr);
+
+  size_t i = 0;
+  while (i < offsets.size()) {
+    // Start a new run with an address entry.
+    const ElfAddr base = offsets[i++];
+    CHECK(base % word_size == 0);
+    encoded->push_back(base);
+    ElfAddr where = base + word_size;
+
+    // Then cover as many of the following addresses as possible with
+    // bitmaps; stop at the first bitmap that would be empty.
+    while (true) {
+      ElfAddr bitmap = 0;
+      while (i < offsets.size()) {
+        CHECK(offsets[i] >= where && offsets[i] % word_size == 0);
+        const ElfAddr delta = (offsets[i] - where) / word_size;
+        if (delta >= kBitmapWords) {
+          break;
+        }
+        bitmap |= static_cast<ElfAddr>(1) << delta;
+        ++i;
+      }
+
+      if (bitmap == 0) {
+        break;
+      }
+
+      encoded->push_back((bitmap << 1) | 1);
+      where += kBitmapWords * word_size;
+    }
+  }
+}
+
+template <typename ELF>
+void RelrEncoder<ELF>::Decode(const std::vector<ElfAddr>& encoded,
+                              std::vector<ElfAddr>* offsets) {
+  const ElfAddr word_size = sizeof(ElfAddr);
+
+  ElfAddr where = 0;
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    const ElfAddr entry = encoded[i];
+    if ((entry & 1) == 0) {
+      offsets->push_back(entry);
+      where = entry + word_size;
+      continue;
+    }
+
+    CHECK(i > 0);
+    ElfAddr bitmap = entry >> 1;
+    for (ElfAddr offset = where; bitmap != 0; bitmap >>= 1, offset += word_size) {
+      if ((bitmap & 1) != 0) {
+        offsets->push_back(offset);
+      }
+    }
+    where += kBitmapWords * word_size;
+  }
+}
+
+template class RelrEncoder<ELF32_traits>;
+template class RelrEncoder<ELF64_traits>;
+
+}  // namespace relocation_packer
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bitmap encoding of relative relocations.
+//
+// Relative relocations only need an address: the value to add the load bias
+// to is already stored at that address (for RELA the packer puts the addend
+// there). The addresses are encoded as a sequence of ElfAddr words:
+//
+// - an even word is an address; the relocation at that address is applied
+//   and the "next address" becomes address + sizeof(ElfAddr).
+// - an odd word is a bitmap: bit n (counting from 1, bit 0 is the marker)
+//   being set means the word at next address + (n - 1) * sizeof(ElfAddr) is
+//   relocated. Afterwards next address is advanced by 63 (31 for ELF32)
+//   words, whether or not the last bits were set.
+//
+// For example, on ELF64:
+//
+//     0x000a2178       <- relocate 0xa2178, next address is 0xa2180
+//     0x000000000000ff <- bits 1..7: relocate 0xa2180 .. 0xa21b0,
+//                         next address is 0xa2180 + 63 * 8
+//
+// so runs of pointers, as in vtables and other tables of pointers, cost one
+// bit per relocation.
+
+#ifndef TOOLS_RELOCATION_PACKER_SRC_RELR_ENCODER_H_
+#define TOOLS_RELOCATION_PACKER_SRC_RELR_ENCODER_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "elf.h"
+
+namespace relocation_packer {
+
+template <typename ELF>
+class RelrEncoder {
+ public:
+  typedef typename ELF::Addr ElfAddr;
+
+  // Number of words covered by one bitmap entry.
+  static const size_t kBitmapWords = 8 * sizeof(ElfAddr) - 1;
+
+  // Encode relative relocation addresses.
+  // |offsets| is a sorted vector of distinct, ElfAddr aligned addresses.
+  // |encoded| is the vector of words into which they are encoded.
+  static void Encode(const std::vector<ElfAddr>& offsets,
+                     std::vector<ElfAddr>* encoded);
+
+  // Decode relative relocation addresses.
+  // |encoded| is the vector of encoded words.
+  // |offsets| is the vector of decoded addresses, in ascending order.
+  static void Decode(const std::vector<ElfAddr>& encoded,
+                     std::vector<ElfAddr>* offsets);
+};
+
+}  // namespace relocation_packer
+
+#endif  // TOOLS_RELOCATION_PACKER_SRC_RELR_ENCODER_H_
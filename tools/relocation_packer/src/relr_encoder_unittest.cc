@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "relr_encoder.h"
+
+#include <vector>
+#include "elf.h"
+#include "elf_traits.h"
+#include "gtest/gtest.h"
+
+namespace relocation_packer {
+
+template <typename ELF>
+static void encode() {
+  typedef typename ELF::Addr ElfAddr;
+  const ElfAddr word = sizeof(ElfAddr);
+  const size_t bitmap_words = RelrEncoder<ELF>::kBitmapWords;
+
+  std::vector<ElfAddr> offsets;
+  std::vector<ElfAddr> encoded;
+
+  RelrEncoder<ELF>::Encode(offsets, &encoded);
+  ASSERT_EQ(0U, encoded.size());
+
+  // A single address.
+  offsets.push_back(0xf00d0000);
+  RelrEncoder<ELF>::Encode(offsets, &encoded);
+  ASSERT_EQ(1U, encoded.size());
+  EXPECT_EQ(0xf00d0000U, encoded[0]);
+
+  // A run of three following it, and one with a gap.
+  offsets.push_back(0xf00d0000 + word);
+  offsets.push_back(0xf00d0000 + 2 * word);
+  offsets.push_back(0xf00d0000 + 3 * word);
+  offsets.push_back(0xf00d0000 + 6 * word);
+  encoded.clear();
+  RelrEncoder<ELF>::Encode(offsets, &encoded);
+  ASSERT_EQ(2U, encoded.size());
+  EXPECT_EQ(0xf00d0000U, encoded[0]);
+  EXPECT_EQ(static_cast<ElfAddr>((0x27 << 1) | 1), encoded[1]);
+
+  // The last word one bitmap covers, and the first of the next one.
+  offsets.push_back(0xf00d0000 + bitmap_words * word);
+  offsets.push_back(0xf00d0000 + (bitmap_words + 1) * word);
+  encoded.clear();
+  RelrEncoder<ELF>::Encode(offsets, &encoded);
+  ASSERT_EQ(3U, encoded.size());
+  EXPECT_EQ(static_cast<ElfAddr>(((0x27 | static_cast<ElfAddr>(1) << (bitmap_words - 1)) << 1) | 1),
+            encoded[1]);
+  EXPECT_EQ(3U, encoded[2]);
+
+  // Far away addresses start a new run.
+  offsets.push_back(0xf00e0000);
+  encoded.clear();
+  RelrEncoder<ELF>::Encode(offsets, &encoded);
+  ASSERT_EQ(4U, encoded.size());
+  EXPECT_EQ(0xf00e0000U, encoded[3]);
+}
+
+TEST(Relr, Encode32) {
+  encode<ELF32_traits>();
+}
+
+TEST(Relr, Encode64) {
+  encode<ELF64_traits>();
+}
+
+template <typename ELF>
+static void round_trip() {
+  typedef typename ELF::Addr ElfAddr;
+  const ElfAddr word = sizeof(ElfAddr);
+
+  std::vector<ElfAddr> offsets;
+  for (ElfAddr i = 0; i < 1000; ++i) {
+    // Dense runs with holes of varying size between them.
+    if (i % 7 != 3 && i % 97 != 5) {
+      offsets.push_back(0x10000 + i * word + (i / 100) * 0x1000);
+    }
+  }
+
+  std::vector<ElfAddr> encoded;
+  RelrEncoder<ELF>::Encode(offsets, &encoded);
+  EXPECT_LT(encoded.size(), offsets.size() / 8);
+
+  std::vector<ElfAddr> decoded;
+  RelrEncoder<ELF>::Decode(encoded, &decoded);
+  EXPECT_EQ(offsets, decoded);
+}
+
+TEST(Relr, RoundTrip32) {
+  round_trip<ELF32_traits>();
+}
+
+TEST(Relr, RoundTrip64) {
+  round_trip<ELF64_traits>();
+}
+
+}  // namespace relocation_packer